@@ -29,14 +29,13 @@
 #include <windows.h>
 #include <fstream>
 #include <vector>
-#include <comdef.h>
-#include <msxml6.h>
+#include <string>
+#include <algorithm>
+#include <set>
+#include <thread>
 
 #pragma comment(lib, "ws2_32.lib")
-#pragma comment(lib, "msxml6.lib")
 
-std::string extractXMLElement(IXMLDOMDocument* doc, const std::wstring& tag);
-std::string buildXMLResponseInit(const std::string& request_id);
-std::string buildXMLResponseShift(const std::string& request_id, const std::vector<std::uint8_t>& shiftOutput);
+void serveClient(SOCKET clientSocket, std::ofstream* logfile);
 
 #endif
\ No newline at end of file
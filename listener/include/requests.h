@@ -0,0 +1,57 @@
+////////////////////////<Source Code Embedded Notices>/////////////////////////
+//
+// INTEL CONFIDENTIAL
+// Copyright (C) Intel Corporation All Rights Reserved.
+//
+// The source code contained or described herein and all documents related to
+// the source code ("Material") are owned by Intel Corporation or its suppliers
+// or licensors. Title to the Material remains with Intel Corporation or its
+// suppliers and licensors. The Material contains trade secrets and proprietary
+// and confidential information of Intel or its suppliers and licensors. The
+// Material is protected by worldwide copyright and trade secret laws and
+// treaty provisions. No part of the Material may be used, copied, reproduced,
+// modified, published, uploaded, posted, transmitted, distributed, or disclosed
+// in any way without Intel's prior express written permission.
+//
+// No license under any patent, copyright, trade secret or other intellectual
+// property right is granted to or conferred upon you by disclosure or delivery
+// of the Materials, either expressly, by implication, inducement, estoppel or
+// otherwise. Any license under such intellectual property rights must be
+// express and approved by Intel in writing.
+//
+/////////////////////////<Source Code Embedded Notices>/////////////////////////
+
+#ifndef REQUESTS_H
+#define REQUESTS_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <deque>
+#include <chrono>
+#include <mutex>
+#include <cstdint>
+
+//the receiver's handling of the plugin's requests, apart from its sockets, so the plugin's receiver tests answer
+//their requests with it too
+
+//bytes of requests a client may have sent before it has their responses, advertised in every response. the receiver
+//tests set it to the window of their receiver
+extern size_t receiveWindow;
+
+std::string extractXMLElement(const std::string& xmlStr, const std::string& tag);
+std::string buildXMLResponseInit(const std::string& request_id, const std::string& compression, bool loops = false);
+std::string buildXMLResponseShift(const std::string& request_id, const std::string& outputElement);
+std::string buildXMLResponseLoop(const std::string& request_id, size_t iterations, bool matched, const std::string& outputElements);
+std::string buildXMLResponseCanceled(const std::string& request_id);
+std::string buildXMLResponseError(const std::string& request_id);
+struct Session;
+std::string handleCancel(const std::string& xmlStr);
+bool takeCanceled(const std::string& sessionId, const std::string& request_id);
+Session& useSession(const std::string& sessionId, std::set<std::string>& clientSessions);
+void releaseSessions(const std::set<std::string>& clientSessions);
+std::string handleRequest(const std::string& xmlStr, std::ostream& logfile, std::set<std::string>& clientSessions);
+
+#endif
@@ -28,11 +28,15 @@
 
 #include <iostream>
 #include <vector>
+#include <cstdint>
+#include <algorithm>
 #include <cassert>
 
 //set globals used by shift
 void set_value(std::vector<uint8_t> value);
 void set_size(size_t size);
+std::vector<uint8_t> get_value();
+size_t get_size();
 
 void SetNthBit(std::vector<uint8_t>& vec, size_t n, bool value);
 bool GetNthBit(const std::vector<uint8_t>& vec, size_t n);
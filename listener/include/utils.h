@@ -26,12 +26,18 @@
 #define UTILS_H
 
 #include <vector>
+#include <string>
+#include <cstdint>
 #include <sstream>   // std::stringstream, std::getline
 #include <iomanip>   // std::hex, std::setw, std::setfill, std::uppercase
 
-std::string bytes_to_hex_list(const std::vector<std::uint8_t>& bytes);
-static inline void trim_inplace(std::string& s);
+//"0x00, 0x11, ..." lists. with runs, repeated bytes are written once as "0x00*12" (used once a session negotiated
+//RunLength compression); parse_byte_vector always reads them
+std::string bytes_to_hex_list(const std::vector<std::uint8_t>& bytes, bool runs = false);
 bool parse_byte_vector(const std::string& input,std::vector<std::uint8_t>& out,std::string& error);
 bool to_size_t_stoul(const std::string& s, size_t& out);
+//the output element of a shift response: <output>, or given the output the client has as the base, <unchanged> or
+//the <delta> XOR with the base when that is shorter
+std::string encode_shift_output(const std::vector<std::uint8_t>& output, const std::vector<std::uint8_t>* base, bool runs);
 
 #endif
\ No newline at end of file
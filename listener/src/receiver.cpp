@@ -23,59 +23,67 @@
 
 //by martin.monroy@intel.com
 //build with x64 VSS tools
-//build cmd: cl receiver.cpp /Fe:receiver.exe /EHsc ws2_32.lib msxml6.lib
+//build cmd: cl receiver.cpp requests.cpp shift.cpp utils.cpp /Fe:receiver.exe /EHsc ws2_32.lib
 //replaced by cmake command.
-//the msxml6.lib library is not native on the vs tools framework so it needs to manually be added on the build command since it is still available to the build environment. 
-//test receiver app for openipc remote plugin development. 
+//test receiver app for openipc remote plugin development. the requests are handled in requests.cpp, this serves them
+//on the sockets
 
 #include "receiver.h"
-#include "shift.h"
-#include "utils.h"
+#include "requests.h"
+
+//a client keeps its connection open and sends requests one after the other, or batched together. a request can
+//arrive split over several recv's, or with others, so requests are cut out of the received bytes at each </request>.
+//the bytes are received into a buffer of receiveWindow bytes, so a client that sends past the window waits for it
+void serveClient(SOCKET clientSocket, std::ofstream* logfile) {
+    const std::string requestEnd = "</request>";
+    std::vector<char> window(receiveWindow);
+    size_t received = 0; //bytes of the window holding a request that isn't complete yet
+    std::string responses;
+    std::set<std::string> clientSessions; //sessions that sent requests on this connection
 
-std::string extractXMLElement(IXMLDOMDocument* doc, const std::wstring& tag) {
-    IXMLDOMNode* node = nullptr;
-    BSTR tagName = SysAllocString(tag.c_str());
-    doc->selectSingleNode(tagName, &node);
-    SysFreeString(tagName);
+    while (true) {
+        //a request bigger than the window is the only one waiting, so the window grows to take it in
+        if (received == window.size()) window.resize(window.size() * 2);
 
-    if (!node) return "";
+        //WAIT for a request
+        int bytesReceived = recv(clientSocket, window.data() + received, (int)(window.size() - received), 0);
+        if (bytesReceived <= 0) break; //client closed the connection
+
+        const size_t searchFrom = received < requestEnd.size() ? 0 : received - requestEnd.size() + 1;
+        received += bytesReceived;
+        const char* begin = window.data();
+        const char* last = window.data() + received;
+        const char* end = std::search(begin + searchFrom, last, requestEnd.begin(), requestEnd.end());
+        while (end != last) {
+            end += requestEnd.size();
+            std::string xmlStr(begin, end);  //string buffer to be parsed from xml request
+            begin = end;
+            responses += handleRequest(xmlStr, *logfile, clientSessions);
+            end = std::search(begin, last, requestEnd.begin(), requestEnd.end());
+        }
+        received = last - begin;
+        std::copy(begin, last, window.begin()); //the start of the next request moves to the front
+        if (received < receiveWindow && window.size() > receiveWindow) {
+            window.resize(receiveWindow);
+            window.shrink_to_fit();
+        }
 
-    BSTR value;
-    node->get_text(&value);
-    std::string result = _bstr_t(value);
-    SysFreeString(value);
-    node->Release();
-    return result;
-}
+        ////////////////////////////RESPONSE//////////////////////////////////////
+        //the responses to all the requests of a batch go back together, in the order of the requests
+        if (!responses.empty()) {
+            send(clientSocket, responses.c_str(), (int)responses.size(), 0);
+            responses.clear();
+        }
+    }
 
-std::string buildXMLResponseInit(const std::string& request_id) {
-    std::ostringstream oss;
-    oss << "<response>"
-        << "<request_id>" << request_id << "</request_id>"
-        << "<status>OK</status>"
-        << "</response>";
-    return oss.str();
+    releaseSessions(clientSessions);
+    closesocket(clientSocket);
 }
-
-std::string buildXMLResponseShift(const std::string& request_id, const std::vector<std::uint8_t>& shiftOutput) {
-    std::ostringstream oss;
-    std::string outputVector = bytes_to_hex_list(shiftOutput); //convert to string
-    
-    oss << "<response>"
-        << "<request_id>" << request_id << "</request_id>"
-        << "<status>OK</status>"
-        << "<output>" << outputVector << "</output>"
-        << "</response>";
-    return oss.str();
-}            
                 
 int main() {
-    CoInitialize(nullptr);
-
     WSADATA wsaData;
     SOCKET listenSocket, clientSocket;
     sockaddr_in serverAddr{}, clientAddr{};
-    char buffer[2048];
 
     WSAStartup(MAKEWORD(2, 2), &wsaData);
 
@@ -89,101 +97,17 @@ int main() {
     std::ofstream logfile("receiver_log.txt", std::ios::app);
     std::cout << "Receiver listening on port 12345...\n";
 
+    //each client is served on its own thread, so the plugin's channels (one per executing interface) are answered in parallel
     while (true) {
         int clientSize = sizeof(clientAddr);
         clientSocket = accept(listenSocket, (SOCKADDR*)&clientAddr, &clientSize);
         if (clientSocket == INVALID_SOCKET) continue;
 
-        //WAIT for a request
-        int bytesReceived = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-        
-        //If request received process it
-        if (bytesReceived > 0) {
-            buffer[bytesReceived] = '\0';
-            std::string xmlStr(buffer);  //string buffer to be parsed from xml request
-
-            logfile << "Received XML:\n" << xmlStr << "\n";
-
-            //variable prep to process incoming request
-            IXMLDOMDocument* doc = nullptr; //XML document to parse and extract request data
-            HRESULT hr = CoCreateInstance(CLSID_DOMDocument60, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&doc));
-            VARIANT_BOOL success = VARIANT_FALSE;
-
-            if (SUCCEEDED(hr)) { //just checking we did generate this object correctly
-                BSTR xmlBstr = _com_util::ConvertStringToBSTR(xmlStr.c_str()); //load the string onto the xml object
-                doc->loadXML(xmlBstr, &success); //load xml into a parsable xml object and verify the load on variable success
-                SysFreeString(xmlBstr); //release memory allocated to BSTR xmlBstr for processing request since it is now on the doc variable. 
-            }
-
-            if (success == VARIANT_TRUE) {//load check and subsequent variable load
-                std::string request_id = extractXMLElement(doc, L"/request/request_id");
-               
-                std::string initialize = extractXMLElement(doc, L"/request/initialize");  //True or False if true ten value/size must be included
-                if(initialize=="False"){
-                    //std::string payload = extractXMLElement(doc, L"/request/payload");
-                    std::string bitSizeS = extractXMLElement(doc, L"/request/bitSize"); //bitsize is a size_t on the trans side
-                    std::string inputS = extractXMLElement(doc, L"/request/input");  //input vector<uint8_t> on the trans
-                    
-                    size_t bitSizeT;
-                    to_size_t_stoul(bitSizeS,bitSizeT); //convert string into size_t for function manipulation in receiver
-                    
-                    std::vector<std::uint8_t> inputV;
-                    std::string error;
-                    if (parse_byte_vector(inputS, inputV, error)) {
-                        std::cout << "Parsed " << inputV.size() << " bytes:\n";
-                        for (std::size_t i = 0; i < inputV.size(); ++i) {
-                            std::cout << "0x" << std::hex << std::uppercase
-                                      << static_cast<int>(inputV[i])
-                                      << (i + 1 == inputV.size() ? "\n" : ", ");
-                        }
-                    } else {
-                        std::cerr << "Parse failed: " << error << "\n";
-                    }
-                    
-                    std::vector<std::uint8_t> shiftOutput;
-                    shiftOutput = Shift(inputV, bitSizeT); //shiftOutput is the return vector
-                    
-                    ////////////////////////////RESPONSE//////////////////////////////////////
-                    std::string xmlResponse = buildXMLResponseShift(request_id, shiftOutput);
-                    send(clientSocket, xmlResponse.c_str(), xmlResponse.size(), 0);
-                    logfile << "Responded:\n" << xmlResponse << "\n\n";
-                }
-                else{ //initialize size and value
-                    std::string initSize =  extractXMLElement(doc, L"/request/size");
-                    std::string initValue = extractXMLElement(doc, L"/request/value");
-                    size_t sizeToSet;
-                    to_size_t_stoul(initSize,sizeToSet); //convert string into size_t for function manipulation in receiver
-                    set_size(sizeToSet);
-                    
-                    //set _value
-                    std::vector<std::uint8_t> initialInputVector;
-                    std::string error;                    
-                    
-                    if (parse_byte_vector(initValue, initialInputVector, error)){
-                        std::cerr << "Initial value converted from vector: \n";
-                    }else{
-                        std::cerr << "vector conversion failed: " << error << "\n";
-                    }
-                    set_value(initialInputVector);
-                    ////////////////////////////RESPONSE//////////////////////////////////////
-                    std::string xmlResponse = buildXMLResponseInit(request_id);
-                    send(clientSocket, xmlResponse.c_str(), xmlResponse.size(), 0);
-                    logfile << "Responded:\n" << xmlResponse << "\n\n";
-                }
-                logfile.flush();
-            } else {
-                std::cerr << "Failed to parse XML.\n";
-            }
-
-            if (doc) doc->Release();
-        }
-
-        closesocket(clientSocket);
+        std::thread(serveClient, clientSocket, &logfile).detach();
     }
 
     logfile.close();
     closesocket(listenSocket);
     WSACleanup();
-    CoUninitialize();
     return 0;
 }
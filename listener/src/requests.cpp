@@ -0,0 +1,389 @@
+/////////////////////////<Source Code Embedded Notices>/////////////////////////
+//
+// INTEL CONFIDENTIAL
+// Copyright (C) Intel Corporation All Rights Reserved.
+//
+// The source code contained or described herein and all documents related to
+// the source code ("Material") are owned by Intel Corporation or its suppliers
+// or licensors. Title to the Material remains with Intel Corporation or its
+// suppliers and licensors. The Material contains trade secrets and proprietary
+// and confidential information of Intel or its suppliers and licensors. The
+// Material is protected by worldwide copyright and trade secret laws and
+// treaty provisions. No part of the Material may be used, copied, reproduced,
+// modified, published, uploaded, posted, transmitted, distributed, or disclosed
+// in any way without Intel's prior express written permission.
+//
+// No license under any patent, copyright, trade secret or other intellectual
+// property right is granted to or conferred upon you by disclosure or delivery
+// of the Materials, either expressly, by implication, inducement, estoppel or
+// otherwise. Any license under such intellectual property rights must be
+// express and approved by Intel in writing.
+//
+/////////////////////////<Source Code Embedded Notices>/////////////////////////
+
+#include "requests.h"
+#include "shift.h"
+#include "utils.h"
+
+//bytes of requests a client may have sent before it has their responses. it is advertised in every response, so
+//the requests waiting on a connection stay within it (a single bigger request is still accepted when it is the only one).
+//it is the size of each connection's receive buffer: no more than this is read before the requests in it are answered
+size_t receiveWindow = 64 * 1024;
+
+//a request is <request> with elements of text only in it, as the plugin sends them, so an element is read straight
+//out of it. returns "" for an element the request doesn't have
+std::string extractXMLElement(const std::string& xmlStr, const std::string& tag) {
+    const std::string open = "<" + tag + ">";
+    const size_t begin = xmlStr.find(open);
+    if (begin == std::string::npos) return "";
+    const size_t end = xmlStr.find("</" + tag + ">", begin + open.size());
+    if (end == std::string::npos) return "";
+    return xmlStr.substr(begin + open.size(), end - begin - open.size());
+}
+
+//a request has to be one <request> element
+static bool isRequest(const std::string& xmlStr) {
+    const std::string open = "<request>";
+    const std::string close = "</request>";
+    const size_t begin = xmlStr.find_first_not_of(" \t\r\n");
+    const size_t end = xmlStr.find_last_not_of(" \t\r\n");
+    return begin != std::string::npos && xmlStr.compare(begin, open.size(), open) == 0
+        && end + 1 >= begin + open.size() + close.size() && xmlStr.compare(end + 1 - close.size(), close.size(), close) == 0;
+}
+
+//compression is the compression the receiver accepted, and loops whether it accepted loop requests, when answering
+//a handshake that offered them
+std::string buildXMLResponseInit(const std::string& request_id, const std::string& compression, bool loops) {
+    std::ostringstream oss;
+    oss << "<response>"
+        << "<request_id>" << request_id << "</request_id>"
+        << "<status>OK</status>"
+        << "<window>" << receiveWindow << "</window>";
+    if (!compression.empty()) oss << "<compression>" << compression << "</compression>";
+    if (loops) oss << "<loops>True</loops>";
+    oss << "</response>";
+    return oss.str();
+}
+
+//outputElement is the shift's output as encode_shift_output made it: <output>, <delta> or <unchanged>
+std::string buildXMLResponseShift(const std::string& request_id, const std::string& outputElement) {
+    std::ostringstream oss;
+    oss << "<response>"
+        << "<request_id>" << request_id << "</request_id>"
+        << "<status>OK</status>"
+        << "<window>" << receiveWindow << "</window>"
+        << outputElement
+        << "</response>";
+    return oss.str();
+}            
+                
+//outputElements are the last iteration's <output0>, <output1>, ... of the loop's shifts
+std::string buildXMLResponseLoop(const std::string& request_id, size_t iterations, bool matched, const std::string& outputElements) {
+    std::ostringstream oss;
+    oss << "<response>"
+        << "<request_id>" << request_id << "</request_id>"
+        << "<status>OK</status>"
+        << "<window>" << receiveWindow << "</window>"
+        << "<iterations>" << iterations << "</iterations>"
+        << "<matched>" << (matched ? "True" : "False") << "</matched>"
+        << outputElements
+        << "</response>";
+    return oss.str();
+}
+
+std::string buildXMLResponseCanceled(const std::string& request_id) {
+    std::ostringstream oss;
+    oss << "<response>"
+        << "<request_id>" << request_id << "</request_id>"
+        << "<status>CANCELED</status>"
+        << "<window>" << receiveWindow << "</window>"
+        << "</response>";
+    return oss.str();
+}
+
+std::string buildXMLResponseError(const std::string& request_id) {
+    std::ostringstream oss;
+    oss << "<response>"
+        << "<request_id>" << request_id << "</request_id>"
+        << "<status>ERROR</status>"
+        << "<window>" << receiveWindow << "</window>"
+        << "</response>";
+    return oss.str();
+}
+
+//the simulated register and the log file are shared by all the clients
+std::mutex registerMutex;
+
+//a plugin probe sends its session with every request, and gets a register of its own under it. the session is kept
+//for sessionGrace after the last of its connections closes, so a probe whose connection dropped picks up where it
+//left off when it reconnects, however long its other connections stayed idle before. the responses to the session's
+//last sessionReplayLimit requests are kept too: a request sent again after a reconnect is answered with the response
+//it got the first time instead of shifting the register twice
+const std::chrono::seconds sessionGrace(60);
+const size_t sessionReplayLimit = 1024;
+
+//a plugin offers RunLength compression in its handshake. once accepted, the session's byte lists may carry runs, and
+//a shift request naming a deltaKey (the plugin's signature of the scan, like a polled register) is answered relative
+//to the output the session last got for that key: unchanged, or the XOR with it when that is shorter. the plugin
+//names the request_id of the output it has as the deltaBase, and a full output is sent when that isn't the last one
+struct Session {
+    std::vector<std::uint8_t> value;
+    size_t size = 0;
+    std::map<std::string, std::string> responses; //response by request_id
+    std::deque<std::string> responseOrder; //request_id's of the responses, oldest first
+    size_t connections = 0; //connections that sent requests of the session and are still open
+    std::chrono::steady_clock::time_point idleSince; //when the last of them closed
+    bool compression = false;
+    std::map<std::string, std::pair<std::string, std::vector<std::uint8_t>>> deltaBases; //request_id and output by deltaKey
+};
+std::map<std::string, Session> sessions;
+
+//a plugin cancels the requests it stopped waiting for (their deadline passed, or the host canceled their bundle).
+//the ones not executed yet are answered with a CANCELED status instead. cancels are kept under their own mutex, as
+//the request a cancel is meant to overtake may be holding registerMutex
+std::mutex cancelMutex;
+std::map<std::string, std::set<std::string>> canceledRequests; //request_id's by session
+
+std::string handleCancel(const std::string& xmlStr) {
+    if (!isRequest(xmlStr)) {
+        std::cerr << "Failed to parse XML.\n";
+        return buildXMLResponseError("");
+    }
+    std::string sessionId = extractXMLElement(xmlStr, "session");
+    std::string request_id = extractXMLElement(xmlStr, "request_id");
+    std::string canceled = extractXMLElement(xmlStr, "cancel");
+
+    std::lock_guard<std::mutex> lock(cancelMutex);
+    auto& canceledIds = canceledRequests[sessionId];
+    if (canceledIds.size() > sessionReplayLimit) canceledIds.clear(); //long gone requests that had been executed already
+    std::istringstream ids(canceled);
+    std::string id;
+    while (std::getline(ids, id, ',')) {
+        const size_t first = id.find_first_not_of(' ');
+        if (first != std::string::npos) canceledIds.insert(id.substr(first, id.find_last_not_of(' ') - first + 1));
+    }
+    std::cout << "Canceled requests of session " << sessionId << ": " << canceled << "\n";
+    return buildXMLResponseInit(request_id, "");
+}
+
+//true once for a request that was canceled
+bool takeCanceled(const std::string& sessionId, const std::string& request_id) {
+    std::lock_guard<std::mutex> lock(cancelMutex);
+    auto found = canceledRequests.find(sessionId);
+    return found != canceledRequests.end() && found->second.erase(request_id) > 0;
+}
+
+//finds the session, or starts it from the register the requests without a session use, and counts the connection
+//in it the first time the connection uses it (clientSessions are the sessions it used). called with registerMutex held
+Session& useSession(const std::string& sessionId, std::set<std::string>& clientSessions) {
+    const auto now = std::chrono::steady_clock::now();
+    for (auto it = sessions.begin(); it != sessions.end();) {
+        if (it->second.connections == 0 && now - it->second.idleSince > sessionGrace) {
+            std::lock_guard<std::mutex> lock(cancelMutex);
+            canceledRequests.erase(it->first);
+            it = sessions.erase(it);
+        }
+        else ++it;
+    }
+    auto found = sessions.find(sessionId);
+    if (found == sessions.end()) {
+        found = sessions.emplace(sessionId, Session{}).first;
+        found->second.value = get_value();
+        found->second.size = get_size();
+    }
+    if (clientSessions.insert(sessionId).second) found->second.connections++;
+    return found->second;
+}
+
+//a connection closed: the sessions it was the last open connection of start their grace period
+void releaseSessions(const std::set<std::string>& clientSessions) {
+    std::lock_guard<std::mutex> lock(registerMutex);
+    for (const auto& sessionId : clientSessions) {
+        auto found = sessions.find(sessionId);
+        if (found != sessions.end() && --found->second.connections == 0) found->second.idleSince = std::chrono::steady_clock::now();
+    }
+}
+
+//a plugin that accepted loops in its handshake sends a polling loop as one request instead of a request per
+//iteration: at most <loop> iterations of the <shifts> shifts <bitSize0>/<input0>, <bitSize1>/<input1>, ..., ended by the
+//first iteration in which one of the <comparisons> matches. comparison j matches when the output of shift
+//<compareShift{j}> equals <match{j}> under <mask{j}> (its first bytes, as many as the mask has). only the last
+//iteration's outputs are sent back. a loop canceled while it runs stops before its next iteration
+static std::string handleLoop(const std::string& xmlStr, const std::string& sessionId, const std::string& request_id, bool runs) {
+    struct LoopShift {
+        size_t bitSize = 0;
+        std::vector<std::uint8_t> input;
+    };
+    struct LoopComparison {
+        size_t shift = 0;
+        std::vector<std::uint8_t> mask;
+        std::vector<std::uint8_t> match;
+    };
+    size_t iterations = 0, shiftCount = 0, comparisonCount = 0;
+    std::string error;
+    bool valid = to_size_t_stoul(extractXMLElement(xmlStr, "loop"), iterations)
+        && to_size_t_stoul(extractXMLElement(xmlStr, "shifts"), shiftCount)
+        && to_size_t_stoul(extractXMLElement(xmlStr, "comparisons"), comparisonCount)
+        && shiftCount + comparisonCount <= xmlStr.size(); //every one of them has elements in the request
+    std::vector<LoopShift> shifts(valid ? shiftCount : 0);
+    for (size_t i = 0; valid && i < shifts.size(); i++) {
+        const std::string index = std::to_string(i);
+        valid = to_size_t_stoul(extractXMLElement(xmlStr, "bitSize" + index), shifts[i].bitSize)
+            && parse_byte_vector(extractXMLElement(xmlStr, "input" + index), shifts[i].input, error)
+            && shifts[i].input.size() == (shifts[i].bitSize + 7) / 8;
+    }
+    std::vector<LoopComparison> comparisons(valid ? comparisonCount : 0);
+    for (size_t j = 0; valid && j < comparisons.size(); j++) {
+        const std::string index = std::to_string(j);
+        auto& comparison = comparisons[j];
+        valid = to_size_t_stoul(extractXMLElement(xmlStr, "compareShift" + index), comparison.shift) && comparison.shift < shifts.size()
+            && parse_byte_vector(extractXMLElement(xmlStr, "mask" + index), comparison.mask, error)
+            && parse_byte_vector(extractXMLElement(xmlStr, "match" + index), comparison.match, error)
+            && comparison.mask.size() == comparison.match.size() && comparison.mask.size() <= shifts[comparison.shift].input.size();
+    }
+    if (!valid) {
+        std::cerr << "Invalid loop request: " << error << "\n";
+        return buildXMLResponseError(request_id);
+    }
+
+    std::vector<std::vector<std::uint8_t>> outputs(shifts.size());
+    size_t iteration = 0;
+    bool matched = false;
+    while (iteration < iterations && !matched) {
+        if (iteration > 0 && takeCanceled(sessionId, request_id)) return buildXMLResponseCanceled(request_id);
+        for (size_t i = 0; i < shifts.size(); i++) outputs[i] = Shift(shifts[i].input, shifts[i].bitSize);
+        for (const auto& comparison : comparisons) {
+            const auto& output = outputs[comparison.shift];
+            bool isMatch = true;
+            for (size_t byte = 0; byte < comparison.mask.size() && isMatch; byte++) {
+                isMatch = (output[byte] & comparison.mask[byte]) == (comparison.match[byte] & comparison.mask[byte]);
+            }
+            matched = matched || isMatch;
+        }
+        iteration++;
+    }
+    std::string outputElements;
+    for (size_t i = 0; i < outputs.size(); i++) {
+        const std::string tag = "output" + std::to_string(i);
+        outputElements += "<" + tag + ">" + bytes_to_hex_list(outputs[i], runs) + "</" + tag + ">";
+    }
+    return buildXMLResponseLoop(request_id, iteration, matched, outputElements);
+}
+
+//processes one request and returns its response. every request gets a response, so the client never waits forever
+std::string handleRequest(const std::string& xmlStr, std::ostream& logfile, std::set<std::string>& clientSessions) {
+    if (xmlStr.find("<cancel>") != std::string::npos) return handleCancel(xmlStr);
+    std::lock_guard<std::mutex> lock(registerMutex);
+    logfile << "Received XML:\n" << xmlStr << "\n";
+
+    std::string xmlResponse;
+    if (isRequest(xmlStr)) {
+        std::string request_id = extractXMLElement(xmlStr, "request_id");
+        std::string sessionId = extractXMLElement(xmlStr, "session");
+
+        //a session's requests run on its own register, swapped in for the request
+        Session* session = nullptr;
+        std::vector<std::uint8_t> sharedValue;
+        size_t sharedSize = 0;
+        if (!sessionId.empty()) {
+            session = &useSession(sessionId, clientSessions);
+            auto answered = session->responses.find(request_id);
+            if (answered != session->responses.end()) { //replayed after a reconnect
+                logfile << "Replayed response of request " << request_id << "\n";
+                xmlResponse = answered->second;
+            }
+            if (xmlResponse.empty() && takeCanceled(sessionId, request_id)) {
+                logfile << "Request " << request_id << " was canceled\n";
+                xmlResponse = buildXMLResponseCanceled(request_id);
+            }
+            if (xmlResponse.empty()) {
+                sharedValue = get_value();
+                sharedSize = get_size();
+                set_value(session->value);
+                set_size(session->size);
+            }
+        }
+
+        std::string initialize = extractXMLElement(xmlStr, "initialize");  //True or False if true ten value/size must be included
+        std::string compression = extractXMLElement(xmlStr, "compression");
+        if (compression != "RunLength" || !session) compression.clear(); //the only compression there is, for a session
+        const bool loops = extractXMLElement(xmlStr, "loops") == "True"; //offered by the plugin's handshake
+        if(!xmlResponse.empty()){ //replayed or canceled, the register isn't touched
+            session = nullptr;
+        }
+        else if(initialize=="False" && !extractXMLElement(xmlStr, "loop").empty()){
+            xmlResponse = handleLoop(xmlStr, sessionId, request_id, session && session->compression);
+        }
+        else if(initialize=="False"){
+            //std::string payload = extractXMLElement(xmlStr, "payload");
+            std::string bitSizeS = extractXMLElement(xmlStr, "bitSize"); //bitsize is a size_t on the trans side
+            std::string inputS = extractXMLElement(xmlStr, "input");  //input vector<uint8_t> on the trans
+            
+            size_t bitSizeT = 0;
+            std::vector<std::uint8_t> inputV;
+            std::string error;
+            if (to_size_t_stoul(bitSizeS,bitSizeT) && parse_byte_vector(inputS, inputV, error) && inputV.size() == (bitSizeT + 7) / 8) {
+                std::vector<std::uint8_t> shiftOutput;
+                shiftOutput = Shift(inputV, bitSizeT); //shiftOutput is the return vector
+                std::string outputElement;
+                std::string deltaKey = extractXMLElement(xmlStr, "deltaKey");
+                if (session && session->compression && !deltaKey.empty()) {
+                    auto base = session->deltaBases.find(deltaKey);
+                    const bool hasBase = base != session->deltaBases.end() && base->second.first == extractXMLElement(xmlStr, "deltaBase");
+                    outputElement = encode_shift_output(shiftOutput, hasBase ? &base->second.second : nullptr, true);
+                    if (session->deltaBases.size() >= sessionReplayLimit) session->deltaBases.clear();
+                    session->deltaBases[deltaKey] = std::make_pair(request_id, shiftOutput);
+                } else {
+                    outputElement = encode_shift_output(shiftOutput, nullptr, session && session->compression);
+                }
+                xmlResponse = buildXMLResponseShift(request_id, outputElement);
+            } else {
+                std::cerr << "Invalid shift request: " << error << "\n";
+                xmlResponse = buildXMLResponseError(request_id);
+            }
+        }
+        else if(initialize=="True"){ //initialize size and value
+            std::string initSize =  extractXMLElement(xmlStr, "size");
+            std::string initValue = extractXMLElement(xmlStr, "value");
+            size_t sizeToSet = 0;
+            to_size_t_stoul(initSize,sizeToSet); //convert string into size_t for function manipulation in receiver
+            set_size(sizeToSet);
+            
+            //set _value
+            std::vector<std::uint8_t> initialInputVector;
+            std::string error;                    
+            
+            if (parse_byte_vector(initValue, initialInputVector, error)){
+                std::cerr << "Initial value converted from vector: \n";
+            }else{
+                std::cerr << "vector conversion failed: " << error << "\n";
+            }
+            set_value(initialInputVector);
+            if (session) session->compression = !compression.empty(); //the plugin's handshake initializes its register
+            xmlResponse = buildXMLResponseInit(request_id, compression, loops);
+        }
+        else{ //no register operation
+            if (session) session->compression = !compression.empty();
+            xmlResponse = buildXMLResponseInit(request_id, compression, loops);
+        }
+
+        if (session) {
+            session->value = get_value();
+            session->size = get_size();
+            set_value(sharedValue);
+            set_size(sharedSize);
+            if (session->responses.emplace(request_id, xmlResponse).second) session->responseOrder.push_back(request_id);
+            if (session->responseOrder.size() > sessionReplayLimit) {
+                session->responses.erase(session->responseOrder.front());
+                session->responseOrder.pop_front();
+            }
+        }
+    } else {
+        std::cerr << "Failed to parse XML.\n";
+        xmlResponse = buildXMLResponseError("");
+    }
+
+    logfile << "Responded:\n" << xmlResponse << "\n\n";
+    logfile.flush();
+    return xmlResponse;
+}
@@ -36,6 +36,14 @@ void set_size(size_t size){
     _size = size;    
 }
 
+std::vector<uint8_t> get_value(){
+    return _value;
+}
+
+size_t get_size(){
+    return _size;
+}
+
 
 void SetNthBit(std::vector<uint8_t>& vec, size_t n, bool value)
 {
@@ -107,7 +115,7 @@ std::vector<uint8_t> Shift(const std::vector<uint8_t>& input, size_t bitSize)
         for (size_t bitOffset = 0; bitOffset < bitSize; bitOffset++)
         {
             // Filling remaining value bits from input
-            SetNthBit(_value, bitSize + bitOffset, GetNthBit(input, bitOffset));
+            SetNthBit(_value, bitCountUnderBy + bitOffset, GetNthBit(input, bitOffset));
         }
     }
     return output;
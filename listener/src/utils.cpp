@@ -24,18 +24,46 @@
 
 #include "utils.h"
 
-std::string bytes_to_hex_list(const std::vector<std::uint8_t>& bytes) {
+#include <algorithm>
+#include <cctype>
+#include <limits>
+
+//longest run a "0x00*N" token may expand to, so a malformed count can't allocate without bound
+static const unsigned long maxRunLength = 1ul << 24;
+
+std::string bytes_to_hex_list(const std::vector<std::uint8_t>& bytes, bool runs) {
     if (bytes.empty()) return std::string{};
     std::ostringstream oss;
     oss << std::hex << std::uppercase << std::setfill('0');
-    for (std::size_t i = 0; i < bytes.size(); ++i) {
+    for (std::size_t i = 0; i < bytes.size();) {
+        std::size_t run = 1;
+        if (runs) {
+            while (i + run < bytes.size() && bytes[i + run] == bytes[i] && run < maxRunLength) ++run;
+        }
         if (i) oss << ", ";
         // cast to unsigned so it prints as a number, not a char
         oss << "0x" << std::setw(2) << static_cast<unsigned>(bytes[i]);
+        if (run > 1) oss << "*" << std::dec << run << std::hex; //two or more bytes are shorter as a run
+        i += run;
     }
     return oss.str();
 }
 
+std::string encode_shift_output(const std::vector<std::uint8_t>& output, const std::vector<std::uint8_t>* base, bool runs) {
+    std::string full = "<output>" + bytes_to_hex_list(output, runs) + "</output>";
+    if (!base || base->size() != output.size()) return full;
+
+    std::vector<std::uint8_t> delta(output.size());
+    bool unchanged = true;
+    for (std::size_t i = 0; i < output.size(); ++i) {
+        delta[i] = static_cast<std::uint8_t>(output[i] ^ (*base)[i]);
+        unchanged = unchanged && delta[i] == 0;
+    }
+    if (unchanged) return "<unchanged>True</unchanged>";
+    std::string xored = "<delta>" + bytes_to_hex_list(delta, runs) + "</delta>";
+    return xored.size() < full.size() ? xored : full;
+}
+
 
 // Trim ASCII whitespace in-place (C++14)
 static inline void trim_inplace(std::string& s) {
@@ -45,7 +73,7 @@ static inline void trim_inplace(std::string& s) {
 }
 
 // Parse comma-separated byte literals (e.g. "0x1A, 255, FF") into 'out'.
-// Accepts: 0x.. / 0X.. (hex), plain hex like "FF", or decimal like "255".
+// Accepts: 0x.. / 0X.. (hex), plain hex like "FF", or decimal like "255", each optionally followed by "*N" for N copies.
 // Returns true on success; on failure returns false and sets 'error'.
 bool parse_byte_vector(const std::string& input,std::vector<std::uint8_t>& out,std::string& error)
 {
@@ -63,6 +91,25 @@ bool parse_byte_vector(const std::string& input,std::vector<std::uint8_t>& out,s
             return false;
         }
 
+        // A run: the byte, repeated count times
+        unsigned long count = 1;
+        const std::size_t star = token.find('*');
+        if (star != std::string::npos) {
+            const std::string countText = token.substr(star + 1);
+            token.erase(star);
+            trim_inplace(token);
+            std::size_t countEnd = 0;
+            try {
+                count = countText.empty() || !std::isdigit(static_cast<unsigned char>(countText[0])) ? 0 : std::stoul(countText, &countEnd, 10);
+            } catch (const std::exception&) {
+                count = 0;
+            }
+            if (count == 0 || count > maxRunLength || countEnd != countText.size() || token.empty()) {
+                error = "Invalid run at position " + std::to_string(index);
+                return false;
+            }
+        }
+
         // Disallow signs for byte values
         if (token.front() == '+' || token.front() == '-') {
             error = "Sign not allowed for byte value at position " + std::to_string(index);
@@ -101,7 +148,7 @@ bool parse_byte_vector(const std::string& input,std::vector<std::uint8_t>& out,s
             return false;
         }
 
-        out.push_back(static_cast<std::uint8_t>(value));
+        out.insert(out.end(), count, static_cast<std::uint8_t>(value));
     }
 
     // Treat empty input as success with empty vector; change if your policy differs.
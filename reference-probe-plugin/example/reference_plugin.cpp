@@ -24,6 +24,12 @@
 #include <ProbePlugin.h>
 #include <BundleOperations.h>
 #include <JtagStateBasedOperations.h>
+#include <JTAGRegisterBasedOperations.h>
+#include <JTAGPinsBasedOperations.h>
+#include <InterfaceScanBulkOperations.h>
+#include <JTAGPaddingOperations.h>
+#include <SlotOperations.h>
+#include <LoopOperations.h>
 #include <StateportOperations.h>
 #include <TraceOperations.h>
 
@@ -38,9 +44,20 @@
 #include <optional>
 #include <string>
 #include <cstring>
+#include <cctype>
 #include <numeric>
 #include <atomic>
+#include <limits>
 #include <unordered_map>
+#include <utility>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <random>
 
 // socket libs
 #include <cstdlib>
@@ -91,6 +108,8 @@ namespace
 class ConfigHolder
 {
     std::unordered_map<std::string_view, std::string> _configEntries;
+    // Configs are read per operation by whichever thread runs it, while the host may set them from another
+    mutable std::unique_ptr<std::shared_mutex> _mutex { std::make_unique<std::shared_mutex>() };
 public:
     ConfigHolder() = default;
 
@@ -101,6 +120,7 @@ public:
 
     std::vector<const char*> GetTypes() const
     {
+        std::shared_lock lock(*_mutex);
         std::vector<const char*> keys(_configEntries.size());
         std::transform(_configEntries.begin(), _configEntries.end(), keys.begin(), [](auto const& pair)
                        {
@@ -111,6 +131,7 @@ public:
 
     std::optional<std::string> TryGet(const std::string_view configType)
     {
+        std::shared_lock lock(*_mutex);
         auto iter = _configEntries.find(configType);
         if (iter == _configEntries.end())
         {
@@ -119,8 +140,22 @@ public:
         return iter->second;
     }
 
+    // True if the config is set to value. Compares in place, so it is cheap enough to check per operation.
+    bool Is(const std::string_view configType, const std::string_view value) const
+    {
+        std::shared_lock lock(*_mutex);
+        auto iter = _configEntries.find(configType);
+        return iter != _configEntries.end() && iter->second == value;
+    }
+
+    bool IsTrue(const std::string_view configType) const
+    {
+        return Is(configType, "True");
+    }
+
     bool TrySet(const std::string_view configType, const std::string_view value)
     {
+        std::unique_lock lock(*_mutex);
         auto iter = _configEntries.find(configType);
         if (iter == _configEntries.end())
         {
@@ -171,6 +206,12 @@ public:
     std::vector<uint8_t> Shift(const std::vector<uint8_t>& input, size_t bitSize)
     {
         assert(input.size() == (bitSize + 7) / 8);
+        return Shift(input.data(), bitSize);
+    }
+
+    // input must hold at least (bitSize + 7) / 8 bytes.
+    std::vector<uint8_t> Shift(const uint8_t* input, size_t bitSize)
+    {
         std::vector<uint8_t> output;
         if (bitSize < 1)
         {
@@ -180,7 +221,7 @@ public:
         {
             // Exact shift
             output = std::move(_value);
-            _value = input;
+            _value.assign(input, input + (bitSize + 7) / 8);
             return output;
         }
 
@@ -214,14 +255,14 @@ public:
             // _value[0:_size-bitSize] = _value[bitSize:_size]
             for (size_t bitOffset = 0; bitOffset < bitCountUnderBy; bitOffset++)
             {
-                SetNthBit(_value, bitOffset, GetNthBit(_value, bitOffset + bitSize));
+                SetNthBit(_value, bitOffset, GetNthBit(_value.data(), bitOffset + bitSize));
             }
 
             // _value[_size-bitSize:_size] = input[0:bitSize]
             for (size_t bitOffset = 0; bitOffset < bitSize; bitOffset++)
             {
                 // Filling remaining value bits from input
-                SetNthBit(_value, bitSize + bitOffset, GetNthBit(input, bitOffset));
+                SetNthBit(_value, bitCountUnderBy + bitOffset, GetNthBit(input, bitOffset));
             }
         }
         return output;
@@ -245,15 +286,174 @@ private:
         }
     }
 
-    bool GetNthBit(const std::vector<uint8_t>& vec, size_t n)
+    bool GetNthBit(const uint8_t* bytes, size_t n)
     {
-        return ((vec[n / 8] >> (n % 8)) & 1) == 1;
+        return ((bytes[n / 8] >> (n % 8)) & 1) == 1;
     }
 
     size_t _size;
     std::vector<uint8_t> _value;
 };
 
+// Copies count bits from src (starting at bit srcBit) to dst (starting at bit dstBit).
+// Byte aligned copies are a memcpy, unaligned copies move up to 8 bits per step.
+void CopyBits(uint8_t* dst, size_t dstBit, const uint8_t* src, size_t srcBit, size_t count)
+{
+    if (dstBit % 8 == 0 && srcBit % 8 == 0)
+    {
+        std::memcpy(dst + dstBit / 8, src + srcBit / 8, count / 8);
+        dstBit += count / 8 * 8;
+        srcBit += count / 8 * 8;
+        count %= 8;
+    }
+    while (count > 0)
+    {
+        const auto dstOffset = static_cast<uint32_t>(dstBit % 8);
+        const auto srcOffset = static_cast<uint32_t>(srcBit % 8);
+        const auto bits      = static_cast<uint32_t>(std::min<size_t>(8 - dstOffset, count));
+        uint32_t window = src[srcBit / 8] >> srcOffset;
+        if (srcOffset + bits > 8)
+        {
+            window |= static_cast<uint32_t>(src[srcBit / 8 + 1]) << (8 - srcOffset);
+        }
+        const auto mask = static_cast<uint8_t>(((1u << bits) - 1) << dstOffset);
+        dst[dstBit / 8] = static_cast<uint8_t>((dst[dstBit / 8] & ~mask) | ((window << dstOffset) & mask));
+        dstBit += bits;
+        srcBit += bits;
+        count -= bits;
+    }
+}
+
+// Sets count bits of dst (starting at bit dstBit) to all 0's or all 1's.
+void FillBits(uint8_t* dst, size_t dstBit, size_t count, bool ones)
+{
+    const uint8_t fill = ones ? 0xFF : 0x00;
+    while (count > 0)
+    {
+        const auto dstOffset = static_cast<uint32_t>(dstBit % 8);
+        if (dstOffset == 0 && count >= 8)
+        {
+            std::memset(dst + dstBit / 8, fill, count / 8);
+            dstBit += count / 8 * 8;
+            count %= 8;
+            continue;
+        }
+        const auto bits = static_cast<uint32_t>(std::min<size_t>(8 - dstOffset, count));
+        const auto mask = static_cast<uint8_t>(((1u << bits) - 1) << dstOffset);
+        dst[dstBit / 8] = static_cast<uint8_t>((dst[dstBit / 8] & ~mask) | (fill & mask));
+        dstBit += bits;
+        count -= bits;
+    }
+}
+
+// Packs captured TDO into a client buffer, which acts as a circular buffer once it is full.
+// Bits are packed a 64 bit word at a time and words are staged into a chunk of bytes, so the client buffer
+// is written with one bit copy per chunk (two when it wraps around) instead of once per captured scan.
+class CaptureBuffer
+{
+public:
+    CaptureBuffer(uint8_t* buffer, uint32_t bufferLengthInBytes) :
+        _buffer(buffer),
+        _bufferBitCount(buffer == nullptr ? 0 : static_cast<size_t>(bufferLengthInBytes) * 8)
+    {
+        _chunk.reserve(ChunkByteCount);
+    }
+
+    void Append(const std::vector<uint8_t>& bits, uint32_t bitCount)
+    {
+        assert(bits.size() >= (bitCount + 7) / 8);
+        for (size_t bitOffset = 0; bitOffset < bitCount; bitOffset += 64)
+        {
+            const auto wordBitCount = static_cast<uint32_t>(std::min<size_t>(64, bitCount - bitOffset));
+            uint64_t word = 0;
+            for (size_t byte = 0; byte < (wordBitCount + 7) / 8; byte++)
+            {
+                word |= static_cast<uint64_t>(bits[bitOffset / 8 + byte]) << (byte * 8);
+            }
+            if (wordBitCount < 64)
+            {
+                word &= (uint64_t { 1 } << wordBitCount) - 1;
+            }
+            AppendWord(word, wordBitCount);
+        }
+    }
+
+    // Flushes everything that is staged and returns the next bit to be written.
+    size_t Finish()
+    {
+        FlushChunk();
+        if (_wordBitCount > 0)
+        {
+            StageWord(_word);
+            WriteBits(_chunk.data(), _wordBitCount);
+            _chunk.clear();
+            _word = 0;
+            _wordBitCount = 0;
+        }
+        return _currentBit;
+    }
+
+private:
+    static constexpr size_t ChunkByteCount = 4096;
+
+    void AppendWord(uint64_t word, uint32_t bitCount)
+    {
+        _word |= word << _wordBitCount;
+        const uint32_t bitsLeftInWord = 64 - _wordBitCount;
+        if (bitCount < bitsLeftInWord)
+        {
+            _wordBitCount += bitCount;
+            return;
+        }
+        StageWord(_word);
+        if (_chunk.size() == ChunkByteCount)
+        {
+            FlushChunk();
+        }
+        _word = bitsLeftInWord < 64 ? word >> bitsLeftInWord : 0;
+        _wordBitCount = bitCount - bitsLeftInWord;
+    }
+
+    void StageWord(uint64_t word)
+    {
+        for (uint32_t byte = 0; byte < 8; byte++)
+        {
+            _chunk.push_back(static_cast<uint8_t>(word >> (byte * 8)));
+        }
+    }
+
+    void FlushChunk()
+    {
+        WriteBits(_chunk.data(), _chunk.size() * 8);
+        _chunk.clear();
+    }
+
+    // Copies the bits to the client buffer from the current bit on, wrapping around at its end
+    void WriteBits(const uint8_t* bits, size_t bitCount)
+    {
+        if (_bufferBitCount == 0)
+        {
+            return;
+        }
+        size_t bitOffset = 0;
+        while (bitCount > 0)
+        {
+            const auto count = std::min(bitCount, _bufferBitCount - _currentBit);
+            CopyBits(_buffer, _currentBit, bits, bitOffset, count);
+            bitOffset += count;
+            bitCount -= count;
+            _currentBit = (_currentBit + count) % _bufferBitCount;
+        }
+    }
+
+    uint8_t* _buffer;
+    size_t _bufferBitCount;
+    size_t _currentBit { 0 };
+    std::vector<uint8_t> _chunk;
+    uint64_t _word { 0 };
+    uint32_t _wordBitCount { 0 };
+};
+
 class PluginHostMethods
 {
     PluginEventCallbackHandler _eventHandlerFunction { nullptr };
@@ -273,8 +473,142 @@ public:
 static PluginHostMethods PLUGIN_HOST_METHODS;
 
 // ==== Operations/Bundles ====
+
+// A slot holds a bit string that operations in a bundle can save TDO to, restore TDI from, modify and compare.
+// Slots are owned by the slot registry, so they live until PPI_Slot_Free whatever happens to the bundle they were
+// allocated on. Loops share the ownership of the slots their body uses, so a loop outlives the slots it was given.
+class ReferenceSlot : public std::enable_shared_from_this<ReferenceSlot>
+{
+public:
+    uint32_t BitCount;
+    std::vector<uint8_t> Value;
+
+    explicit ReferenceSlot(uint32_t bitCount) :
+        BitCount(bitCount),
+        Value((bitCount + 7) / 8, 0)
+    {
+    }
+
+    void Reset()
+    {
+        std::fill(Value.begin(), Value.end(), 0);
+    }
+
+    PPI_SlotHandle ToOpaqueHandle()
+    {
+        return static_cast<PPI_SlotHandle>(this);
+    }
+
+    static ReferenceSlot* FromOpaqueHandle(PPI_SlotHandle handle)
+    {
+        return static_cast<ReferenceSlot*>(handle);
+    }
+
+};
+
+// The slots allocated and not freed yet, each kept alive by the registry until PPI_Slot_Free.
+class ReferenceSlotRegistry
+{
+    std::mutex _mutex;
+    std::unordered_map<const ReferenceSlot*, std::shared_ptr<ReferenceSlot>> _slots;
+public:
+    std::shared_ptr<ReferenceSlot> Allocate(uint32_t bitCount)
+    {
+        auto slot = std::make_shared<ReferenceSlot>(bitCount);
+        std::lock_guard<std::mutex> lock(_mutex);
+        _slots.emplace(slot.get(), slot);
+        return slot;
+    }
+
+    // Drops the registry's ownership of the slot, false if it isn't allocated. Loops that use it keep it alive
+    // until they are freed.
+    bool Free(const ReferenceSlot* slot)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _slots.erase(slot) != 0;
+    }
+};
+static ReferenceSlotRegistry SLOT_REGISTRY;
+
+// Number of bypass bits between TDI and the TAP and between the TAP and TDO, for IR and DR scans.
+struct JtagPadding
+{
+    uint32_t IrPaddingNearTdi { 0 };
+    uint32_t IrPaddingNearTdo { 0 };
+    uint32_t DrPaddingNearTdi { 0 };
+    uint32_t DrPaddingNearTdo { 0 };
+    bool DrValueConstantOne { false };
+};
+
+// Padding change made by a bundle, relative to the padding of the interface it executes on.
+struct JtagPaddingDelta
+{
+    int32_t IrPaddingNearTdi { 0 };
+    int32_t IrPaddingNearTdo { 0 };
+    int32_t DrPaddingNearTdi { 0 };
+    int32_t DrPaddingNearTdo { 0 };
+    bool DrValueConstantOne { false };
+};
+
 namespace ReferenceBundleJtagOperations
 {
+    // TDI as the shift engine reads it: a bit buffer, or all 0's/all 1's when Bits is null.
+    struct TdiBits
+    {
+        const uint8_t* Bits;
+        bool FillWithOnes;
+    };
+
+    // TDI of a scan. Normally a copy of the host's buffer; when the host opted in with SVEPlugin.BorrowTdiBuffers,
+    // only a pointer to the host's buffer, which the host keeps valid until the bundle is executed or cleared.
+    // A scan without a TDI buffer only records its fill value, the engine generates the bits while shifting.
+    class ScanTdi
+    {
+        std::vector<uint8_t> _copy;
+        const uint8_t* _borrowed { nullptr };
+        std::optional<bool> _fillWithOnes;
+    public:
+        ScanTdi() = default;
+
+        explicit ScanTdi(std::vector<uint8_t>&& copy) :
+            _copy(std::move(copy))
+        {
+        }
+
+        static ScanTdi Borrow(const uint8_t* bits)
+        {
+            ScanTdi tdi;
+            tdi._borrowed = bits;
+            return tdi;
+        }
+
+        static ScanTdi Fill(bool withOnes)
+        {
+            ScanTdi tdi;
+            tdi._fillWithOnes = withOnes;
+            return tdi;
+        }
+
+        TdiBits Bits() const
+        {
+            if (_fillWithOnes)
+            {
+                return TdiBits{ nullptr, *_fillWithOnes };
+            }
+            return TdiBits{ _borrowed != nullptr ? _borrowed : _copy.data(), false };
+        }
+
+        // Copies a borrowed buffer, for operations that are kept past the execute or clear of their bundle.
+        void TakeOwnership(uint32_t bitCount)
+        {
+            if (_borrowed != nullptr)
+            {
+                _copy.assign(_borrowed, _borrowed + (bitCount + 7) / 8);
+                _borrowed = nullptr;
+            }
+        }
+    };
+
     struct GoToState
     {
         JtagStateEncode GotoState;
@@ -285,27 +619,225 @@ namespace ReferenceBundleJtagOperations
     struct IrScan
     {
         uint32_t BitCount;
-        std::vector<uint8_t> InBits;
+        ScanTdi InBits;
         uint8_t* OutBits;
+        ReferenceSlot* RestoreTdiFromSlot;
+        ReferenceSlot* SaveTdoToSlot;
     };
     struct DrScan
     {
         uint32_t BitCount;
-        std::vector<uint8_t> InBits;
+        ScanTdi InBits;
+        uint8_t* OutBits;
+        ReferenceSlot* RestoreTdiFromSlot;
+        ReferenceSlot* SaveTdoToSlot;
+    };
+    // A whole register access (RTI or Pause -> Shift-IR/DR -> RTI or Pause) fused into one operation,
+    // instead of the GoToState + Shift + GoToState sequence the state based API needs for the same access.
+    struct RegisterScan
+    {
+        JtagStateEncode ShiftState;
+        JtagStateEncode EndState;
+        uint32_t BitCount;
+        ScanTdi InBits;
+        uint8_t* OutBits;
+        ReferenceSlot* RestoreTdiFromSlot;
+        ReferenceSlot* SaveTdoToSlot;
+    };
+    // Raw pins shift. A caller supplied TMS sequence is interleaved with TDI into one bit vector
+    // (TDI in the even bits, TMS in the odd bits), the order a bit-banging backend clocks them out.
+    // The all 0's, all 1's and last one TMS patterns are generated per clock instead of being stored.
+    struct PinsScan
+    {
+        uint32_t BitCount;
+        std::vector<uint8_t> Pins; // Interleaved TDI/TMS when HasTms, otherwise just TDI
+        bool HasTms;
+        PPI_JTAG_TMS_OPTIONS_ET TmsPattern;
         uint8_t* OutBits;
+        ReferenceSlot* RestoreTdiFromSlot;
+        ReferenceSlot* SaveTdoToSlot;
+
+        bool Tdi(uint32_t clock) const
+        {
+            const size_t bit = HasTms ? 2 * static_cast<size_t>(clock) : clock;
+            return bit / 8 < Pins.size() && ((Pins[bit / 8] >> (bit % 8)) & 1);
+        }
+
+        bool Tms(uint32_t clock) const
+        {
+            if (HasTms)
+            {
+                const size_t bit = 2 * static_cast<size_t>(clock) + 1;
+                return (Pins[bit / 8] >> (bit % 8)) & 1;
+            }
+            switch (TmsPattern)
+            {
+            case JtagOption_TMS_All_Ones:
+                return true;
+            case JtagOption_TMS_Last_One:
+                return clock + 1 == BitCount;
+            default:
+                return false;
+            }
+        }
+    };
+    struct UpdatePadding
+    {
+        JtagPaddingDelta Delta;
+    };
+    struct SlotModification
+    {
+        ReferenceSlot* Slot;
+        std::vector<uint8_t> Mask;
+        std::vector<uint8_t> ValueToOrIn;
+    };
+    struct SlotComparison
+    {
+        ReferenceSlot* Slot;
+        std::vector<uint8_t> Mask;
+        std::vector<uint8_t> Match;
+        PPI_bool* ComparisonResult;
+        bool ExitBundleOnComparisonFailure;
+    };
+    struct LoopBreakOnComparisonSuccess;
+    struct LoopCaptureAll;
+    using SomeOperation = std::variant<GoToState, IrScan, DrScan, RegisterScan, PinsScan, UpdatePadding, SlotModification, SlotComparison, LoopBreakOnComparisonSuccess, LoopCaptureAll>;
+
+    // The whole loop (body, iteration cap and the comparisons in the body) is a single operation,
+    // so it is evaluated by the interface in one execution instead of one execution per iteration.
+    struct LoopBreakOnComparisonSuccess
+    {
+        std::vector<SomeOperation> Body;
+        uint32_t MaxNumberOfIterations;
+        bool ContinueOnTimeoutError;
+        std::vector<std::shared_ptr<ReferenceSlot>> Slots; // Used by the body
     };
-    using SomeOperation = std::variant<GoToState, IrScan, DrScan>;
+
+    // Every iteration's TDO is bit packed into BufferForIterations instead of the body's TDO buffers.
+    struct LoopCaptureAll
+    {
+        std::vector<SomeOperation> Body;
+        uint32_t NumberOfIterations;
+        uint32_t BufferLengthInBytes;
+        uint8_t* BufferForIterations;
+        uint32_t* CurrentBit;
+        std::vector<std::shared_ptr<ReferenceSlot>> Slots; // Used by the body
+    };
+
+    // Calls function with each slot the operation uses. A loop's slots include the ones of the loops in its body.
+    template <typename Function>
+    void ForEachSlot(const SomeOperation& operation, Function&& function)
+    {
+        std::visit([&](const auto& op)
+                   {
+                       if constexpr (is_decay_equ<decltype(op), IrScan> || is_decay_equ<decltype(op), DrScan>
+                                     || is_decay_equ<decltype(op), RegisterScan> || is_decay_equ<decltype(op), PinsScan>)
+                       {
+                           for (auto* slot : { op.RestoreTdiFromSlot, op.SaveTdoToSlot })
+                           {
+                               if (slot != nullptr)
+                               {
+                                   function(*slot);
+                               }
+                           }
+                       }
+                       else if constexpr (is_decay_equ<decltype(op), SlotModification> || is_decay_equ<decltype(op), SlotComparison>)
+                       {
+                           function(*op.Slot);
+                       }
+                       else if constexpr (is_decay_equ<decltype(op), LoopBreakOnComparisonSuccess> || is_decay_equ<decltype(op), LoopCaptureAll>)
+                       {
+                           for (const auto& slot : op.Slots)
+                           {
+                               function(*slot);
+                           }
+                       }
+                   }, operation);
+    }
+
+    // The slots a loop body uses, for the loop to share the ownership of
+    inline std::vector<std::shared_ptr<ReferenceSlot>> ShareSlots(const std::vector<SomeOperation>& body)
+    {
+        std::vector<std::shared_ptr<ReferenceSlot>> slots;
+        for (const auto& operation : body)
+        {
+            ForEachSlot(operation, [&](ReferenceSlot& slot)
+                        {
+                            if (std::none_of(slots.begin(), slots.end(), [&](const auto& shared) { return shared.get() == &slot; }))
+                            {
+                                slots.push_back(slot.shared_from_this());
+                            }
+                        });
+        }
+        return slots;
+    }
+
+    // True if running the operation later can't be observed by the host: it has no TDO write-back,
+    // doesn't touch a slot and doesn't compare, capture or change the padding.
+    inline bool CanBeDeferred(const SomeOperation& operation)
+    {
+        return std::visit([](const auto& op)
+                          {
+                              if constexpr (is_decay_equ<decltype(op), GoToState>)
+                              {
+                                  return true;
+                              }
+                              else if constexpr (is_decay_equ<decltype(op), IrScan> || is_decay_equ<decltype(op), DrScan>
+                                                 || is_decay_equ<decltype(op), RegisterScan> || is_decay_equ<decltype(op), PinsScan>)
+                              {
+                                  return op.OutBits == nullptr && op.RestoreTdiFromSlot == nullptr && op.SaveTdoToSlot == nullptr;
+                              }
+                              else
+                              {
+                                  return false;
+                              }
+                          }, operation);
+    }
+
+    // True if the operation can read the TDO of the scans before it, through a slot. Scans whose TDO is still
+    // on its way back from the receiver must complete before it runs. Loops aren't: their body's operations are checked.
+    inline bool ReadsEarlierTdo(const SomeOperation& operation)
+    {
+        return std::visit([](const auto& op)
+                          {
+                              if constexpr (is_decay_equ<decltype(op), IrScan> || is_decay_equ<decltype(op), DrScan>
+                                            || is_decay_equ<decltype(op), RegisterScan> || is_decay_equ<decltype(op), PinsScan>)
+                              {
+                                  return op.RestoreTdiFromSlot != nullptr;
+                              }
+                              else
+                              {
+                                  return is_decay_equ<decltype(op), SlotModification> || is_decay_equ<decltype(op), SlotComparison>;
+                              }
+                          }, operation);
+    }
+
+    inline void TakeTdiOwnership(SomeOperation& operation)
+    {
+        std::visit([](auto& op)
+                   {
+                       if constexpr (is_decay_equ<decltype(op), IrScan> || is_decay_equ<decltype(op), DrScan> || is_decay_equ<decltype(op), RegisterScan>)
+                       {
+                           op.InBits.TakeOwnership(op.BitCount);
+                       }
+                       else if constexpr (is_decay_equ<decltype(op), LoopBreakOnComparisonSuccess> || is_decay_equ<decltype(op), LoopCaptureAll>)
+                       {
+                           std::for_each(op.Body.begin(), op.Body.end(), TakeTdiOwnership);
+                       }
+                   }, operation);
+    }
 }
 
 class ReferenceJtagBundle
 {
     std::vector<ReferenceBundleJtagOperations::SomeOperation> _operations;
+    std::vector<std::weak_ptr<ReferenceSlot>> _slots; // Allocated on the bundle, for their data to be reset
+    JtagPaddingDelta _padding;
 public:
-    ReferenceJtagBundle()  = default;
-    ~ReferenceJtagBundle() = default;
-    ReferenceJtagBundle(const ReferenceJtagBundle& other)     = delete;
+    ReferenceJtagBundle() = default;
+    ReferenceJtagBundle(const ReferenceJtagBundle& other) = delete;
     ReferenceJtagBundle(ReferenceJtagBundle&& other) noexcept = default;
-    ReferenceJtagBundle& operator=(const ReferenceJtagBundle& other)     = delete;
+    ReferenceJtagBundle& operator=(const ReferenceJtagBundle& other) = delete;
     ReferenceJtagBundle& operator=(ReferenceJtagBundle&& other) noexcept = default;
 
     OpenIPC_Error AppendJtagGoToState(JtagStateEncode gotoState, uint32_t numberOfClocksInState, bool waitForTrigger, bool errorOnTimeout)
@@ -314,18 +846,112 @@ public:
         return OpenIPC_Error_No_Error;
     }
 
-    OpenIPC_Error AppendIrScan(uint32_t bitCount, std::vector<uint8_t>&& inBits, uint8_t* outBits)
+    OpenIPC_Error AppendIrScan(uint32_t bitCount, ReferenceBundleJtagOperations::ScanTdi&& inBits, uint8_t* outBits, ReferenceSlot* restoreTdiFromSlot, ReferenceSlot* saveTdoToSlot)
+    {
+        _operations.emplace_back(ReferenceBundleJtagOperations::IrScan{ bitCount, std::move(inBits), outBits, restoreTdiFromSlot, saveTdoToSlot });
+        return OpenIPC_Error_No_Error;
+    }
+
+    OpenIPC_Error AppendDrScan(uint32_t bitCount, ReferenceBundleJtagOperations::ScanTdi&& inBits, uint8_t* outBits, ReferenceSlot* restoreTdiFromSlot, ReferenceSlot* saveTdoToSlot)
+    {
+        _operations.emplace_back(ReferenceBundleJtagOperations::DrScan{ bitCount, std::move(inBits), outBits, restoreTdiFromSlot, saveTdoToSlot });
+        return OpenIPC_Error_No_Error;
+    }
+
+    OpenIPC_Error AppendRegisterScan(bool isIrScan, bool stopInPause, uint32_t bitCount, ReferenceBundleJtagOperations::ScanTdi&& inBits, uint8_t* outBits, ReferenceSlot* restoreTdiFromSlot, ReferenceSlot* saveTdoToSlot)
+    {
+        const auto shiftState = isIrScan ? JtagShfIR : JtagShfDR;
+        const auto pauseState = isIrScan ? JtagPauIR : JtagPauDR;
+        _operations.emplace_back(ReferenceBundleJtagOperations::RegisterScan{ shiftState, stopInPause ? pauseState : JtagRTI, bitCount, std::move(inBits), outBits, restoreTdiFromSlot, saveTdoToSlot });
+        return OpenIPC_Error_No_Error;
+    }
+
+    OpenIPC_Error AppendPinsScan(uint32_t bitCount, std::vector<uint8_t>&& pins, bool hasTms, PPI_JTAG_TMS_OPTIONS_ET tmsPattern, uint8_t* outBits, ReferenceSlot* restoreTdiFromSlot, ReferenceSlot* saveTdoToSlot)
+    {
+        _operations.emplace_back(ReferenceBundleJtagOperations::PinsScan{ bitCount, std::move(pins), hasTms, tmsPattern, outBits, restoreTdiFromSlot, saveTdoToSlot });
+        return OpenIPC_Error_No_Error;
+    }
+
+    OpenIPC_Error AppendUpdatePadding(const JtagPaddingDelta& delta)
+    {
+        _padding.IrPaddingNearTdi += delta.IrPaddingNearTdi;
+        _padding.IrPaddingNearTdo += delta.IrPaddingNearTdo;
+        _padding.DrPaddingNearTdi += delta.DrPaddingNearTdi;
+        _padding.DrPaddingNearTdo += delta.DrPaddingNearTdo;
+        _padding.DrValueConstantOne = delta.DrValueConstantOne;
+        _operations.emplace_back(ReferenceBundleJtagOperations::UpdatePadding{ delta });
+        return OpenIPC_Error_No_Error;
+    }
+
+    const JtagPaddingDelta& GetPadding() const
+    {
+        return _padding;
+    }
+
+    OpenIPC_Error AppendSlotModification(ReferenceSlot* slot, std::vector<uint8_t>&& mask, std::vector<uint8_t>&& valueToOrIn)
+    {
+        _operations.emplace_back(ReferenceBundleJtagOperations::SlotModification{ slot, std::move(mask), std::move(valueToOrIn) });
+        return OpenIPC_Error_No_Error;
+    }
+
+    OpenIPC_Error AppendSlotComparison(ReferenceSlot* slot, std::vector<uint8_t>&& mask, std::vector<uint8_t>&& match, PPI_bool* comparisonResult, bool exitBundleOnComparisonFailure)
+    {
+        _operations.emplace_back(ReferenceBundleJtagOperations::SlotComparison{ slot, std::move(mask), std::move(match), comparisonResult, exitBundleOnComparisonFailure });
+        return OpenIPC_Error_No_Error;
+    }
+
+    OpenIPC_Error AppendLoopBreakOnComparisonSuccess(const ReferenceJtagBundle& body, uint32_t maxNumberOfIterations, bool continueOnTimeoutError)
     {
-        _operations.emplace_back(ReferenceBundleJtagOperations::IrScan{ bitCount, std::move(inBits), outBits });
+        // The body is copied, so the client is free to clear, reuse or free it after this call.
+        // The loop shares the ownership of the slots the body uses, wherever they were allocated.
+        auto& loop = std::get<ReferenceBundleJtagOperations::LoopBreakOnComparisonSuccess>(_operations.emplace_back(ReferenceBundleJtagOperations::LoopBreakOnComparisonSuccess{ body._operations, maxNumberOfIterations, continueOnTimeoutError, ReferenceBundleJtagOperations::ShareSlots(body._operations) }));
+        std::for_each(loop.Body.begin(), loop.Body.end(), ReferenceBundleJtagOperations::TakeTdiOwnership);
         return OpenIPC_Error_No_Error;
     }
 
-    OpenIPC_Error AppendDrScan(uint32_t bitCount, std::vector<uint8_t>&& inBits, uint8_t* outBits)
+    OpenIPC_Error AppendLoopCaptureAll(const ReferenceJtagBundle& body, uint32_t numberOfIterations, uint32_t bufferLengthInBytes, uint8_t* bufferForIterations, uint32_t* currentBit)
     {
-        _operations.emplace_back(ReferenceBundleJtagOperations::DrScan{ bitCount, std::move(inBits), outBits });
+        auto& loop = std::get<ReferenceBundleJtagOperations::LoopCaptureAll>(_operations.emplace_back(ReferenceBundleJtagOperations::LoopCaptureAll{ body._operations, numberOfIterations, bufferLengthInBytes, bufferForIterations, currentBit, ReferenceBundleJtagOperations::ShareSlots(body._operations) }));
+        std::for_each(loop.Body.begin(), loop.Body.end(), ReferenceBundleJtagOperations::TakeTdiOwnership);
         return OpenIPC_Error_No_Error;
     }
 
+    ReferenceSlot* AllocateSlot(uint32_t bitCount)
+    {
+        _slots.erase(std::remove_if(_slots.begin(), _slots.end(), [](const auto& slot) { return slot.expired(); }), _slots.end());
+        auto slot = SLOT_REGISTRY.Allocate(bitCount);
+        _slots.push_back(slot);
+        return slot.get();
+    }
+
+    // The data in the slots is reset when the lock is released: the bundle's own slots and the ones its operations use.
+    void ResetSlots()
+    {
+        for (const auto& allocated : _slots)
+        {
+            if (const auto slot = allocated.lock())
+            {
+                slot->Reset();
+            }
+        }
+        for (const auto& operation : _operations)
+        {
+            ReferenceBundleJtagOperations::ForEachSlot(operation, [](ReferenceSlot& slot) { slot.Reset(); });
+        }
+    }
+
+    bool CanBeDeferred() const
+    {
+        return std::all_of(_operations.begin(), _operations.end(), ReferenceBundleJtagOperations::CanBeDeferred);
+    }
+
+    // Clearing only removes the operations, slots stay allocated until the bundle is freed.
+    void Clear()
+    {
+        _operations.clear();
+        _padding = {};
+    }
+
     std::vector<ReferenceBundleJtagOperations::SomeOperation>& GetOperations()
     {
         return _operations;
@@ -460,163 +1086,2732 @@ ReferenceBundle* RetrieveBundle(PPI_ProbeBundleHandle handle)
     return static_cast<ReferenceBundle*>(handle);
 }
 
-// ==== Interfaces ====
-
-class ReferenceJtagInterface
+// Returns nullptr if the bundle already holds operations for another interface type.
+ReferenceJtagBundle* RetrieveJtagBundle(PPI_ProbeBundleHandle handle)
 {
-    bool _isInitializing { false };
-    bool _isInitialized { false };
-    JtagStateEncode _currentState { JtagRTI };
+    const auto bundle = RetrieveBundle(handle);
+    if (std::holds_alternative<std::monostate>(*bundle))
+    {
+        *bundle = ReferenceJtagBundle{}; // Empty bundle can become a Jtag bundle
+    }
+    return std::get_if<ReferenceJtagBundle>(bundle);
+}
 
-    std::vector<uint8_t> _idcodeIrValue { 0x2 };
-    ShiftRegister _irRegister { 8, { 0x2 } };
-    ShiftRegister _idcodeRegister { 32, { } }; // idcode = 0x12345679
-    ShiftRegister _bypassRegister { 1, { 0 } };
+// ==== Receiver ====
 
+// Source of the request ids of a probe's session. Ids are a 64-bit sequence, so they don't collide when more
+// than one request is issued per clock tick, and taking one is a single atomic increment.
+class RequestIdSequence
+{
+    std::atomic<uint64_t> _next { 1 };
 public:
-    ConfigHolder Configs;
-    PPI_RefId InterfaceRefId;
-    OpenIPC_DeviceId InterfaceDeviceId { OpenIPC_INVALID_DEVICE_ID };
+    static constexpr size_t TextLength = 16;
 
-    explicit ReferenceJtagInterface(PPI_RefId interfaceRefId, std::vector<uint8_t> idcodeValue) :
-        InterfaceRefId(interfaceRefId),
-        _idcodeRegister(32, idcodeValue)
+    RequestIdSequence() = default;
+    RequestIdSequence(RequestIdSequence&& other) noexcept :
+        _next(other._next.load())
     {
+    }
+    RequestIdSequence& operator=(RequestIdSequence&& other) noexcept
+    {
+        _next = other._next.load();
+        return *this;
+    }
 
+    uint64_t Next() noexcept
+    {
+        return _next.fetch_add(1, std::memory_order_relaxed);
     }
 
-    ~ReferenceJtagInterface() = default;
-    ReferenceJtagInterface(const ReferenceJtagInterface& other)     = delete;
-    ReferenceJtagInterface(ReferenceJtagInterface&& other) noexcept = default;
-    ReferenceJtagInterface& operator=(const ReferenceJtagInterface& other)     = delete;
-    ReferenceJtagInterface& operator=(ReferenceJtagInterface&& other) noexcept = default;
+    // Fixed width text form (16 hex digits) carried by the XML requests, formatted without allocating.
+    static std::array<char, TextLength> ToText(uint64_t requestId) noexcept
+    {
+        static constexpr char hexDigits[] = "0123456789ABCDEF";
+        std::array<char, TextLength> text;
+        for (size_t digit = TextLength; digit > 0; digit--)
+        {
+            text[digit - 1] = hexDigits[requestId & 0xF];
+            requestId >>= 4;
+        }
+        return text;
+    }
+};
+
+// Socket to the receiver. Heap allocated so its address stays the same while the handshake runs on
+// another thread, and so it can be handed on to a channel once the handshake is done.
+struct ReceiverConnection
+{
+    WSADATA wsaData;
+    SOCKET sock { INVALID_SOCKET };
+    sockaddr_in serverAddr{};
+};
+
+// Finds the receivers listening on a list of endpoints. All the endpoints are connected to at once with
+// non-blocking sockets, so discovering any number of receivers takes at most one timeout window.
+namespace ReceiverDiscovery
+{
+    // Parses "ip:port,ip:port,...". Malformed entries are skipped.
+    inline std::vector<sockaddr_in> ParseEndpoints(std::string_view endpoints)
+    {
+        std::vector<sockaddr_in> addresses;
+        while (!endpoints.empty())
+        {
+            const auto separator = endpoints.find(',');
+            const auto entry     = endpoints.substr(0, separator);
+            endpoints = separator == std::string_view::npos ? std::string_view() : endpoints.substr(separator + 1);
+
+            const auto colon = entry.rfind(':');
+            if (colon == std::string_view::npos)
+            {
+                continue;
+            }
+            const std::string host(entry.substr(0, colon));
+            const std::string portText(entry.substr(colon + 1));
+            char* portEnd = nullptr;
+            const unsigned long port = std::strtoul(portText.c_str(), &portEnd, 10);
+            sockaddr_in address{};
+            address.sin_family      = AF_INET;
+            address.sin_port        = htons(static_cast<uint16_t>(port));
+            address.sin_addr.s_addr = inet_addr(host.c_str());
+            if (portText.empty() || *portEnd != '\0' || port == 0 || port > 0xFFFF || address.sin_addr.s_addr == INADDR_NONE)
+            {
+                continue;
+            }
+            addresses.push_back(address);
+        }
+        return addresses;
+    }
+
+    // Identifies an endpoint by its address and port
+    inline uint64_t EndpointKey(const sockaddr_in& endpoint) noexcept
+    {
+        return (static_cast<uint64_t>(endpoint.sin_addr.s_addr) << 16) | endpoint.sin_port;
+    }
+
+    inline void Close(ReceiverConnection& connection) noexcept
+    {
+        if (connection.sock != INVALID_SOCKET)
+        {
+            closesocket(connection.sock);
+            connection.sock = INVALID_SOCKET;
+        }
+        WSACleanup();
+    }
+
+    // How often a connect checks whether it was canceled
+    constexpr std::chrono::milliseconds CancelCheckInterval { 10 };
+
+    // Returns a connected (blocking) connection for each endpoint that accepted before the deadline (which can be
+    // time_point::max() to wait as long as the OS does). The connects are given up on once isCanceled returns true.
+    inline std::vector<std::unique_ptr<ReceiverConnection>> ConnectAll(const std::vector<sockaddr_in>& endpoints, std::chrono::steady_clock::time_point deadline,
+                                                                       const std::function<bool()>& isCanceled = {})
+    {
+        std::vector<std::unique_ptr<ReceiverConnection>> connecting;
+        for (const auto& endpoint : endpoints)
+        {
+            auto connection = std::make_unique<ReceiverConnection>();
+            WSAStartup(MAKEWORD(2, 2), &connection->wsaData);
+            connection->serverAddr = endpoint;
+            connection->sock       = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            u_long nonBlocking = 1;
+            if (connection->sock == INVALID_SOCKET || ioctlsocket(connection->sock, FIONBIO, &nonBlocking) == SOCKET_ERROR)
+            {
+                Close(*connection);
+                continue;
+            }
+            if (connect(connection->sock, (SOCKADDR*)&connection->serverAddr, sizeof(connection->serverAddr)) == SOCKET_ERROR
+                && WSAGetLastError() != WSAEWOULDBLOCK)
+            {
+                Close(*connection);
+                continue;
+            }
+            connecting.push_back(std::move(connection));
+        }
+
+        std::vector<std::unique_ptr<ReceiverConnection>> connected;
+        std::vector<WSAPOLLFD> pollFds;
+        while (!connecting.empty() && !(isCanceled && isCanceled()))
+        {
+            INT timeoutMs = -1;
+            if (deadline != std::chrono::steady_clock::time_point::max())
+            {
+                const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                if (remaining.count() <= 0)
+                {
+                    break;
+                }
+                timeoutMs = static_cast<INT>(std::min<std::chrono::milliseconds::rep>(remaining.count(), std::numeric_limits<INT>::max()));
+            }
+            if (isCanceled)
+            {
+                timeoutMs = timeoutMs < 0 ? static_cast<INT>(CancelCheckInterval.count()) : std::min(timeoutMs, static_cast<INT>(CancelCheckInterval.count()));
+            }
+            pollFds.clear();
+            for (const auto& connection : connecting)
+            {
+                pollFds.push_back(WSAPOLLFD{ connection->sock, POLLWRNORM, 0 });
+            }
+            const int ready = WSAPoll(pollFds.data(), static_cast<ULONG>(pollFds.size()), timeoutMs);
+            if (ready < 0)
+            {
+                break;
+            }
+            if (ready == 0)
+            {
+                continue;
+            }
+            // Move the completed connects out of connecting, keeping the order of the rest
+            size_t stillConnecting = 0;
+            for (size_t index = 0; index < connecting.size(); index++)
+            {
+                const auto events = pollFds[index].revents;
+                if (events == 0)
+                {
+                    connecting[stillConnecting++] = std::move(connecting[index]);
+                }
+                else if ((events & (POLLERR | POLLHUP)) == 0)
+                {
+                    u_long blocking = 0;
+                    ioctlsocket(connecting[index]->sock, FIONBIO, &blocking);
+                    connected.push_back(std::move(connecting[index]));
+                }
+                else
+                {
+                    Close(*connecting[index]);
+                }
+            }
+            connecting.resize(stillConnecting);
+        }
+        for (auto& connection : connecting)
+        {
+            Close(*connection);
+        }
+        return connected;
+    }
+
+    inline std::vector<std::unique_ptr<ReceiverConnection>> ConnectAll(const std::vector<sockaddr_in>& endpoints, std::chrono::milliseconds timeout)
+    {
+        return ConnectAll(endpoints, std::chrono::steady_clock::now() + timeout);
+    }
+
+    // Connects to one endpoint as ConnectAll does, returning nullptr if it didn't accept
+    inline std::unique_ptr<ReceiverConnection> Connect(const sockaddr_in& endpoint, std::chrono::steady_clock::time_point deadline,
+                                                       const std::function<bool()>& isCanceled = {})
+    {
+        auto connections = ConnectAll({ endpoint }, deadline, isCanceled);
+        return connections.empty() ? nullptr : std::move(connections.front());
+    }
+
+    // The deadline of a connect given a timeout, where 0 is no deadline
+    inline std::chrono::steady_clock::time_point ConnectDeadline(std::chrono::milliseconds timeout) noexcept
+    {
+        return timeout.count() > 0 ? std::chrono::steady_clock::now() + timeout : std::chrono::steady_clock::time_point::max();
+    }
+}
+
+// Requests and responses of the receiver's XML protocol. The messages are flat, with fixed element names,
+// so they are built and read as text instead of going through an XML parser.
+namespace ReceiverProtocol
+{
+    // A request carries the probe's session, which the receiver keeps the probe's state under, and its id in the session
+    inline void AppendRequestId(std::string& request, uint64_t session, uint64_t requestId)
+    {
+        const auto sessionText   = RequestIdSequence::ToText(session);
+        const auto requestIdText = RequestIdSequence::ToText(requestId);
+        request += "<request_id>";
+        request.append(requestIdText.data(), requestIdText.size());
+        request += "</request_id><session>";
+        request.append(sessionText.data(), sessionText.size());
+        request += "</session>";
+    }
+
+    // The compression a probe offers in its handshake, and the receiver names in its response when it accepts it.
+    // It lets byte lists carry runs, and the TDO of a scan sent with a DeltaPoll be answered relative to the last one.
+    constexpr std::string_view RunLengthCompression = "RunLength";
+
+    // Appends bytes as "0x00, 0x11, ...". With runLength, repeated bytes are written once, as "0x00*12".
+    inline void AppendByteList(std::string& text, const uint8_t* bytes, size_t byteCount, bool runLength)
+    {
+        static constexpr char hexDigits[] = "0123456789ABCDEF";
+        for (size_t byte = 0; byte < byteCount;)
+        {
+            size_t run = 1;
+            while (runLength && byte + run < byteCount && bytes[byte + run] == bytes[byte])
+            {
+                run++;
+            }
+            if (byte > 0)
+            {
+                text += ", ";
+            }
+            const char token[] = { '0', 'x', hexDigits[bytes[byte] >> 4], hexDigits[bytes[byte] & 0xF] };
+            text.append(token, sizeof(token));
+            if (run > 1)
+            {
+                text += '*';
+                text += std::to_string(run);
+            }
+            byte += run;
+        }
+    }
+
+    // Reads a byte list into output, which is sized for it. Runs are read whether or not they were negotiated.
+    inline bool ParseByteList(std::string_view text, std::vector<uint8_t>& output)
+    {
+        size_t byte = 0;
+        while (!text.empty())
+        {
+            const auto separator = text.find(',');
+            auto token = text.substr(0, separator);
+            text = separator == std::string_view::npos ? std::string_view() : text.substr(separator + 1);
+
+            const auto first = token.find_first_not_of(' ');
+            token = first == std::string_view::npos ? std::string_view() : token.substr(first, token.find_last_not_of(' ') - first + 1);
+            size_t run = 1;
+            const auto star = token.find('*');
+            if (star != std::string_view::npos)
+            {
+                const std::string runText(token.substr(star + 1));
+                char* runEnd = nullptr;
+                run   = runText.empty() || !std::isdigit(static_cast<unsigned char>(runText[0])) ? 0 : std::strtoull(runText.c_str(), &runEnd, 10);
+                token = token.substr(0, star);
+                if (run == 0 || *runEnd != '\0')
+                {
+                    return false;
+                }
+            }
+            if (token.size() < 3 || token.size() > 4 || token[0] != '0' || (token[1] != 'x' && token[1] != 'X') || run > output.size() - byte)
+            {
+                return false;
+            }
+            uint8_t value = 0;
+            for (const char digit : token.substr(2))
+            {
+                const char upper = static_cast<char>(std::toupper(static_cast<unsigned char>(digit)));
+                if (!std::isxdigit(static_cast<unsigned char>(upper)))
+                {
+                    return false;
+                }
+                value = static_cast<uint8_t>((value << 4) | (upper <= '9' ? upper - '0' : upper - 'A' + 10));
+            }
+            std::fill_n(output.begin() + static_cast<std::ptrdiff_t>(byte), run, value);
+            byte += run;
+        }
+        return byte == output.size();
+    }
+
+    // Names a scan for delta responses: Key is its signature (see ReferenceJtagInterface::ReceiverDeltaKey), and
+    // BaseRequestId the request whose TDO the probe has for it (0 for none)
+    struct DeltaPoll
+    {
+        uint64_t Key;
+        uint64_t BaseRequestId;
+    };
+
+    // Shifts bitCount bits through the receiver's data register. The input is sent as a byte list, with runs once
+    // the session negotiated RunLengthCompression. A scan with a poll may be answered relative to its base.
+    inline std::string BuildShiftRequest(uint64_t session, uint64_t requestId, const uint8_t* inBits, size_t bitCount,
+                                         bool runLength = false, const DeltaPoll* poll = nullptr)
+    {
+        const size_t byteCount = (bitCount + 7) / 8;
+        std::string request;
+        request.reserve(160 + byteCount * 6);
+        request += "<request>";
+        AppendRequestId(request, session, requestId);
+        if (poll != nullptr)
+        {
+            const auto keyText = RequestIdSequence::ToText(poll->Key);
+            request += "<deltaKey>";
+            request.append(keyText.data(), keyText.size());
+            request += "</deltaKey>";
+            if (poll->BaseRequestId != 0)
+            {
+                const auto baseText = RequestIdSequence::ToText(poll->BaseRequestId);
+                request += "<deltaBase>";
+                request.append(baseText.data(), baseText.size());
+                request += "</deltaBase>";
+            }
+        }
+        request += "<initialize>False</initialize><bitSize>";
+        request += std::to_string(bitCount);
+        request += "</bitSize><input>";
+        AppendByteList(request, inBits, byteCount, runLength);
+        request += "</input></request>";
+        return request;
+    }
+
+    // Asks the receiver to answer the listed requests of the session with a CANCELED status, instead of executing
+    // them, if it hasn't yet
+    inline std::string BuildCancelRequest(uint64_t session, uint64_t requestId, const std::vector<std::string>& canceledRequestIds)
+    {
+        std::string request = "<request>";
+        AppendRequestId(request, session, requestId);
+        request += "<cancel>";
+        for (size_t index = 0; index < canceledRequestIds.size(); index++)
+        {
+            if (index > 0)
+            {
+                request += ", ";
+            }
+            request += canceledRequestIds[index];
+        }
+        request += "</cancel></request>";
+        return request;
+    }
+
+    // Text of the first <tag> element of xml, empty if it has none.
+    inline std::string_view FindElement(std::string_view xml, std::string_view tag)
+    {
+        const std::string open  = "<" + std::string(tag) + ">";
+        const std::string close = "</" + std::string(tag) + ">";
+        const auto begin = xml.find(open);
+        if (begin == std::string_view::npos)
+        {
+            return {};
+        }
+        const auto end = xml.find(close, begin + open.size());
+        if (end == std::string_view::npos)
+        {
+            return {};
+        }
+        return xml.substr(begin + open.size(), end - begin - open.size());
+    }
+
+    // Reads the output of a shift response into output, which is sized for the shift. A response to a scan sent
+    // with a DeltaPoll may instead say the output is unchanged from deltaBase, or carry its XOR with deltaBase.
+    inline bool ParseShiftResponse(std::string_view response, std::vector<uint8_t>& output, const std::vector<uint8_t>* deltaBase = nullptr)
+    {
+        if (FindElement(response, "status") != "OK")
+        {
+            return false;
+        }
+        if (deltaBase == nullptr || deltaBase->size() != output.size())
+        {
+            return ParseByteList(FindElement(response, "output"), output);
+        }
+        if (FindElement(response, "unchanged") == "True")
+        {
+            output = *deltaBase;
+            return true;
+        }
+        const auto delta = FindElement(response, "delta");
+        if (delta.empty())
+        {
+            return ParseByteList(FindElement(response, "output"), output);
+        }
+        if (!ParseByteList(delta, output))
+        {
+            return false;
+        }
+        for (size_t byte = 0; byte < output.size(); byte++)
+        {
+            output[byte] ^= (*deltaBase)[byte];
+        }
+        return true;
+    }
+
+    // The loops a probe offers in its handshake, and the receiver echoes when it evaluates loop requests
+    constexpr std::string_view LoopsAccepted = "True";
+
+    // A shift of a loop's body through the receiver's data register
+    struct LoopShift
+    {
+        std::vector<uint8_t> InBits;
+        size_t BitCount;
+    };
+
+    // Compares the output of the body's shift Shift to Match under Mask, over as many bytes as the mask has
+    struct LoopComparison
+    {
+        size_t Shift;
+        std::vector<uint8_t> Mask;
+        std::vector<uint8_t> Match;
+    };
+
+    // Runs the shifts of a loop's body on the receiver up to maxIterations times, until an iteration in which one of
+    // the comparisons matches. The elements are numbered, so each is found as the first of its tag.
+    inline std::string BuildLoopRequest(uint64_t session, uint64_t requestId, uint32_t maxIterations, const std::vector<LoopShift>& shifts,
+                                        const std::vector<LoopComparison>& comparisons, bool runLength = false)
+    {
+        std::string request = "<request>";
+        AppendRequestId(request, session, requestId);
+        request += "<initialize>False</initialize><loop>" + std::to_string(maxIterations) + "</loop><shifts>" + std::to_string(shifts.size()) + "</shifts>";
+        for (size_t index = 0; index < shifts.size(); index++)
+        {
+            const auto number = std::to_string(index);
+            request += "<bitSize" + number + ">" + std::to_string(shifts[index].BitCount) + "</bitSize" + number + "><input" + number + ">";
+            AppendByteList(request, shifts[index].InBits.data(), shifts[index].InBits.size(), runLength);
+            request += "</input" + number + ">";
+        }
+        request += "<comparisons>" + std::to_string(comparisons.size()) + "</comparisons>";
+        for (size_t index = 0; index < comparisons.size(); index++)
+        {
+            const auto number = std::to_string(index);
+            request += "<compareShift" + number + ">" + std::to_string(comparisons[index].Shift) + "</compareShift" + number + "><mask" + number + ">";
+            AppendByteList(request, comparisons[index].Mask.data(), comparisons[index].Mask.size(), runLength);
+            request += "</mask" + number + "><match" + number + ">";
+            AppendByteList(request, comparisons[index].Match.data(), comparisons[index].Match.size(), runLength);
+            request += "</match" + number + ">";
+        }
+        request += "</request>";
+        return request;
+    }
+
+    // Reads the outputs of the last iteration a loop request ran into outputs, which are sized for its shifts, and
+    // how many iterations it ran
+    inline bool ParseLoopResponse(std::string_view response, std::vector<std::vector<uint8_t>>& outputs, uint32_t maxIterations, uint32_t& iterations)
+    {
+        if (FindElement(response, "status") != "OK")
+        {
+            return false;
+        }
+        const std::string iterationsText(FindElement(response, "iterations"));
+        char* iterationsEnd = nullptr;
+        const auto count = std::strtoull(iterationsText.c_str(), &iterationsEnd, 10);
+        if (iterationsText.empty() || *iterationsEnd != '\0' || count == 0 || count > maxIterations)
+        {
+            return false;
+        }
+        iterations = static_cast<uint32_t>(count);
+        for (size_t index = 0; index < outputs.size(); index++)
+        {
+            if (!ParseByteList(FindElement(response, "output" + std::to_string(index)), outputs[index]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+// When requests queued on a channel are sent. A batch is sent once it holds MaxBytes, or when a request is
+// queued Window or more after the batch's first one; until then it waits for more requests, or for a response
+// to be needed. The default sends each request as it is queued.
+struct ReceiverCoalescing
+{
+    std::chrono::microseconds Window { 0 };
+    size_t MaxBytes { 0 };
+};
+
+// How a channel whose connection dropped reconnects: up to Attempts times, waiting Backoff before the first
+// attempt and twice as long before each next one. No attempts leaves a dropped channel closed.
+struct ReceiverReconnect
+{
+    uint32_t Attempts { 0 };
+    std::chrono::milliseconds Backoff { 0 };
+};
+
+// Why a channel failed to get a response
+enum class ReceiverFailure
+{
+    None,
+    Lost,     // The connection dropped, and couldn't be reconnected
+    TimedOut, // The oldest unanswered request passed its deadline
+    Canceled, // Cancel was called
+};
+
+// A connection to the receiver. Requests are queued and sent in batches, and the receiver answers them in
+// order, so the response to the oldest unanswered request is everything received up to the next </response>.
+//
+// Flow control is credit based: the receiver advertises, in each response, the window of request bytes it
+// buffers for a connection, and the requests queued or sent but not answered yet have to fit in it. The caller
+// checks HasCredit before queuing, and when there is none, waits for responses or gives up.
+//
+// A dropped connection is reconnected, and the unanswered requests are sent again on the new one. The receiver
+// keeps the state of the probe's session across connections, and answers a request it already executed with the
+// response it sent then, so replaying a request that made it through before the drop doesn't shift twice.
+//
+// Each request has a deadline for its response. A wait that passes it, or is canceled, leaves the channel out of
+// step with the receiver, so the caller abandons the channel and has the receiver drop its unanswered requests.
+class ReceiverChannel
+{
+    std::unique_ptr<ReceiverConnection> _connection;
+    // Requests queued but not sent yet, and when the first of them was queued
+    std::string _batch;
+    std::chrono::steady_clock::time_point _batchStart;
+    // Bytes received past the end of the last response
+    std::string _received;
+    // The unanswered requests, oldest first, kept to be replayed after a reconnect, and their total size
+    struct UnansweredRequest
+    {
+        std::string Text;
+        std::chrono::steady_clock::time_point Deadline;
+    };
+    std::deque<UnansweredRequest> _unansweredRequests;
+    size_t _unansweredBytes { 0 };
+    size_t _window;
+    ReceiverReconnect _reconnect;
+    // How long a request may wait for its response, 0 for as long as it takes
+    std::chrono::milliseconds _requestTimeout { 0 };
+    ReceiverFailure _failure { ReceiverFailure::None };
+    // Set by Cancel from another thread, which also shuts the socket down to wake a blocked send or receive.
+    // The mutex keeps the socket from being replaced while it is shut down.
+    std::atomic<bool> _canceled { false };
+    std::mutex _socketMutex;
+public:
+    // Used until the receiver advertises its window
+    static constexpr size_t DefaultWindow = 64 * 1024;
+
+    // window is the receiver's window as last advertised, until the channel's own responses advertise it
+    explicit ReceiverChannel(std::unique_ptr<ReceiverConnection> connection, size_t window = DefaultWindow) :
+        _connection(std::move(connection)),
+        _window(window)
+    {
+    }
+
+    ~ReceiverChannel()
+    {
+        ReceiverDiscovery::Close(*_connection);
+    }
+    ReceiverChannel(const ReceiverChannel& other) = delete;
+    ReceiverChannel& operator=(const ReceiverChannel& other) = delete;
+
+    // Returns nullptr if the receiver can't be connected to before the deadline, or the connect is canceled
+    static std::unique_ptr<ReceiverChannel> Open(const sockaddr_in& address, size_t window, std::chrono::steady_clock::time_point deadline,
+                                                 const std::function<bool()>& isCanceled = {})
+    {
+        auto connection = ReceiverDiscovery::Connect(address, deadline, isCanceled);
+        if (!connection)
+        {
+            return nullptr;
+        }
+        return std::make_unique<ReceiverChannel>(std::move(connection), window);
+    }
+
+    bool IsOpen() const noexcept
+    {
+        return _connection->sock != INVALID_SOCKET;
+    }
+
+    void SetReconnect(const ReceiverReconnect& reconnect) noexcept
+    {
+        _reconnect = reconnect;
+    }
+
+    void SetRequestTimeout(std::chrono::milliseconds requestTimeout) noexcept
+    {
+        _requestTimeout = requestTimeout;
+    }
+
+    std::chrono::milliseconds RequestTimeout() const noexcept
+    {
+        return _requestTimeout;
+    }
+
+    ReceiverFailure Failure() const noexcept
+    {
+        return _failure;
+    }
+
+    // Fails the exchange in progress on another thread, and the ones after it. Can be called from any thread.
+    void Cancel() noexcept
+    {
+        std::lock_guard lock(_socketMutex);
+        _canceled = true;
+        if (_connection->sock != INVALID_SOCKET)
+        {
+            shutdown(_connection->sock, SD_BOTH);
+        }
+    }
+
+    // Closes the channel, and returns the ids of the requests it leaves unanswered
+    std::vector<std::string> Abandon()
+    {
+        std::vector<std::string> requestIds;
+        requestIds.reserve(_unansweredRequests.size());
+        for (const auto& request : _unansweredRequests)
+        {
+            requestIds.emplace_back(ReceiverProtocol::FindElement(request.Text, "request_id"));
+        }
+        _disconnect();
+        return requestIds;
+    }
+
+    // Sends a request on its own and waits for its response
+    bool Exchange(std::string_view request, std::string& response)
+    {
+        return Queue(request, ReceiverCoalescing{}) && Receive(response);
+    }
+
+    // True if a request of this size fits in the receiver's window. A request is always let through when
+    // nothing is unanswered, even if it is bigger than the window, as no response could make room for it.
+    bool HasCredit(size_t requestBytes) const noexcept
+    {
+        return _unansweredBytes == 0 || _unansweredBytes + requestBytes <= _window;
+    }
+
+    // Adds a request to the batch, and sends the batch if the coalescing says so. A channel that fails, and can't
+    // be reconnected, is closed.
+    bool Queue(std::string_view request, const ReceiverCoalescing& coalescing)
+    {
+        if (!Queue(request))
+        {
+            return false;
+        }
+        if (_batch.size() >= coalescing.MaxBytes || std::chrono::steady_clock::now() - _batchStart >= coalescing.Window)
+        {
+            return Flush();
+        }
+        return true;
+    }
+
+    // Adds a request to the batch without sending it. The batch goes out with the next Flush, or the next Receive.
+    bool Queue(std::string_view request)
+    {
+        if (!IsOpen())
+        {
+            return false;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (_batch.empty())
+        {
+            _batchStart = now;
+        }
+        _batch.append(request);
+        const auto deadline = _requestTimeout.count() > 0 ? now + _requestTimeout : std::chrono::steady_clock::time_point::max();
+        _unansweredRequests.push_back(UnansweredRequest{ std::string(request), deadline });
+        _unansweredBytes += request.size();
+        return true;
+    }
+
+    // Sends the batch
+    bool Flush()
+    {
+        for (size_t sent = 0; sent < _batch.size();)
+        {
+            const int chunk = static_cast<int>(std::min<size_t>(_batch.size() - sent, std::numeric_limits<int>::max()));
+            const int count = send(_connection->sock, _batch.data() + sent, chunk, 0);
+            if (count <= 0)
+            {
+                if (!_resume())
+                {
+                    return false;
+                }
+                sent = 0;
+                continue;
+            }
+            sent += static_cast<size_t>(count);
+        }
+        _batch.clear();
+        return true;
+    }
+
+    // Waits for the response to the oldest unanswered request, sending the batch first since it may be in it
+    bool Receive(std::string& response)
+    {
+        static constexpr std::string_view responseEnd = "</response>";
+        if (!IsOpen() || !Flush())
+        {
+            return false;
+        }
+
+        char buffer[4096];
+        auto end = _received.find(responseEnd);
+        while (end == std::string::npos)
+        {
+            // Only the newly received bytes (and an end tag split across receives) need searching
+            const size_t searchFrom = _received.size() < responseEnd.size() ? 0 : _received.size() - responseEnd.size() + 1;
+            if (!_waitForData())
+            {
+                return false;
+            }
+            const int count = recv(_connection->sock, buffer, sizeof(buffer), 0);
+            if (count <= 0)
+            {
+                if (!_resume() || !Flush())
+                {
+                    return false;
+                }
+                end = std::string::npos;
+                continue;
+            }
+            _received.append(buffer, static_cast<size_t>(count));
+            end = _received.find(responseEnd, searchFrom);
+        }
+        end += responseEnd.size();
+        response.assign(_received, 0, end);
+        _received.erase(0, end);
+
+        if (!_unansweredRequests.empty())
+        {
+            _unansweredBytes -= _unansweredRequests.front().Text.size();
+            _unansweredRequests.pop_front();
+        }
+        const auto window = ReceiverProtocol::FindElement(response, "window");
+        if (!window.empty())
+        {
+            _window = std::strtoull(std::string(window).c_str(), nullptr, 10);
+        }
+        return true;
+    }
+
+private:
+    // Waits until the socket can be read, or the oldest unanswered request's deadline passes
+    bool _waitForData()
+    {
+        const auto deadline = _unansweredRequests.empty() ? std::chrono::steady_clock::time_point::max() : _unansweredRequests.front().Deadline;
+        while (true)
+        {
+            int timeoutMs = -1;
+            if (deadline != std::chrono::steady_clock::time_point::max())
+            {
+                const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                if (remaining.count() <= 0)
+                {
+                    _failure = ReceiverFailure::TimedOut;
+                    return false;
+                }
+                timeoutMs = static_cast<int>(std::min<std::chrono::milliseconds::rep>(remaining.count(), std::numeric_limits<int>::max()));
+            }
+            // Data, a closed connection, or an error (all read by the recv that follows)
+            WSAPOLLFD pollFd { _connection->sock, POLLRDNORM, 0 };
+            if (WSAPoll(&pollFd, 1, timeoutMs) != 0)
+            {
+                return true;
+            }
+        }
+    }
+
+    // Reconnects, and puts all the unanswered requests in the batch, as any of them may not have reached the
+    // receiver. Closes the channel if every attempt fails. A canceled channel isn't reconnected, and the attempts
+    // stop at the oldest unanswered request's deadline, waits and connects included.
+    bool _resume()
+    {
+        {
+            std::lock_guard lock(_socketMutex);
+            closesocket(_connection->sock);
+            _connection->sock = INVALID_SOCKET;
+        }
+        _received.clear();
+
+        const auto deadline = _unansweredRequests.empty() ? std::chrono::steady_clock::time_point::max() : _unansweredRequests.front().Deadline;
+        const auto isCanceled = [this] { return _canceled.load(); };
+        auto backoff = _reconnect.Backoff;
+        for (uint32_t attempt = 0; attempt < _reconnect.Attempts && _waitUntil(std::min(deadline, std::chrono::steady_clock::now() + backoff)); attempt++, backoff *= 2)
+        {
+            auto connection = ReceiverDiscovery::Connect(_connection->serverAddr, deadline, isCanceled);
+            if (connection)
+            {
+                std::lock_guard lock(_socketMutex);
+                if (_canceled)
+                {
+                    ReceiverDiscovery::Close(*connection);
+                    break;
+                }
+                // The channel keeps the socket, its own WSAStartup already balances the channel's Close
+                _connection->sock = std::exchange(connection->sock, INVALID_SOCKET);
+                ReceiverDiscovery::Close(*connection);
+                _batch.clear();
+                for (const auto& request : _unansweredRequests)
+                {
+                    _batch += request.Text;
+                }
+                _batchStart = std::chrono::steady_clock::now();
+                return true;
+            }
+        }
+        if (_canceled || std::chrono::steady_clock::now() >= deadline)
+        {
+            // The unanswered requests are kept for Abandon
+            _failure = _canceled ? ReceiverFailure::Canceled : ReceiverFailure::TimedOut;
+            return false;
+        }
+        _failure = ReceiverFailure::Lost;
+        _disconnect();
+        return false;
+    }
+
+    // Sleeps until time. False if the channel was canceled, or the oldest unanswered request's deadline has passed.
+    bool _waitUntil(std::chrono::steady_clock::time_point time)
+    {
+        while (!_canceled && std::chrono::steady_clock::now() < time)
+        {
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(time - std::chrono::steady_clock::now(), ReceiverDiscovery::CancelCheckInterval));
+        }
+        return !_canceled && (_unansweredRequests.empty() || std::chrono::steady_clock::now() < _unansweredRequests.front().Deadline);
+    }
+
+    void _disconnect() noexcept
+    {
+        {
+            std::lock_guard lock(_socketMutex);
+            closesocket(_connection->sock);
+            _connection->sock = INVALID_SOCKET;
+        }
+        _batch.clear();
+        _received.clear();
+        _unansweredRequests.clear();
+        _unansweredBytes = 0;
+    }
+};
+
+// The TDO of the last polled scan under each delta key, with the id of the request that read it. A scan with a base
+// here is sent with a ReceiverProtocol::DeltaPoll, so the receiver can answer with what changed since that request.
+class ReceiverDeltaBases
+{
+    // Bounded like the receiver's own copies: past this, the bases start over
+    static constexpr size_t Limit = 1024;
+
+    std::mutex _mutex;
+    std::unordered_map<uint64_t, std::pair<uint64_t, std::vector<uint8_t>>> _bases;
+public:
+    std::optional<std::pair<uint64_t, std::vector<uint8_t>>> Find(uint64_t key)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const auto found = _bases.find(key);
+        if (found == _bases.end())
+        {
+            return std::nullopt;
+        }
+        return found->second;
+    }
+
+    void Store(uint64_t key, uint64_t requestId, const std::vector<uint8_t>& tdo)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_bases.size() >= Limit && _bases.find(key) == _bases.end())
+        {
+            _bases.clear();
+        }
+        _bases[key] = { requestId, tdo };
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _bases.clear();
+    }
+};
+
+// The channels to a probe's receiver. Each executing bundle leases a channel of its own, so the interfaces
+// of a probe exchange with the receiver in parallel instead of queuing behind each other on one socket.
+// At most the capacity is open at once; a lease taken while all of them are leased waits for one to return.
+class ReceiverChannelPool
+{
+public:
+    struct Settings
+    {
+        size_t Capacity { 1 };
+        ReceiverReconnect Reconnect;
+    };
+private:
+    sockaddr_in _address;
+    // Read whenever a channel is leased or returned, so new settings apply to the next lease
+    std::function<Settings()> _settings;
+    std::mutex _mutex;
+    std::condition_variable _channelReturned;
+    std::vector<std::unique_ptr<ReceiverChannel>> _idleChannels;
+    size_t _openChannels { 0 }; // Idle, leased, and being connected
+public:
+    // The receiver keeps the probe's state under this session while it is disconnected for a while,
+    // so any channel, including one reconnected after a drop, picks up where the others left off
+    const uint64_t Session { _newSession() };
+    // Ids of the requests sent on any of the channels
+    RequestIdSequence RequestIds;
+    // Set by the handshake when the receiver accepted ReceiverProtocol::RunLengthCompression for the session
+    std::atomic<bool> RunLength { false };
+    // Set by the handshake when the receiver accepted loop requests (see ReceiverProtocol::BuildLoopRequest)
+    std::atomic<bool> Loops { false };
+    // Kept for the scans polled once RunLength is negotiated
+    ReceiverDeltaBases DeltaBases;
+    // The window the receiver advertised in the handshake, which new channels keep to until they are answered
+    std::atomic<size_t> Window { ReceiverChannel::DefaultWindow };
+    static constexpr std::chrono::milliseconds CancelConnectTimeout { 1000 };
+
+    // A channel leased from the pool, returned to it when the lease ends
+    class Lease
+    {
+        ReceiverChannelPool* _pool { nullptr };
+        std::unique_ptr<ReceiverChannel> _channel;
+    public:
+        Lease() = default;
+        Lease(ReceiverChannelPool* pool, std::unique_ptr<ReceiverChannel> channel) :
+            _pool(pool),
+            _channel(std::move(channel))
+        {
+        }
+
+        ~Lease()
+        {
+            Reset();
+        }
+        Lease(Lease&& other) noexcept = default;
+        Lease& operator=(Lease&& other) noexcept
+        {
+            if (this != &other)
+            {
+                Reset();
+                _pool    = other._pool;
+                _channel = std::move(other._channel);
+            }
+            return *this;
+        }
+
+        void Reset()
+        {
+            if (_channel)
+            {
+                _pool->_return(std::move(_channel));
+            }
+        }
+
+        explicit operator bool() const noexcept
+        {
+            return _channel != nullptr;
+        }
+
+        ReceiverChannel* operator->() const noexcept
+        {
+            return _channel.get();
+        }
+
+        ReceiverChannel* Get() const noexcept
+        {
+            return _channel.get();
+        }
+    };
+
+    ReceiverChannelPool(const sockaddr_in& address, std::function<Settings()> settings) :
+        _address(address),
+        _settings(std::move(settings))
+    {
+    }
+
+    // Adds a channel on a connection made elsewhere, like the one of the probe's handshake
+    void Add(std::unique_ptr<ReceiverConnection> connection)
+    {
+        auto channel = std::make_unique<ReceiverChannel>(std::move(connection), Window);
+        const size_t capacity = _getCapacity();
+        {
+            std::lock_guard lock(_mutex);
+            if (!channel->IsOpen() || _openChannels >= capacity)
+            {
+                return;
+            }
+            _openChannels++;
+            _idleChannels.push_back(std::move(channel));
+        }
+        _channelReturned.notify_one();
+    }
+
+    // Returns an empty lease if a channel had to be opened and the receiver couldn't be connected to within
+    // connectTimeout (0 for as long as it takes), or the connect was canceled
+    Lease Acquire(std::chrono::milliseconds connectTimeout = {}, const std::function<bool()>& isCanceled = {})
+    {
+        const auto settings = _settings();
+        const size_t capacity = std::max<size_t>(settings.Capacity, 1);
+        std::unique_lock lock(_mutex);
+        _channelReturned.wait(lock, [&] { return !_idleChannels.empty() || _openChannels < capacity; });
+        if (!_idleChannels.empty())
+        {
+            auto channel = std::move(_idleChannels.back());
+            _idleChannels.pop_back();
+            channel->SetReconnect(settings.Reconnect);
+            return Lease(this, std::move(channel));
+        }
+
+        // The channel counts as open while it connects, so concurrent leases can't open more than the capacity
+        _openChannels++;
+        lock.unlock();
+        auto channel = ReceiverChannel::Open(_address, Window, ReceiverDiscovery::ConnectDeadline(connectTimeout), isCanceled);
+        if (!channel)
+        {
+            lock.lock();
+            _openChannels--;
+            lock.unlock();
+            _channelReturned.notify_one();
+            return Lease();
+        }
+        channel->SetReconnect(settings.Reconnect);
+        return Lease(this, std::move(channel));
+    }
+
+    // Has the receiver drop the requests an abandoned channel left unanswered, if it hasn't executed them yet.
+    // Sent on a connection of its own, which isn't waited on for the response. The connect is given up on after
+    // timeout (the requests' own timeout, or CancelConnectTimeout when they have none), so a receiver that stalled
+    // doesn't hold up the bundle that gave up on it.
+    void CancelRequests(const std::vector<std::string>& requestIds, std::chrono::milliseconds timeout)
+    {
+        if (requestIds.empty())
+        {
+            return;
+        }
+        auto connections = ReceiverDiscovery::ConnectAll({ _address }, timeout.count() > 0 ? timeout : CancelConnectTimeout);
+        if (!connections.empty())
+        {
+            ReceiverChannel channel(std::move(connections.front()), Window);
+            channel.Queue(ReceiverProtocol::BuildCancelRequest(Session, RequestIds.Next(), requestIds), ReceiverCoalescing{});
+        }
+    }
+
+    // Closes the idle channels. Channels leased at the time are kept when they are returned.
+    void Close()
+    {
+        std::lock_guard lock(_mutex);
+        _openChannels -= _idleChannels.size();
+        _idleChannels.clear();
+    }
+
+private:
+    size_t _getCapacity() const
+    {
+        return std::max<size_t>(_settings().Capacity, 1);
+    }
+
+    static uint64_t _newSession()
+    {
+        std::random_device random;
+        return (static_cast<uint64_t>(random()) << 32) ^ random()
+               ^ static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    }
+
+    void _return(std::unique_ptr<ReceiverChannel> channel)
+    {
+        const size_t capacity = _getCapacity();
+        {
+            std::lock_guard lock(_mutex);
+            if (channel->IsOpen() && _openChannels <= capacity)
+            {
+                _idleChannels.push_back(std::move(channel));
+            }
+            else
+            {
+                // Broken, or over a capacity that was lowered while it was leased
+                _openChannels--;
+            }
+        }
+        _channelReturned.notify_one();
+    }
+};
+
+// ==== Interfaces ====
+
+// Command stream executed by PPI_InterfaceScan. The stream is handed to the interface as is and each
+// command is executed as it is read, without being turned into bundle operations first.
+// Every command is a header dword (bits 0-7 opcode, bits 8-15 flags, bits 16-31 poll id) followed by one value dword:
+//   GoToState:      flags = JtagStateEncode to go to, value = number of clocks to spend in that state
+//   IrScan, DrScan: value = bit count, followed by (bitCount + 31) / 32 TDI dwords (bit 0 of the first dword is shifted first)
+//   RegisterIrScan, RegisterDrScan: as IrScan and DrScan, but ending in RTI (or Pause with StopInPause)
+// A scan with the FillTdi flag has no TDI dwords, TDI is all 0's (or all 1's with FillOnes).
+// A scan with the CaptureTdo flag appends (bitCount + 31) / 32 TDO dwords to the output.
+//
+// Payload compression is negotiated per interface with the InterfaceScan.Compression config ("None" or "RunLength").
+// With RunLength:
+//   A scan with the CompressedTdi flag carries a dword count followed by that many run-length encoded TDI dwords.
+//   Every captured TDO payload is preceded by a dword with the payload encoding in bits 28-31 and the number of
+//   payload dwords that follow in bits 0-27. The plugin only run-length encodes a payload when that makes it smaller.
+//   A scan with the DeltaTdo flag may instead be answered relative to the last TDO captured by a DeltaTdo scan with
+//   the same poll id: Unchanged (no payload dwords) or XorDelta (the run-length encoded XOR with that last TDO).
+// A run-length encoded payload is a list of tokens. A token dword with bit 31 set is a run of (bits 0-30) copies
+// of the dword that follows it; otherwise it is followed by (bits 0-30) literal dwords.
+// This is only the host's side of the stream: the receiver scans it runs are compressed on the wire as negotiated by
+// the probe's handshake (see ReceiverProtocol::RunLengthCompression), and their delta TDO is rebuilt by the plugin.
+namespace ReferenceInterfaceScan
+{
+    enum Opcode : uint32_t
+    {
+        GoToState      = 0x01,
+        IrScan         = 0x02,
+        DrScan         = 0x03,
+        RegisterIrScan = 0x04,
+        RegisterDrScan = 0x05,
+    };
+
+    constexpr uint32_t CaptureTdo  = 0x01;
+    constexpr uint32_t StopInPause = 0x02;
+    constexpr uint32_t FillTdi       = 0x04;
+    constexpr uint32_t FillOnes      = 0x08;
+    constexpr uint32_t CompressedTdi = 0x10;
+    constexpr uint32_t DeltaTdo      = 0x20;
+
+    enum PayloadEncoding : uint32_t
+    {
+        Raw       = 0x0,
+        RunLength = 0x1,
+        Unchanged = 0x2,
+        XorDelta  = 0x3,
+    };
+
+    constexpr uint32_t PayloadEncodingShift = 28;
+    constexpr uint32_t PayloadSizeMask      = (1u << PayloadEncodingShift) - 1;
+    constexpr uint32_t RunToken             = 0x80000000;
+
+    // Splits a payload into runs of at least 3 equal dwords (cheaper as a run token than as literals)
+    // and the literal dwords between them.
+    template<typename TokenFunction>
+    void ForEachRunLengthToken(const uint32_t* payload, size_t dwordCount, TokenFunction&& token)
+    {
+        size_t literalStart = 0;
+        size_t position     = 0;
+        while (position < dwordCount)
+        {
+            size_t runEnd = position + 1;
+            while (runEnd < dwordCount && payload[runEnd] == payload[position])
+            {
+                runEnd++;
+            }
+            if (runEnd - position >= 3)
+            {
+                if (literalStart < position)
+                {
+                    token(false, literalStart, position - literalStart);
+                }
+                token(true, position, runEnd - position);
+                literalStart = runEnd;
+            }
+            position = runEnd;
+        }
+        if (literalStart < dwordCount)
+        {
+            token(false, literalStart, dwordCount - literalStart);
+        }
+    }
+
+    inline size_t RunLengthEncodedSize(const uint32_t* payload, size_t dwordCount)
+    {
+        size_t size = 0;
+        ForEachRunLengthToken(payload, dwordCount, [&size](bool isRun, size_t, size_t count)
+                              {
+                                  size += isRun ? 2 : 1 + count;
+                              });
+        return size;
+    }
+
+    inline void RunLengthEncode(const uint32_t* payload, size_t dwordCount, uint32_t* output)
+    {
+        ForEachRunLengthToken(payload, dwordCount, [&](bool isRun, size_t start, size_t count)
+                              {
+                                  *output++ = static_cast<uint32_t>(count) | (isRun ? RunToken : 0);
+                                  if (isRun)
+                                  {
+                                      *output++ = payload[start];
+                                  }
+                                  else
+                                  {
+                                      output = std::copy_n(payload + start, count, output);
+                                  }
+                              });
+    }
+
+    // Decodes exactly dwordCount dwords into payload. Returns false if the encoded data is malformed.
+    inline bool RunLengthDecode(const uint32_t* input, size_t inputDwords, uint32_t* payload, size_t dwordCount)
+    {
+        size_t position = 0;
+        size_t decoded  = 0;
+        while (position < inputDwords)
+        {
+            const bool isRun   = input[position] & RunToken;
+            const size_t count = input[position] & ~RunToken;
+            position++;
+            if (count > dwordCount - decoded || inputDwords - position < (isRun ? 1 : count))
+            {
+                return false;
+            }
+            if (isRun)
+            {
+                std::fill_n(payload + decoded, count, input[position]);
+                position++;
+            }
+            else
+            {
+                std::copy_n(input + position, count, payload + decoded);
+                position += count;
+            }
+            decoded += count;
+        }
+        return decoded == dwordCount;
+    }
+}
+
+class ReferenceJtagInterface
+{
+    bool _isInitializing { false };
+    bool _isInitialized { false };
+    JtagStateEncode _currentState { JtagRTI };
+
+    std::vector<uint8_t> _idcodeIrValue { 0x2 };
+    ShiftRegister _irRegister { 8, { 0x2 } };
+    ShiftRegister _idcodeRegister { 32, { } }; // idcode = 0x12345679
+    ShiftRegister _bypassRegister { 1, { 0 } };
+
+    // DR scans while the IR holds this instruction shift the receiver's data register instead of a local one
+    std::vector<uint8_t> _receiverIrValue { 0x10 };
+    // Channels to the probe's receiver, the one leased by the executing bundle, and its first failed exchange
+    std::shared_ptr<ReceiverChannelPool> _receiverChannels;
+    ReceiverChannelPool::Lease _receiverChannel;
+    ReceiverCoalescing _receiverCoalescing;
+    OpenIPC_Error _receiverError { OpenIPC_Error_No_Error };
+
+    // Moved on by each CancelOperations, from another thread than the executing one. A call records the epoch
+    // before it waits for the interface's lock, so it is canceled by a cancel made while it executes or waits. The
+    // channel the executing bundle has leased is kept here, so it can be canceled too. Held through a pointer so
+    // the interface stays movable.
+    struct Cancellation
+    {
+        std::atomic<uint64_t> Epoch { 0 };
+        std::mutex Mutex; // Held to move the epoch on, and to set the channel
+        ReceiverChannel* Channel { nullptr };
+    };
+    std::unique_ptr<Cancellation> _cancellation { std::make_unique<Cancellation>() };
+    // The epoch of the executing call, and the one the queued bundles were queued in
+    uint64_t _callEpoch { 0 };
+    uint64_t _pendingEpoch { 0 };
+    // Error of the bundles aborted by CancelOperations. OpenIPC has no error code for a canceled operation, so it is
+    // reported as an operation that isn't valid anymore.
+    static constexpr OpenIPC_Error CanceledError = OpenIPC_Error_Operation_Invalid;
+
+    // Receiver scans sent (or waiting in the channel's batch) whose TDO isn't written back yet, in the order they were queued
+    struct PendingReceiverScan
+    {
+        size_t TapBitCount; // The scan and its padding
+        uint32_t BitCount;
+        uint8_t* OutBits;
+        ReferenceSlot* SaveTdoToSlot;
+        // Set for a chunk of a longer scan: the bit its TDO is written back at
+        std::optional<size_t> TdoOffset;
+        CaptureBuffer* Capture;
+        // Set when the scan was polled for a delta response: its key, its request, and the base TDO it was sent with (if any)
+        std::optional<ReceiverProtocol::DeltaPoll> Poll;
+        uint64_t RequestId;
+        std::vector<uint8_t> DeltaBase;
+    };
+    std::deque<PendingReceiverScan> _pendingReceiverScans;
+
+    // Execution state used by slot comparisons and loops
+    bool _comparisonSucceeded { false };
+    bool _exitBundle { false };
+    CaptureBuffer* _capture { nullptr };
+
+    // Interface padding, and the change made to it by the executing bundle
+    JtagPadding _padding;
+    JtagPaddingDelta _bundlePadding;
+
+    // Scans longer than this are streamed through the TAP in chunks of this size
+    static constexpr size_t StreamingChunkBitCount = 512 * 1024;
+
+    // Operations of the bundles executed while the lock is kept, which haven't been run yet
+    std::vector<ReferenceBundleJtagOperations::SomeOperation> _pendingOperations;
+
+    // Last TDO payload of each PPI_InterfaceScan poll id, the base of the DeltaTdo responses
+    std::unordered_map<uint32_t, std::vector<uint32_t>> _lastTdoByPollId;
+
+    // Serializes the calls on this interface; calls on different interfaces don't contend. Held through a
+    // pointer so the interface stays movable.
+    std::unique_ptr<std::mutex> _mutex { std::make_unique<std::mutex>() };
+
+public:
+    // Receiver.CoalesceWindowUs and Receiver.CoalesceBytes: receiver scans queued within the window of the first
+    // one, up to the byte count, are sent to the receiver as one batch (0 sends each scan on its own)
+    // Receiver.FlowControl: when the receiver's window is full, "Block" until its responses make room, or
+    // "FailFast" and fail the bundle with OpenIPC_Error_Probe_Connection_Transient_Error
+    // Receiver.RequestTimeoutMs: how long a receiver scan waits for its response before its bundle fails with
+    // OpenIPC_Error_Probe_Request_Timeout (0 waits for as long as it takes)
+    ConfigHolder Configs { { "InterfaceScan.Compression"sv, "None" }, { "Receiver.CoalesceWindowUs"sv, "100" }, { "Receiver.CoalesceBytes"sv, "65536" },
+                           { "Receiver.FlowControl"sv, "Block" }, { "Receiver.RequestTimeoutMs"sv, "5000" } };
+    PPI_RefId InterfaceRefId;
+    OpenIPC_DeviceId InterfaceDeviceId { OpenIPC_INVALID_DEVICE_ID };
+
+    explicit ReferenceJtagInterface(PPI_RefId interfaceRefId, std::vector<uint8_t> idcodeValue, std::shared_ptr<ReceiverChannelPool> receiverChannels = nullptr) :
+        InterfaceRefId(interfaceRefId),
+        _idcodeRegister(32, idcodeValue),
+        _receiverChannels(std::move(receiverChannels))
+    {
+
+    }
+
+    ~ReferenceJtagInterface() = default;
+    ReferenceJtagInterface(const ReferenceJtagInterface& other)     = delete;
+    ReferenceJtagInterface(ReferenceJtagInterface&& other) noexcept = default;
+    ReferenceJtagInterface& operator=(const ReferenceJtagInterface& other)     = delete;
+    ReferenceJtagInterface& operator=(ReferenceJtagInterface&& other) noexcept = default;
+
+    OpenIPC_Error BeginInitialization(OpenIPC_DeviceId interfaceDeviceId) noexcept
+    {
+        std::lock_guard lock(*_mutex);
+        if (_isInitializing)
+        {
+            return OpenIPC_Error_Already_Initializing;
+        }
+        if (_isInitialized)
+        {
+            return OpenIPC_Error_Already_Initialized;
+        }
+        InterfaceDeviceId = interfaceDeviceId;
+        _isInitializing   = true;
+        _padding          = {};
+        return OpenIPC_Error_No_Error;
+    }
+
+    OpenIPC_Error FinishInitialization() noexcept
+    {
+        std::lock_guard lock(*_mutex);
+        if (!_isInitializing)
+        {
+            return OpenIPC_Error_Not_Initializing;
+        }
+        if (_isInitialized)
+        {
+            return OpenIPC_Error_Already_Initialized;
+        }
+        _isInitializing = false;
+        _isInitialized  = true;
+        return OpenIPC_Error_No_Error;
+    }
+
+    OpenIPC_Error DeInitialization() noexcept
+    {
+        const auto lock = LockForOperations();
+        if (!_isInitializing)
+        {
+            return OpenIPC_Error_Not_Initializing;
+        }
+        if (_isInitialized)
+        {
+            return OpenIPC_Error_Already_Initialized;
+        }
+        const auto error  = RunPendingOperations();
+        _isInitializing   = false;
+        _isInitialized    = false;
+        InterfaceDeviceId = OpenIPC_INVALID_DEVICE_ID;
+        _lastTdoByPollId.clear();
+        return error;
+    }
+
+    PPI_EInterfaceType GetInterfaceType() const noexcept
+    {
+        return PPI_interfaceTypeJtag;
+    }
+
+    JtagPadding GetPadding() const noexcept
+    {
+        std::lock_guard lock(*_mutex);
+        return _padding;
+    }
+
+    // The queued operations were appended under the old padding, so they run before it changes
+    OpenIPC_Error SetPadding(const JtagPadding& padding) noexcept
+    {
+        const auto lock = LockForOperations();
+        const auto error = RunPendingOperations();
+        _padding = padding;
+        return error;
+    }
+
+    PPI_InterfaceJTAGCapabilities GetJtagCapabilities() noexcept
+    {
+        PPI_InterfaceJTAGCapabilities capabilities{};
+        // Does the interface support using the TRST pin?
+        capabilities.supportTRST = false;
+        // Does the interface support cycling to TLR for a TAP reset. Note: supportTRST | supportTLR == 1
+        capabilities.supportTLR = true;
+        // Does the interface support staying in PauDR in a register interface
+        capabilities.supportPauDRInRegisterInterface = SupportsPauseInRegisterInterface();
+
+        return capabilities;
+    }
+
+    bool SupportsPauseInRegisterInterface() const noexcept
+    {
+        return true;
+    }
+
+    // While the lock is kept, bundles the host can't observe are queued instead of run. The queue runs
+    // back-to-back as soon as a bundle needs its results or the lock is released.
+    OpenIPC_Error ExecuteBundle(ReferenceJtagBundle& bundle, bool keepLock)
+    {
+        PLUGIN_LOGGER.Log(InterfaceDeviceId, PPI_traceNotification, "Enter ReferenceJtagInterface.ExecuteBundle");
+        const auto lock = LockForOperations();
+        if (IsCanceled())
+        {
+            return CanceledError;
+        }
+        if (keepLock && bundle.CanBeDeferred())
+        {
+            // Queued operations outlive this execute, so they can't keep borrowing the host's TDI
+            if (_pendingOperations.empty())
+            {
+                _pendingEpoch = _callEpoch;
+            }
+            const auto& operations = bundle.GetOperations();
+            const auto queued = _pendingOperations.insert(_pendingOperations.end(), operations.begin(), operations.end());
+            std::for_each(queued, _pendingOperations.end(), ReferenceBundleJtagOperations::TakeTdiOwnership);
+            return OpenIPC_Error_No_Error;
+        }
+        if (const auto error = RunPendingOperations())
+        {
+            return error;
+        }
+        const auto error = RunBundleOperations(bundle.GetOperations());
+        if (!keepLock)
+        {
+            bundle.ResetSlots();
+        }
+        return error;
+    }
+
+    OpenIPC_Error FlushPendingOperations()
+    {
+        const auto lock = LockForOperations();
+        return RunPendingOperations();
+    }
+
+    OpenIPC_Error ExecuteScanStream(const uint32_t* input, uint32_t inputDwords, uint32_t* output, uint32_t maxOutputDwords, uint32_t& outputDwords)
+    {
+        PLUGIN_LOGGER.Log(InterfaceDeviceId, PPI_traceNotification, "Enter ReferenceJtagInterface.ExecuteScanStream");
+        const auto lock = LockForOperations();
+        outputDwords = 0;
+        if (IsCanceled())
+        {
+            return CanceledError;
+        }
+        if (const auto error = RunPendingOperations())
+        {
+            return error;
+        }
+        // The host only takes in the stream's TDO when the whole stream succeeds, so the DeltaTdo bases move on then
+        std::unordered_map<uint32_t, std::vector<uint32_t>> tdoBases;
+        const auto error = FinishReceiverExchanges(RunScanStream(input, inputDwords, output, maxOutputDwords, outputDwords, tdoBases));
+        if (error == OpenIPC_Error_No_Error)
+        {
+            for (auto& [pollId, lastTdo] : tdoBases)
+            {
+                _lastTdoByPollId[pollId] = std::move(lastTdo);
+            }
+        }
+        return error;
+    }
+
+    // Aborts the bundles and scan streams executing or waiting to execute on this interface, and drops the bundles
+    // queued while the lock is kept. Called from another thread; returns once the calls it canceled are done. The
+    // calls made after it aren't canceled.
+    OpenIPC_Error CancelOperations()
+    {
+        PLUGIN_LOGGER.Log(InterfaceDeviceId, PPI_traceNotification, "Enter ReferenceJtagInterface.CancelOperations");
+        {
+            std::lock_guard lock(_cancellation->Mutex);
+            _cancellation->Epoch++;
+            if (_cancellation->Channel)
+            {
+                _cancellation->Channel->Cancel();
+            }
+        }
+        const auto lock = LockForOperations();
+        return OpenIPC_Error_No_Error;
+    }
+
+private:
+    // Takes the interface's lock for a call that executes operations, recording the cancel epoch it was made in
+    // first. The bundles queued before a cancel are dropped by the first call to get the lock after it.
+    std::unique_lock<std::mutex> LockForOperations()
+    {
+        const auto epoch = _cancellation->Epoch.load();
+        std::unique_lock lock(*_mutex);
+        _callEpoch = epoch;
+        if (_pendingEpoch != _cancellation->Epoch)
+        {
+            _pendingOperations.clear();
+        }
+        return lock;
+    }
+
+    // True once the executing call was canceled
+    bool IsCanceled() const noexcept
+    {
+        return _cancellation->Epoch != _callEpoch;
+    }
+
+    // A scan of the stream whose TDO is captured, encoded into the output once the stream's receiver scans are complete
+    struct StreamCapture
+    {
+        uint32_t PollId;
+        bool IsDelta;
+        uint32_t DataDwords;
+        std::vector<uint8_t> Tdo;
+    };
+
+    // The stream's scans of the receiver's data register are queued, like a bundle's, and the captured payloads are
+    // encoded at the end, in the order of the stream. The DeltaTdo bases the payloads leave the host with are
+    // collected in tdoBases.
+    OpenIPC_Error RunScanStream(const uint32_t* input, uint32_t inputDwords, uint32_t* output, uint32_t maxOutputDwords, uint32_t& outputDwords,
+                                std::unordered_map<uint32_t, std::vector<uint32_t>>& tdoBases)
+    {
+        const bool useRunLength = Configs.Is("InterfaceScan.Compression", "RunLength");
+        std::deque<StreamCapture> captures; // A deque, so queued scans can write back into the captures before them
+        const auto error = ScanStream(input, inputDwords, useRunLength, captures);
+        // The queued receiver scans write back into the captures, so they complete before the captures go out of
+        // scope, even when the stream failed part way
+        CompleteReceiverScans();
+        if (error != OpenIPC_Error_No_Error)
+        {
+            return error;
+        }
+        if (_receiverError != OpenIPC_Error_No_Error)
+        {
+            return _receiverError;
+        }
+        std::vector<uint32_t> payload;
+        for (const auto& capture : captures)
+        {
+            std::vector<uint32_t>* lastTdo = nullptr;
+            if (capture.IsDelta)
+            {
+                auto [base, isNew] = tdoBases.try_emplace(capture.PollId);
+                if (const auto committed = _lastTdoByPollId.find(capture.PollId); isNew && committed != _lastTdoByPollId.end())
+                {
+                    base->second = committed->second;
+                }
+                lastTdo = &base->second;
+            }
+            payload.assign(capture.DataDwords, 0);
+            for (size_t byte = 0; byte < capture.Tdo.size(); byte++)
+            {
+                payload[byte / 4] |= static_cast<uint32_t>(capture.Tdo[byte]) << (8 * (byte % 4));
+            }
+            if (const auto error = WriteTdoPayload(payload, useRunLength, lastTdo, output, maxOutputDwords, outputDwords))
+            {
+                return error;
+            }
+        }
+        return OpenIPC_Error_No_Error;
+    }
+
+    // Executes the scans of a stream, adding a capture for each scan whose TDO is captured. The receiver scans are
+    // left queued, to write back into their captures once completed.
+    OpenIPC_Error ScanStream(const uint32_t* input, uint32_t inputDwords, bool useRunLength, std::deque<StreamCapture>& captures)
+    {
+        std::vector<uint8_t> tdi;
+        std::vector<uint8_t> tdo;
+        std::vector<uint32_t> payload;
+        uint32_t position = 0;
+        while (position < inputDwords)
+        {
+            if (IsCanceled())
+            {
+                return CanceledError;
+            }
+            if (inputDwords - position < 2)
+            {
+                return OpenIPC_Error_Probe_Invalid_Parameter;
+            }
+            const uint32_t opcode = input[position] & 0xFF;
+            const uint32_t flags  = (input[position] >> 8) & 0xFF;
+            const uint32_t pollId = input[position] >> 16;
+            const uint32_t value  = input[position + 1];
+            position += 2;
+
+            if (opcode == ReferenceInterfaceScan::GoToState)
+            {
+                if (flags > JtagUpdIR)
+                {
+                    return OpenIPC_Error_Invalid_JtagState;
+                }
+                ExecuteOperation(ReferenceBundleJtagOperations::GoToState{ static_cast<JtagStateEncode>(flags), value, false, false });
+                continue;
+            }
+            if (opcode < ReferenceInterfaceScan::IrScan || opcode > ReferenceInterfaceScan::RegisterDrScan)
+            {
+                return OpenIPC_Error_Probe_Invalid_Parameter;
+            }
+
+            const uint32_t dataDwords = static_cast<uint32_t>((static_cast<uint64_t>(value) + 31) / 32);
+            const bool isIrScan = opcode == ReferenceInterfaceScan::IrScan || opcode == ReferenceInterfaceScan::RegisterIrScan;
+            const bool isCaptured = flags & ReferenceInterfaceScan::CaptureTdo;
+            if (isCaptured && (flags & ReferenceInterfaceScan::DeltaTdo) && !useRunLength)
+            {
+                return OpenIPC_Error_Probe_Invalid_Parameter;
+            }
+            const bool isQueued = !isIrScan && SelectsReceiverDr();
+            const size_t chunkBitCount = ReceiverChunkBitCount();
+            if (isQueued && (flags & ReferenceInterfaceScan::FillTdi))
+            {
+                // Every chunk of a fill shifts the same TDI
+                tdi.assign((std::min<size_t>(value, chunkBitCount) + 7) / 8, (flags & ReferenceInterfaceScan::FillOnes) ? static_cast<uint8_t>(0xFF) : static_cast<uint8_t>(0));
+            }
+            else if (flags & ReferenceInterfaceScan::FillTdi)
+            {
+                ShiftFill(isIrScan, flags & ReferenceInterfaceScan::FillOnes, value, isCaptured ? &tdo : nullptr);
+            }
+            else
+            {
+                const uint32_t* tdiDwords = input + position;
+                if (flags & ReferenceInterfaceScan::CompressedTdi)
+                {
+                    if (!useRunLength || inputDwords - position < 1)
+                    {
+                        return OpenIPC_Error_Probe_Invalid_Parameter;
+                    }
+                    const uint32_t encodedDwords = input[position];
+                    position++;
+                    payload.resize(dataDwords);
+                    if (inputDwords - position < encodedDwords || !ReferenceInterfaceScan::RunLengthDecode(input + position, encodedDwords, payload.data(), dataDwords))
+                    {
+                        return OpenIPC_Error_Probe_Invalid_Parameter;
+                    }
+                    tdiDwords = payload.data();
+                    position += encodedDwords;
+                }
+                else
+                {
+                    if (inputDwords - position < dataDwords)
+                    {
+                        return OpenIPC_Error_Probe_Invalid_Parameter;
+                    }
+                    position += dataDwords;
+                }
+                tdi.resize((static_cast<size_t>(value) + 7) / 8);
+                for (size_t byte = 0; byte < tdi.size(); byte++)
+                {
+                    tdi[byte] = static_cast<uint8_t>(tdiDwords[byte / 4] >> (8 * (byte % 4)));
+                }
+                if (!isQueued)
+                {
+                    tdo = isIrScan ? ShiftIr(tdi.data(), value) : ShiftDr(tdi.data(), value);
+                }
+            }
+            if (isCaptured)
+            {
+                captures.push_back(StreamCapture{ pollId, (flags & ReferenceInterfaceScan::DeltaTdo) != 0, dataDwords,
+                                                  isQueued ? std::vector<uint8_t>((static_cast<size_t>(value) + 7) / 8, 0) : tdo });
+            }
+            if (isQueued)
+            {
+                // The stream is forwarded as one batch, as far as the receiver's window lets it, with a longer
+                // scan queued a chunk at a time
+                const bool isFill = flags & ReferenceInterfaceScan::FillTdi;
+                for (size_t chunkPosition = 0; chunkPosition < value && _receiverError == OpenIPC_Error_No_Error; chunkPosition += chunkBitCount)
+                {
+                    const size_t count = std::min<size_t>(chunkBitCount, value - chunkPosition);
+                    QueueReceiverTapScan(isFill ? tdi.data() : tdi.data() + chunkPosition / 8, count, static_cast<uint32_t>(count),
+                                         isCaptured ? captures.back().Tdo.data() : nullptr, nullptr, true, chunkPosition);
+                }
+            }
+
+            if (_receiverError != OpenIPC_Error_No_Error)
+            {
+                return _receiverError;
+            }
+            if (opcode == ReferenceInterfaceScan::RegisterIrScan || opcode == ReferenceInterfaceScan::RegisterDrScan)
+            {
+                const auto pauseState = isIrScan ? JtagPauIR : JtagPauDR;
+                _currentState = (flags & ReferenceInterfaceScan::StopInPause) ? pauseState : JtagRTI;
+            }
+            else
+            {
+                _currentState = isIrScan ? JtagShfIR : JtagShfDR;
+            }
+        }
+        return OpenIPC_Error_No_Error;
+    }
+
+    OpenIPC_Error RunPendingOperations()
+    {
+        if (_pendingOperations.empty())
+        {
+            return OpenIPC_Error_No_Error;
+        }
+        PLUGIN_LOGGER.Log(InterfaceDeviceId, PPI_traceNotification, "Enter ReferenceJtagInterface.FlushPendingOperations");
+        const auto error = RunBundleOperations(_pendingOperations);
+        _pendingOperations.clear();
+        return error;
+    }
+
+    OpenIPC_Error RunBundleOperations(const std::vector<ReferenceBundleJtagOperations::SomeOperation>& operations)
+    {
+        _exitBundle    = false;
+        _bundlePadding = JtagPaddingDelta{ 0, 0, 0, 0, _padding.DrValueConstantOne };
+        return FinishReceiverExchanges(ExecuteOperations(operations));
+    }
+
+    // Ends the receiver exchanges of a bundle or scan stream: the channel goes back to the pool, and a
+    // failed exchange is the error of the bundle unless it failed for another reason first.
+    OpenIPC_Error FinishReceiverExchanges(OpenIPC_Error error)
+    {
+        ReleaseReceiverChannel();
+        const auto receiverError = std::exchange(_receiverError, OpenIPC_Error_No_Error);
+        return error != OpenIPC_Error_No_Error ? error : receiverError;
+    }
+
+    // Completes the queued receiver scans and gives the leased channel back to the pool, for the next receiver
+    // scan to lease one again.
+    void ReleaseReceiverChannel()
+    {
+        CompleteReceiverScans();
+        bool channelCanceled = false;
+        {
+            std::lock_guard lock(_cancellation->Mutex);
+            channelCanceled        = _cancellation->Channel != nullptr && IsCanceled();
+            _cancellation->Channel = nullptr;
+        }
+        if (channelCanceled)
+        {
+            // It may have been shut down after its last exchange, so it can't go back to the pool
+            AbandonReceiverChannel();
+        }
+        _receiverChannel.Reset();
+    }
+
+    OpenIPC_Error ExecuteOperations(const std::vector<ReferenceBundleJtagOperations::SomeOperation>& operations)
+    {
+        OpenIPC_Error error = OpenIPC_Error_No_Error;
+        for (const auto& operation : operations)
+        {
+            if (IsCanceled())
+            {
+                error = CanceledError;
+                break;
+            }
+            if (ReferenceBundleJtagOperations::ReadsEarlierTdo(operation))
+            {
+                CompleteReceiverScans();
+                if (_receiverError != OpenIPC_Error_No_Error)
+                {
+                    break; // The TDO it would read wasn't written back
+                }
+            }
+            error = std::visit([&](const auto& op)
+                               {
+                                   return ExecuteOperation(op);
+                               }, operation);
+            if (error != OpenIPC_Error_No_Error || _exitBundle || _receiverError != OpenIPC_Error_No_Error)
+            {
+                break;
+            }
+        }
+        return error;
+    }
+
+    OpenIPC_Error ExecuteOperation(const ReferenceBundleJtagOperations::GoToState& op)
+    {
+        _currentState = op.GotoState;
+        if (_currentState == JtagTLR)
+        {
+            _irRegister.Shift(_idcodeIrValue, 8);
+        }
+        return OpenIPC_Error_No_Error;
+    }
+
+    OpenIPC_Error ExecuteOperation(const ReferenceBundleJtagOperations::IrScan& op)
+    {
+        _currentState = JtagShfIR;
+        const auto inBits = op.RestoreTdiFromSlot ? ReferenceBundleJtagOperations::TdiBits{ op.RestoreTdiFromSlot->Value.data(), false } : op.InBits.Bits();
+        ExecuteScan(true, inBits, op.BitCount, op.OutBits, op.SaveTdoToSlot);
+        return OpenIPC_Error_No_Error;
+    }
+
+    OpenIPC_Error ExecuteOperation(const ReferenceBundleJtagOperations::DrScan& op)
+    {
+        _currentState = JtagShfDR;
+        const auto inBits = op.RestoreTdiFromSlot ? ReferenceBundleJtagOperations::TdiBits{ op.RestoreTdiFromSlot->Value.data(), false } : op.InBits.Bits();
+        ExecuteScan(false, inBits, op.BitCount, op.OutBits, op.SaveTdoToSlot);
+        return OpenIPC_Error_No_Error;
+    }
+
+    OpenIPC_Error ExecuteOperation(const ReferenceBundleJtagOperations::RegisterScan& op)
+    {
+        const auto inBits = op.RestoreTdiFromSlot ? ReferenceBundleJtagOperations::TdiBits{ op.RestoreTdiFromSlot->Value.data(), false } : op.InBits.Bits();
+        ExecuteScan(op.ShiftState == JtagShfIR, inBits, op.BitCount, op.OutBits, op.SaveTdoToSlot);
+        _currentState = op.EndState;
+        return OpenIPC_Error_No_Error;
+    }
+
+    OpenIPC_Error ExecuteOperation(const ReferenceBundleJtagOperations::PinsScan& op)
+    {
+        std::vector<uint8_t> output((op.BitCount + 7) / 8, 0);
+        const auto tdiAt = [&op](uint32_t clock)
+        {
+            if (op.RestoreTdiFromSlot)
+            {
+                return static_cast<bool>((op.RestoreTdiFromSlot->Value[clock / 8] >> (clock % 8)) & 1);
+            }
+            return op.Tdi(clock);
+        };
+
+        uint32_t clock = 0;
+        while (clock < op.BitCount)
+        {
+            if (_currentState != JtagShfIR && _currentState != JtagShfDR)
+            {
+                StepTap(op.Tms(clock++));
+                continue;
+            }
+
+            // The clocks spent in a shift state are shifted as one run, including the clock that exits it
+            const uint32_t runStart = clock;
+            while (clock < op.BitCount && !op.Tms(clock))
+            {
+                clock++;
+            }
+            const bool exitsShiftState = clock < op.BitCount;
+            if (exitsShiftState)
+            {
+                clock++;
+            }
+            const uint32_t runLength = clock - runStart;
+            std::vector<uint8_t> tdi((runLength + 7) / 8, 0);
+            for (uint32_t bit = 0; bit < runLength; bit++)
+            {
+                tdi[bit / 8] |= static_cast<uint8_t>(tdiAt(runStart + bit) << (bit % 8));
+            }
+            const auto tdo = _currentState == JtagShfIR ? ShiftIr(tdi.data(), runLength) : ShiftDr(tdi.data(), runLength);
+            for (uint32_t bit = 0; bit < runLength; bit++)
+            {
+                const auto clockBit = runStart + bit;
+                output[clockBit / 8] |= static_cast<uint8_t>(((tdo[bit / 8] >> (bit % 8)) & 1) << (clockBit % 8));
+            }
+            if (exitsShiftState)
+            {
+                StepTap(true);
+            }
+        }
+        WriteBack(output, op.BitCount, op.OutBits, op.SaveTdoToSlot);
+        return OpenIPC_Error_No_Error;
+    }
+
+    void StepTap(bool tms)
+    {
+        // Next TAP state indexed by [state][tms]
+        static constexpr JtagStateEncode nextState[16][2] = {
+            { JtagRTI, JtagTLR },     // TLR
+            { JtagRTI, JtagSelDR },   // RTI
+            { JtagCapDR, JtagSelIR }, // SelDR
+            { JtagShfDR, JtagEx1DR }, // CapDR
+            { JtagShfDR, JtagEx1DR }, // ShfDR
+            { JtagPauDR, JtagUpdDR }, // Ex1DR
+            { JtagPauDR, JtagEx2DR }, // PauDR
+            { JtagShfDR, JtagUpdDR }, // Ex2DR
+            { JtagRTI, JtagSelDR },   // UpdDR
+            { JtagCapIR, JtagTLR },   // SelIR
+            { JtagShfIR, JtagEx1IR }, // CapIR
+            { JtagShfIR, JtagEx1IR }, // ShfIR
+            { JtagPauIR, JtagUpdIR }, // Ex1IR
+            { JtagPauIR, JtagEx2IR }, // PauIR
+            { JtagShfIR, JtagUpdIR }, // Ex2IR
+            { JtagRTI, JtagSelDR },   // UpdIR
+        };
+        _currentState = nextState[_currentState][tms ? 1 : 0];
+        if (_currentState == JtagTLR)
+        {
+            _irRegister.Shift(_idcodeIrValue, 8);
+        }
+    }
+
+    OpenIPC_Error ExecuteOperation(const ReferenceBundleJtagOperations::UpdatePadding& op)
+    {
+        _bundlePadding.IrPaddingNearTdi += op.Delta.IrPaddingNearTdi;
+        _bundlePadding.IrPaddingNearTdo += op.Delta.IrPaddingNearTdo;
+        _bundlePadding.DrPaddingNearTdi += op.Delta.DrPaddingNearTdi;
+        _bundlePadding.DrPaddingNearTdo += op.Delta.DrPaddingNearTdo;
+        _bundlePadding.DrValueConstantOne = op.Delta.DrValueConstantOne;
+        return OpenIPC_Error_No_Error;
+    }
+
+    struct ScanPadding
+    {
+        size_t NearTdi;
+        size_t NearTdo;
+        bool PadWithOnes;
+    };
+
+    ScanPadding GetScanPadding(bool isIrScan) const
+    {
+        const auto padded = [](uint32_t padding, int32_t delta)
+        {
+            return static_cast<size_t>(std::max<int64_t>(0, static_cast<int64_t>(padding) + delta));
+        };
+        const size_t nearTdi = isIrScan ? padded(_padding.IrPaddingNearTdi, _bundlePadding.IrPaddingNearTdi) : padded(_padding.DrPaddingNearTdi, _bundlePadding.DrPaddingNearTdi);
+        const size_t nearTdo = isIrScan ? padded(_padding.IrPaddingNearTdo, _bundlePadding.IrPaddingNearTdo) : padded(_padding.DrPaddingNearTdo, _bundlePadding.DrPaddingNearTdo);
+        // IR padding selects BYPASS (all 1's) in the padding TAPs
+        return ScanPadding{ nearTdi, nearTdo, isIrScan || _bundlePadding.DrValueConstantOne };
+    }
+
+    void ExecuteScan(bool isIrScan, ReferenceBundleJtagOperations::TdiBits inBits, uint32_t bitCount, uint8_t* outBits, ReferenceSlot* saveTdoToSlot)
+    {
+        if (bitCount > StreamingChunkBitCount)
+        {
+            ShiftStreamed(isIrScan, inBits, bitCount, outBits, saveTdoToSlot);
+            return;
+        }
+        if (!isIrScan && SelectsReceiverDr())
+        {
+            QueueReceiverScan(inBits, bitCount, outBits, saveTdoToSlot);
+            return;
+        }
+        const auto output = ShiftPadded(isIrScan, inBits, bitCount);
+        WriteBack(output, bitCount, outBits, saveTdoToSlot);
+    }
+
+    // Shifts a state or register based scan through the padding bits around the TAP.
+    // TDI is laid out as [near TDO padding][scan][near TDI padding] and the scan's TDO is cut back out of the same position.
+    std::vector<uint8_t> ShiftPadded(bool isIrScan, ReferenceBundleJtagOperations::TdiBits inBits, uint32_t bitCount)
+    {
+        const auto [nearTdi, nearTdo, padWithOnes] = GetScanPadding(isIrScan);
+        if (nearTdi == 0 && nearTdo == 0 && inBits.Bits != nullptr)
+        {
+            return isIrScan ? ShiftIr(inBits.Bits, bitCount) : ShiftDr(inBits.Bits, bitCount);
+        }
+
+        const size_t chainBitCount = nearTdo + bitCount + nearTdi;
+        const auto tapTdi = BuildTapTdi(isIrScan, inBits, bitCount);
+        auto tapTdo = isIrScan ? ShiftIr(tapTdi.data(), chainBitCount) : ShiftDr(tapTdi.data(), chainBitCount);
+        tapTdo.resize((bitCount + 7) / 8);
+        if (bitCount % 8 != 0)
+        {
+            tapTdo.back() &= static_cast<uint8_t>((1u << (bitCount % 8)) - 1);
+        }
+        return tapTdo;
+    }
+
+    // TDI reaching the TAP when a scan is shifted through the padding, nearTdo + bitCount + nearTdi bits long.
+    // The padding TAPs are simulated as bypass bits that capture 0's, so the reference TAP sees TDI delayed by the
+    // near TDI padding: [near TDI 0's][near TDO padding][scan]. The near TDI padding's own TDI stays in its bypass
+    // bits. It is built in place, a fill is expanded straight into it.
+    std::vector<uint8_t> BuildTapTdi(bool isIrScan, ReferenceBundleJtagOperations::TdiBits inBits, uint32_t bitCount)
+    {
+        const auto [nearTdi, nearTdo, padWithOnes] = GetScanPadding(isIrScan);
+        std::vector<uint8_t> tapTdi((nearTdo + bitCount + nearTdi + 7) / 8, 0);
+        FillBits(tapTdi.data(), nearTdi, nearTdo, padWithOnes);
+        PlaceTdi(tapTdi.data(), nearTdi + nearTdo, inBits, 0, bitCount);
+        return tapTdi;
+    }
+
+    // Shifts bitCount bits of all 0's or all 1's through the IR or the selected DR a chunk at a time, so the fill is
+    // only expanded to one chunk however long the scan is. The TDO is collected into tdo when it is captured.
+    void ShiftFill(bool isIrScan, bool fillWithOnes, size_t bitCount, std::vector<uint8_t>* tdo)
+    {
+        const std::vector<uint8_t> chunk((std::min(bitCount, StreamingChunkBitCount) + 7) / 8, fillWithOnes ? static_cast<uint8_t>(0xFF) : static_cast<uint8_t>(0));
+        if (tdo != nullptr)
+        {
+            tdo->assign((bitCount + 7) / 8, 0);
+        }
+        for (size_t position = 0; position < bitCount; position += StreamingChunkBitCount)
+        {
+            const size_t count = std::min(StreamingChunkBitCount, bitCount - position);
+            const auto chunkTdo = isIrScan ? ShiftIr(chunk.data(), count) : ShiftDr(chunk.data(), count);
+            if (tdo != nullptr)
+            {
+                CopyBits(tdo->data(), position, chunkTdo.data(), 0, count);
+            }
+        }
+    }
+
+    // Scans longer than one chunk are shifted through the chain a chunk at a time: each chunk's TDI is
+    // built, shifted through the padding and the TAP, and its TDO written back before the next chunk.
+    // Scratch memory is bounded by the chunk size instead of growing with the scan. The receiver's chunks
+    // are queued instead, and written back once they complete.
+    void ShiftStreamed(bool isIrScan, ReferenceBundleJtagOperations::TdiBits inBits, uint32_t bitCount, uint8_t* outBits, ReferenceSlot* saveTdoToSlot)
+    {
+        const auto [nearTdi, nearTdo, padWithOnes] = GetScanPadding(isIrScan);
+        // Same model as ShiftPadded: the padding TAPs are bypass bits that capture 0's
+        std::optional<ShiftRegister> nearTdiBypass;
+        std::optional<ShiftRegister> nearTdoBypass;
+        if (nearTdi > 0)
+        {
+            nearTdiBypass.emplace(nearTdi, std::vector<uint8_t>((nearTdi + 7) / 8, 0));
+        }
+        if (nearTdo > 0)
+        {
+            nearTdoBypass.emplace(nearTdo, std::vector<uint8_t>((nearTdo + 7) / 8, 0));
+        }
+        std::optional<ShiftRegister> idcodeRegisterCopy;
+        ShiftRegister& tapRegister = isIrScan ? _irRegister : SelectDrRegister(idcodeRegisterCopy);
+        const bool isReceiverScan  = !isIrScan && SelectsReceiverDr();
+        const size_t chunkBitCount = isReceiverScan ? ReceiverChunkBitCount() : StreamingChunkBitCount;
+
+        const size_t chainBitCount = nearTdo + bitCount + nearTdi;
+        std::vector<uint8_t> chunk;
+        std::vector<uint8_t> tdo;
+        for (size_t position = 0; position < chainBitCount; position += chunkBitCount)
+        {
+            const size_t count = std::min(chunkBitCount, chainBitCount - position);
+            // The part of the scan in this chunk, in chain positions
+            const size_t scanBegin = std::max(position, nearTdo);
+            const size_t scanEnd   = std::min(position + count, nearTdo + bitCount);
+
+            chunk.assign((count + 7) / 8, 0);
+            FillBits(chunk.data(), 0, count, padWithOnes);
+            if (scanBegin < scanEnd)
+            {
+                PlaceTdi(chunk.data(), scanBegin - position, inBits, scanBegin - nearTdo, scanEnd - scanBegin);
+            }
+            if (nearTdiBypass)
+            {
+                chunk = nearTdiBypass->Shift(chunk, count);
+            }
+            if (isReceiverScan)
+            {
+                // The near TDO padding only delays the TAP's TDO, so the scan's TDO is the TAP's first bitCount bits
+                const size_t tdoCount = position < bitCount ? std::min(count, bitCount - position) : 0;
+                QueueReceiverTapScan(chunk.data(), count, static_cast<uint32_t>(tdoCount), tdoCount > 0 ? outBits : nullptr, tdoCount > 0 ? saveTdoToSlot : nullptr, false, position);
+                if (_receiverError != OpenIPC_Error_No_Error)
+                {
+                    return;
+                }
+                continue;
+            }
+            chunk = tapRegister.Shift(chunk, count);
+            if (nearTdoBypass)
+            {
+                chunk = nearTdoBypass->Shift(chunk, count);
+            }
+
+            if (scanBegin < scanEnd)
+            {
+                tdo.assign((scanEnd - scanBegin + 7) / 8, 0);
+                CopyBits(tdo.data(), 0, chunk.data(), scanBegin - position, scanEnd - scanBegin);
+                WriteBackRange(tdo, scanEnd - scanBegin, scanBegin - nearTdo, outBits, saveTdoToSlot);
+            }
+        }
+    }
+
+    // Appends a captured TDO payload to the PPI_InterfaceScan output, run-length encoded when that is negotiated and smaller.
+    // With a lastTdo (a DeltaTdo scan) the payload may be sent as a delta to it, and it becomes the new lastTdo.
+    static OpenIPC_Error WriteTdoPayload(const std::vector<uint32_t>& payload, bool useRunLength, std::vector<uint32_t>* lastTdo, uint32_t* output, uint32_t maxOutputDwords, uint32_t& outputDwords)
+    {
+        if (!useRunLength)
+        {
+            if (maxOutputDwords - outputDwords < payload.size())
+            {
+                return OpenIPC_Error_Probe_Invalid_Size;
+            }
+            outputDwords = static_cast<uint32_t>(std::copy(payload.begin(), payload.end(), output + outputDwords) - output);
+            return OpenIPC_Error_No_Error;
+        }
+
+        auto encoding = ReferenceInterfaceScan::Raw;
+        size_t size   = payload.size();
+        const size_t encodedSize = ReferenceInterfaceScan::RunLengthEncodedSize(payload.data(), payload.size());
+        if (encodedSize < size)
+        {
+            encoding = ReferenceInterfaceScan::RunLength;
+            size     = encodedSize;
+        }
+        // The delta is computed in place of the last TDO, which is replaced by the payload once written
+        const bool hasDelta = lastTdo != nullptr && lastTdo->size() == payload.size();
+        if (hasDelta)
+        {
+            std::transform(payload.begin(), payload.end(), lastTdo->begin(), lastTdo->begin(), std::bit_xor<uint32_t>());
+            if (std::all_of(lastTdo->begin(), lastTdo->end(), [](uint32_t dword) { return dword == 0; }))
+            {
+                encoding = ReferenceInterfaceScan::Unchanged;
+                size     = 0;
+            }
+            else if (const size_t deltaSize = ReferenceInterfaceScan::RunLengthEncodedSize(lastTdo->data(), lastTdo->size()); deltaSize < size)
+            {
+                encoding = ReferenceInterfaceScan::XorDelta;
+                size     = deltaSize;
+            }
+        }
+        if (maxOutputDwords - outputDwords < 1 + size)
+        {
+            return OpenIPC_Error_Probe_Invalid_Size; // The stream fails, so its bases are dropped
+        }
+        output[outputDwords++] = (encoding << ReferenceInterfaceScan::PayloadEncodingShift) | static_cast<uint32_t>(size);
+        switch (encoding)
+        {
+        case ReferenceInterfaceScan::RunLength:
+            ReferenceInterfaceScan::RunLengthEncode(payload.data(), payload.size(), output + outputDwords);
+            break;
+        case ReferenceInterfaceScan::XorDelta:
+            ReferenceInterfaceScan::RunLengthEncode(lastTdo->data(), lastTdo->size(), output + outputDwords);
+            break;
+        case ReferenceInterfaceScan::Raw:
+            std::copy(payload.begin(), payload.end(), output + outputDwords);
+            break;
+        default:
+            break;
+        }
+        outputDwords += static_cast<uint32_t>(size);
+        if (lastTdo != nullptr)
+        {
+            *lastTdo = payload;
+        }
+        return OpenIPC_Error_No_Error;
+    }
+
+    // Writes count bits of the scan's TDI, starting at scan bit srcBit, generating them for a filled TDI.
+    static void PlaceTdi(uint8_t* dst, size_t dstBit, ReferenceBundleJtagOperations::TdiBits inBits, size_t srcBit, size_t count)
+    {
+        if (inBits.Bits != nullptr)
+        {
+            CopyBits(dst, dstBit, inBits.Bits, srcBit, count);
+        }
+        else
+        {
+            FillBits(dst, dstBit, count, inBits.FillWithOnes);
+        }
+    }
+
+    std::vector<uint8_t> ShiftIr(const uint8_t* inBits, size_t bitCount)
+    {
+        auto output = _irRegister.Shift(inBits, bitCount);
+        assert((bitCount + 7) / 8 == output.size());
+        return output;
+    }
+
+    std::vector<uint8_t> ShiftDr(const uint8_t* inBits, size_t bitCount)
+    {
+        if (SelectsReceiverDr())
+        {
+            return ShiftReceiverDr(inBits, bitCount);
+        }
+        std::optional<ShiftRegister> idcodeRegisterCopy;
+        auto output = SelectDrRegister(idcodeRegisterCopy).Shift(inBits, bitCount);
+        assert((bitCount + 7) / 8 == output.size());
+        return output;
+    }
+
+    // Returns the data register selected by the IR. The idcode register is readonly, so it is copied into idcodeRegisterCopy.
+    ShiftRegister& SelectDrRegister(std::optional<ShiftRegister>& idcodeRegisterCopy)
+    {
+        const auto& irRegisterValue = _irRegister.GetValue();
+        if (std::equal(irRegisterValue.begin(), irRegisterValue.end(), _idcodeIrValue.begin(), _idcodeIrValue.end()))
+        {
+            idcodeRegisterCopy.emplace(_idcodeRegister);
+            return *idcodeRegisterCopy;
+        }
+        return _bypassRegister;
+    }
+
+    bool SelectsReceiverDr() noexcept
+    {
+        const auto& irRegisterValue = _irRegister.GetValue();
+        return std::equal(irRegisterValue.begin(), irRegisterValue.end(), _receiverIrValue.begin(), _receiverIrValue.end());
+    }
+
+    // Leases the bundle's channel from the probe's pool on its first receiver scan, and keeps it until the bundle
+    // ends. Once an exchange has failed, the bundle's remaining receiver scans are skipped and shift out 0's.
+    bool LeaseReceiverChannel()
+    {
+        if (_receiverError != OpenIPC_Error_No_Error)
+        {
+            return false;
+        }
+        if (!_receiverChannel && _receiverChannels)
+        {
+            // Opening a channel counts against the first request's deadline, and a cancel gives up on it
+            const std::chrono::milliseconds requestTimeout(std::strtoul(Configs.TryGet("Receiver.RequestTimeoutMs").value_or("").c_str(), nullptr, 10));
+            _receiverChannel    = _receiverChannels->Acquire(requestTimeout, [this] { return IsCanceled(); });
+            _receiverCoalescing = ReceiverCoalescing{ std::chrono::microseconds(std::strtoul(Configs.TryGet("Receiver.CoalesceWindowUs").value_or("").c_str(), nullptr, 10)),
+                                                      std::strtoul(Configs.TryGet("Receiver.CoalesceBytes").value_or("").c_str(), nullptr, 10) };
+            if (_receiverChannel)
+            {
+                _receiverChannel->SetRequestTimeout(requestTimeout);
+                // A cancel that came while the channel was leased didn't see it, so it is canceled here
+                std::lock_guard lock(_cancellation->Mutex);
+                _cancellation->Channel = _receiverChannel.Get();
+                if (IsCanceled())
+                {
+                    _receiverChannel->Cancel();
+                }
+            }
+        }
+        if (!_receiverChannel)
+        {
+            _receiverError = IsCanceled() ? CanceledError : OpenIPC_Error_Remote_Connection_Unable_To_Connect;
+            return false;
+        }
+        return true;
+    }
+
+    // Closes the bundle's channel, which can't go back to the pool, and has the receiver drop the requests left on it
+    void AbandonReceiverChannel()
+    {
+        const auto timeout = _receiverChannel->RequestTimeout();
+        _receiverChannels->CancelRequests(_receiverChannel->Abandon(), timeout);
+    }
+
+    // The bundle's error for a failed exchange. A wait that timed out or was canceled leaves the channel out of step
+    // with the receiver, so the channel is abandoned, and the receiver drops the requests that were left on it.
+    OpenIPC_Error ReceiverFailureError()
+    {
+        switch (_receiverChannel->Failure())
+        {
+        case ReceiverFailure::TimedOut:
+            AbandonReceiverChannel();
+            return OpenIPC_Error_Probe_Request_Timeout;
+        case ReceiverFailure::Canceled:
+            AbandonReceiverChannel();
+            return CanceledError;
+        default:
+            return OpenIPC_Error_Remote_Connection_Server_Lost;
+        }
+    }
+
+    // The signature of a receiver scan for delta responses: the same TDI through this interface, like a polled register.
+    // Only set once the session negotiated compression, since the receiver ignores it otherwise.
+    std::optional<ReceiverProtocol::DeltaPoll> ReceiverDeltaPoll(const uint8_t* tapTdi, size_t tapBitCount, std::vector<uint8_t>& deltaBase)
+    {
+        if (!_receiverChannels->RunLength)
+        {
+            return std::nullopt;
+        }
+        // FNV-1a
+        uint64_t key = 14695981039346656037ull;
+        const auto mix = [&key](uint8_t byte) { key = (key ^ byte) * 1099511628211ull; };
+        for (size_t shift = 0; shift < 64; shift += 8)
+        {
+            mix(static_cast<uint8_t>(static_cast<uint64_t>(InterfaceRefId) >> shift));
+            mix(static_cast<uint8_t>(static_cast<uint64_t>(tapBitCount) >> shift));
+        }
+        std::for_each(tapTdi, tapTdi + (tapBitCount + 7) / 8, mix);
+
+        ReceiverProtocol::DeltaPoll poll { key, 0 };
+        if (auto base = _receiverChannels->DeltaBases.Find(key))
+        {
+            poll.BaseRequestId = base->first;
+            deltaBase          = std::move(base->second);
+        }
+        return poll;
+    }
+
+    // Shifts the receiver's data register and waits for its TDO, for the scans that need it right away.
+    std::vector<uint8_t> ShiftReceiverDr(const uint8_t* inBits, size_t bitCount)
+    {
+        std::vector<uint8_t> output((bitCount + 7) / 8, 0);
+        // Responses come back in order, so the queued scans' responses are read first
+        CompleteReceiverScans();
+        if (!LeaseReceiverChannel())
+        {
+            return output;
+        }
+        std::vector<uint8_t> deltaBase;
+        const auto poll      = ReceiverDeltaPoll(inBits, bitCount, deltaBase);
+        const auto requestId = _receiverChannels->RequestIds.Next();
+        const auto request   = ReceiverProtocol::BuildShiftRequest(_receiverChannels->Session, requestId, inBits, bitCount, _receiverChannels->RunLength, poll ? &*poll : nullptr);
+        std::string response;
+        if (!_receiverChannel->Exchange(request, response))
+        {
+            _receiverError = ReceiverFailureError();
+        }
+        else if (!ReceiverProtocol::ParseShiftResponse(response, output, poll ? &deltaBase : nullptr))
+        {
+            _receiverError = OpenIPC_Error_TPV_Probe_Transport_State_Error;
+            std::fill(output.begin(), output.end(), static_cast<uint8_t>(0));
+        }
+        else if (poll)
+        {
+            _receiverChannels->DeltaBases.Store(poll->Key, requestId, output);
+        }
+        return output;
+    }
+
+    // Receiver scans longer than one chunk are queued a chunk at a time. A chunk's request takes up a quarter of the
+    // channel's window at most (a byte of TDI is up to 6 bytes of it), so the next chunks are sent while the receiver
+    // shifts the first ones.
+    size_t ReceiverChunkBitCount() const
+    {
+        const size_t window = _receiverChannels ? _receiverChannels->Window.load() : ReceiverChannel::DefaultWindow;
+        return std::clamp<size_t>(window / (4 * 6) * 8, 8, StreamingChunkBitCount);
+    }
+
+    // Queues a scan of the receiver's data register in the channel's batch. Its TDO is written back when the
+    // receiver scans are completed: before an operation that could read it, and at the end of the bundle.
+    void QueueReceiverScan(ReferenceBundleJtagOperations::TdiBits inBits, uint32_t bitCount, uint8_t* outBits, ReferenceSlot* saveTdoToSlot)
+    {
+        const auto [nearTdi, nearTdo, padWithOnes] = GetScanPadding(false);
+        QueueReceiverTapScan(BuildTapTdi(false, inBits, bitCount).data(), nearTdo + bitCount + nearTdi, bitCount, outBits, saveTdoToSlot);
+    }
+
+    // Queues tapBitCount bits of TDI as they reach the TAP, writing back the first bitCount bits of their TDO.
+    // With holdBatch the batch isn't sent by the coalescing, only when the scans are completed or need credit.
+    // A chunk of a longer scan writes its TDO back at tdoOffset.
+    void QueueReceiverTapScan(const uint8_t* tapTdi, size_t tapBitCount, uint32_t bitCount, uint8_t* outBits, ReferenceSlot* saveTdoToSlot, bool holdBatch = false,
+                              std::optional<size_t> tdoOffset = std::nullopt)
+    {
+        if (!LeaseReceiverChannel())
+        {
+            return;
+        }
+        std::vector<uint8_t> deltaBase;
+        const auto poll      = ReceiverDeltaPoll(tapTdi, tapBitCount, deltaBase);
+        const auto requestId = _receiverChannels->RequestIds.Next();
+        const auto request   = ReceiverProtocol::BuildShiftRequest(_receiverChannels->Session, requestId, tapTdi, tapBitCount, _receiverChannels->RunLength, poll ? &*poll : nullptr);
+        if (!_receiverChannel->HasCredit(request.size()))
+        {
+            if (Configs.Is("Receiver.FlowControl", "FailFast"))
+            {
+                // The scans queued before this one made it to the receiver, so their TDO is drained and written back
+                CompleteReceiverScans();
+                _receiverError = _receiverError != OpenIPC_Error_No_Error ? _receiverError : OpenIPC_Error_Probe_Connection_Transient_Error;
+                return;
+            }
+            // All the unanswered requests are this bundle's, so the oldest of them are completed to make room
+            while (!_receiverChannel->HasCredit(request.size()) && !_pendingReceiverScans.empty() && _receiverError == OpenIPC_Error_No_Error)
+            {
+                CompleteReceiverScans(1);
+            }
+            if (_receiverError != OpenIPC_Error_No_Error)
+            {
+                return;
+            }
+        }
+        if (!(holdBatch ? _receiverChannel->Queue(request) : _receiverChannel->Queue(request, _receiverCoalescing)))
+        {
+            _receiverError = ReceiverFailureError();
+            return;
+        }
+        _pendingReceiverScans.push_back(PendingReceiverScan{ tapBitCount, bitCount, outBits, saveTdoToSlot, tdoOffset, _capture, poll, requestId, std::move(deltaBase) });
+    }
+
+    // Sends what is left in the channel's batch, and writes back the TDO of the oldest queued receiver scans
+    // (all of them by default). Every response is read, even after one fails, so the channel stays in step
+    // with the receiver.
+    void CompleteReceiverScans(size_t scanCount = std::numeric_limits<size_t>::max())
+    {
+        scanCount = std::min(scanCount, _pendingReceiverScans.size());
+        if (scanCount == 0)
+        {
+            return;
+        }
+        auto* currentCapture = _capture;
+        std::string response;
+        std::vector<uint8_t> tapTdo;
+        std::vector<uint8_t> output;
+        for (size_t index = 0; index < scanCount; index++)
+        {
+            const auto& scan = _pendingReceiverScans[index];
+            tapTdo.assign((scan.TapBitCount + 7) / 8, 0);
+            if (!_receiverChannel->Receive(response))
+            {
+                const auto failureError = ReceiverFailureError();
+                _receiverError = _receiverError != OpenIPC_Error_No_Error ? _receiverError : failureError;
+            }
+            else if (!ReceiverProtocol::ParseShiftResponse(response, tapTdo, scan.Poll ? &scan.DeltaBase : nullptr))
+            {
+                _receiverError = _receiverError != OpenIPC_Error_No_Error ? _receiverError : OpenIPC_Error_TPV_Probe_Transport_State_Error;
+            }
+            else if (scan.Poll)
+            {
+                _receiverChannels->DeltaBases.Store(scan.Poll->Key, scan.RequestId, tapTdo);
+            }
+            if (_receiverError != OpenIPC_Error_No_Error)
+            {
+                continue;
+            }
+            output.assign((scan.BitCount + 7) / 8, 0);
+            CopyBits(output.data(), 0, tapTdo.data(), 0, scan.BitCount);
+            _capture = scan.Capture;
+            if (scan.TdoOffset)
+            {
+                WriteBackRange(output, scan.BitCount, *scan.TdoOffset, scan.OutBits, scan.SaveTdoToSlot);
+            }
+            else
+            {
+                WriteBack(output, scan.BitCount, scan.OutBits, scan.SaveTdoToSlot);
+            }
+        }
+        _capture = currentCapture;
+        _pendingReceiverScans.erase(_pendingReceiverScans.begin(), _pendingReceiverScans.begin() + static_cast<std::ptrdiff_t>(scanCount));
+    }
 
-    OpenIPC_Error BeginInitialization(OpenIPC_DeviceId interfaceDeviceId) noexcept
+    OpenIPC_Error ExecuteOperation(const ReferenceBundleJtagOperations::SlotModification& op)
     {
-        if (_isInitializing)
-        {
-            return OpenIPC_Error_Already_Initializing;
-        }
-        if (_isInitialized)
+        // value = (value & mask) | valueToOrIn, where an empty mask keeps nothing and an empty valueToOrIn ors in 0's.
+        auto& value = op.Slot->Value;
+        for (size_t i = 0; i < value.size(); i++)
         {
-            return OpenIPC_Error_Already_Initialized;
+            const uint8_t mask  = op.Mask.empty() ? 0 : op.Mask[i];
+            const uint8_t orIn  = op.ValueToOrIn.empty() ? 0 : op.ValueToOrIn[i];
+            value[i] = static_cast<uint8_t>((value[i] & mask) | orIn);
         }
-        InterfaceDeviceId = interfaceDeviceId;
-        _isInitializing   = true;
         return OpenIPC_Error_No_Error;
     }
 
-    OpenIPC_Error FinishInitialization() noexcept
+    OpenIPC_Error ExecuteOperation(const ReferenceBundleJtagOperations::SlotComparison& op)
     {
-        if (!_isInitializing)
+        const auto& value = op.Slot->Value;
+        bool isMatch = true;
+        for (size_t i = 0; i < value.size() && isMatch; i++)
         {
-            return OpenIPC_Error_Not_Initializing;
+            isMatch = (value[i] & op.Mask[i]) == (op.Match[i] & op.Mask[i]);
         }
-        if (_isInitialized)
+        if (op.ComparisonResult)
         {
-            return OpenIPC_Error_Already_Initialized;
+            *op.ComparisonResult = isMatch;
         }
-        _isInitializing = false;
-        _isInitialized  = true;
+        _comparisonSucceeded |= isMatch;
+        _exitBundle = !isMatch && op.ExitBundleOnComparisonFailure;
         return OpenIPC_Error_No_Error;
     }
 
-    OpenIPC_Error DeInitialization() noexcept
+    // A loop that polls the receiver's data register is evaluated by the receiver in one request, once the session
+    // accepted loops, instead of a round trip per iteration: the body's receiver scans and its comparisons of their TDO
+    // are sent with the iteration cap, and only the last iteration's TDO comes back. The body's IR scans and state
+    // changes are simulated for two iterations first, to check that every iteration scans the receiver the same way,
+    // and executed once the receiver answered. The request's deadline bounds the whole loop.
+    // Returns nothing for a loop that runs an iteration at a time: any other body, a loop in a capture, or one that
+    // continues on timeouts, which takes a request per iteration.
+    std::optional<OpenIPC_Error> ExecuteReceiverLoop(const ReferenceBundleJtagOperations::LoopBreakOnComparisonSuccess& op)
     {
-        if (!_isInitializing)
+        using namespace ReferenceBundleJtagOperations;
+        if (!_receiverChannels || !_receiverChannels->Loops || _capture != nullptr || op.ContinueOnTimeoutError || op.MaxNumberOfIterations < 2)
         {
-            return OpenIPC_Error_Not_Initializing;
+            return std::nullopt;
         }
-        if (_isInitialized)
+        const auto isIrScan = [](const auto& scan)
         {
-            return OpenIPC_Error_Already_Initialized;
-        }
-        _isInitializing   = false;
-        _isInitialized    = false;
-        InterfaceDeviceId = OpenIPC_INVALID_DEVICE_ID;
-        return OpenIPC_Error_No_Error;
-    }
+            if constexpr (is_decay_equ<decltype(scan), RegisterScan>)
+            {
+                return scan.ShiftState == JtagShfIR;
+            }
+            else
+            {
+                return is_decay_equ<decltype(scan), IrScan>;
+            }
+        };
+        const auto endState = [](const auto& scan)
+        {
+            if constexpr (is_decay_equ<decltype(scan), RegisterScan>)
+            {
+                return scan.EndState;
+            }
+            else
+            {
+                return is_decay_equ<decltype(scan), IrScan> ? JtagShfIR : JtagShfDR;
+            }
+        };
 
-    PPI_EInterfaceType GetInterfaceType() const noexcept
-    {
-        return PPI_interfaceTypeJtag;
-    }
+        std::vector<ReceiverProtocol::LoopShift> shifts;
+        std::vector<ReceiverProtocol::LoopComparison> comparisons;
+        auto irRegister = _irRegister;
+        auto state      = _currentState;
+        for (int pass = 0; pass < 2; pass++)
+        {
+            const auto passIrValue = irRegister.GetValue();
+            const auto passState   = state;
+            // The slots holding the TDO of a receiver scan of this iteration, with its shift and bit count
+            std::vector<std::tuple<const ReferenceSlot*, size_t, uint32_t>> receiverSlots;
+            size_t shiftCount = 0;
+            for (const auto& operation : op.Body)
+            {
+                const bool canOffload = std::visit([&](const auto& bodyOp)
+                                                   {
+                                                       if constexpr (is_decay_equ<decltype(bodyOp), GoToState>)
+                                                       {
+                                                           state = bodyOp.GotoState;
+                                                           if (state == JtagTLR)
+                                                           {
+                                                               irRegister.Shift(_idcodeIrValue, 8);
+                                                           }
+                                                           return true;
+                                                       }
+                                                       else if constexpr (is_decay_equ<decltype(bodyOp), IrScan> || is_decay_equ<decltype(bodyOp), DrScan> || is_decay_equ<decltype(bodyOp), RegisterScan>)
+                                                       {
+                                                           const bool isIr = isIrScan(bodyOp);
+                                                           if (bodyOp.RestoreTdiFromSlot != nullptr || bodyOp.BitCount > StreamingChunkBitCount
+                                                               || (!isIr && irRegister.GetValue() != _receiverIrValue))
+                                                           {
+                                                               return false;
+                                                           }
+                                                           receiverSlots.erase(std::remove_if(receiverSlots.begin(), receiverSlots.end(),
+                                                                                              [&](const auto& saved) { return std::get<0>(saved) == bodyOp.SaveTdoToSlot; }),
+                                                                               receiverSlots.end());
+                                                           if (isIr || pass == 0)
+                                                           {
+                                                               const auto [nearTdi, nearTdo, padWithOnes] = GetScanPadding(isIr);
+                                                               auto tapTdi = BuildTapTdi(isIr, bodyOp.InBits.Bits(), bodyOp.BitCount);
+                                                               const size_t tapBitCount = nearTdo + bodyOp.BitCount + nearTdi;
+                                                               if (isIr)
+                                                               {
+                                                                   irRegister.Shift(tapTdi.data(), tapBitCount);
+                                                               }
+                                                               else
+                                                               {
+                                                                   shifts.push_back(ReceiverProtocol::LoopShift{ std::move(tapTdi), tapBitCount });
+                                                               }
+                                                           }
+                                                           if (!isIr)
+                                                           {
+                                                               if (bodyOp.SaveTdoToSlot != nullptr)
+                                                               {
+                                                                   receiverSlots.emplace_back(bodyOp.SaveTdoToSlot, shiftCount, bodyOp.BitCount);
+                                                               }
+                                                               shiftCount++;
+                                                           }
+                                                           state = endState(bodyOp);
+                                                           return true;
+                                                       }
+                                                       else if constexpr (is_decay_equ<decltype(bodyOp), SlotComparison>)
+                                                       {
+                                                           const auto saved = std::find_if(receiverSlots.begin(), receiverSlots.end(),
+                                                                                           [&](const auto& receiverSlot) { return std::get<0>(receiverSlot) == bodyOp.Slot; });
+                                                           if (saved == receiverSlots.end() || bodyOp.ExitBundleOnComparisonFailure)
+                                                           {
+                                                               return false;
+                                                           }
+                                                           const auto [slot, shift, bitCount] = *saved;
+                                                           // The slot holds the scan's TDO, which ends in 0's past its last bit
+                                                           const size_t byteCount = (bitCount + 7) / 8;
+                                                           if (bodyOp.Mask.size() < byteCount || bodyOp.Match.size() < byteCount)
+                                                           {
+                                                               return false;
+                                                           }
+                                                           ReceiverProtocol::LoopComparison comparison { shift, { bodyOp.Mask.begin(), bodyOp.Mask.begin() + byteCount },
+                                                                                                         { bodyOp.Match.begin(), bodyOp.Match.begin() + byteCount } };
+                                                           if (bitCount % 8 != 0)
+                                                           {
+                                                               const auto scanBits = static_cast<uint8_t>((1u << (bitCount % 8)) - 1);
+                                                               if ((comparison.Mask.back() & comparison.Match.back() & ~scanBits) != 0)
+                                                               {
+                                                                   return false;
+                                                               }
+                                                               comparison.Mask.back() &= scanBits;
+                                                           }
+                                                           if (pass == 0)
+                                                           {
+                                                               comparisons.push_back(std::move(comparison));
+                                                           }
+                                                           return true;
+                                                       }
+                                                       else
+                                                       {
+                                                           return false;
+                                                       }
+                                                   }, operation);
+                if (!canOffload)
+                {
+                    return std::nullopt;
+                }
+            }
+            // The second iteration has to leave the IR and the state as it found them, for the next ones to repeat it
+            if (shiftCount == 0 || (pass == 1 && (irRegister.GetValue() != passIrValue || state != passState)))
+            {
+                return std::nullopt;
+            }
+        }
 
-    PPI_InterfaceJTAGCapabilities GetJtagCapabilities() noexcept
-    {
-        PPI_InterfaceJTAGCapabilities capabilities{};
-        // Does the interface support using the TRST pin?
-        capabilities.supportTRST = false;
-        // Does the interface support cycling to TLR for a TAP reset. Note: supportTRST | supportTLR == 1
-        capabilities.supportTLR = true;
-        // Does the interface support staying in PauDR in a register interface
-        capabilities.supportPauDRInRegisterInterface = false;
+        CompleteReceiverScans();
+        if (!LeaseReceiverChannel())
+        {
+            return OpenIPC_Error_No_Error;
+        }
+        const auto request = ReceiverProtocol::BuildLoopRequest(_receiverChannels->Session, _receiverChannels->RequestIds.Next(), op.MaxNumberOfIterations,
+                                                                shifts, comparisons, _receiverChannels->RunLength);
+        std::vector<std::vector<uint8_t>> tapTdos;
+        for (const auto& shift : shifts)
+        {
+            tapTdos.emplace_back((shift.BitCount + 7) / 8, 0);
+        }
+        uint32_t iterations = 0;
+        std::string response;
+        if (!_receiverChannel->Exchange(request, response))
+        {
+            _receiverError = ReceiverFailureError();
+            return OpenIPC_Error_No_Error;
+        }
+        if (!ReceiverProtocol::ParseLoopResponse(response, tapTdos, op.MaxNumberOfIterations, iterations))
+        {
+            _receiverError = OpenIPC_Error_TPV_Probe_Transport_State_Error;
+            return OpenIPC_Error_No_Error;
+        }
 
-        return capabilities;
+        // Every iteration after the first repeats the second, so executing up to two leaves what the last one did
+        std::vector<uint8_t> output;
+        for (uint32_t iteration = 0; iteration < std::min<uint32_t>(iterations, 2); iteration++)
+        {
+            size_t shift = 0;
+            for (const auto& operation : op.Body)
+            {
+                std::visit([&](const auto& bodyOp)
+                           {
+                               if constexpr (is_decay_equ<decltype(bodyOp), DrScan> || is_decay_equ<decltype(bodyOp), RegisterScan>)
+                               {
+                                   if (!isIrScan(bodyOp))
+                                   {
+                                       output.assign((bodyOp.BitCount + 7) / 8, 0);
+                                       CopyBits(output.data(), 0, tapTdos[shift++].data(), 0, bodyOp.BitCount);
+                                       WriteBack(output, bodyOp.BitCount, bodyOp.OutBits, bodyOp.SaveTdoToSlot);
+                                       _currentState = endState(bodyOp);
+                                       return;
+                                   }
+                               }
+                               ExecuteOperation(bodyOp);
+                           }, operation);
+            }
+        }
+        return OpenIPC_Error_No_Error;
     }
 
-    OpenIPC_Error ExecuteBundle(ReferenceJtagBundle& bundle)
+    OpenIPC_Error ExecuteOperation(const ReferenceBundleJtagOperations::LoopBreakOnComparisonSuccess& op)
     {
-        PLUGIN_LOGGER.Log(InterfaceDeviceId, PPI_traceNotification, "Enter ReferenceJtagInterface.ExecuteBundle");
+        const bool outerComparisonSucceeded = _comparisonSucceeded;
+        const auto receiverLoopError = ExecuteReceiverLoop(op);
         OpenIPC_Error error = OpenIPC_Error_No_Error;
-        for (auto& operation : bundle.GetOperations())
+        for (uint32_t iteration = 0; !receiverLoopError && iteration < op.MaxNumberOfIterations; iteration++)
         {
-            error = std::visit([&](auto& op)
-                               {
-                                   return ExecuteOperation(op);
-                               }, operation);
+            _comparisonSucceeded = false;
+            _exitBundle = false; // exiting on a comparison failure only ends the current iteration
+            error = ExecuteOperations(op.Body);
+            // A receiver scan that timed out only fails the bundle through _receiverError, and abandons its channel
+            if (error == OpenIPC_Error_No_Error && _receiverError == OpenIPC_Error_Probe_Request_Timeout && op.ContinueOnTimeoutError)
+            {
+                ReleaseReceiverChannel();
+                _receiverError = OpenIPC_Error_No_Error;
+                continue;
+            }
+            if (error != OpenIPC_Error_No_Error || _receiverError != OpenIPC_Error_No_Error || _comparisonSucceeded)
+            {
+                break;
+            }
         }
-        return error;
+        _comparisonSucceeded = outerComparisonSucceeded;
+        _exitBundle = false;
+        return receiverLoopError.value_or(error);
     }
 
-private:
-    OpenIPC_Error ExecuteOperation(const ReferenceBundleJtagOperations::GoToState& op)
+    OpenIPC_Error ExecuteOperation(const ReferenceBundleJtagOperations::LoopCaptureAll& op)
     {
-        _currentState = op.GotoState;
-        if (_currentState == JtagTLR)
+        CaptureBuffer capture(op.BufferForIterations, op.BufferLengthInBytes);
+        auto* outerCapture = std::exchange(_capture, &capture);
+        OpenIPC_Error error = OpenIPC_Error_No_Error;
+        for (uint32_t iteration = 0; iteration < op.NumberOfIterations && error == OpenIPC_Error_No_Error; iteration++)
         {
-            _irRegister.Shift(_idcodeIrValue, 8);
+            _exitBundle = false;
+            error = ExecuteOperations(op.Body);
         }
-        return OpenIPC_Error_No_Error;
+        _exitBundle = false;
+        // The body's receiver scans append to this capture, so they complete before it goes out of scope
+        CompleteReceiverScans();
+        _capture = outerCapture;
+        const auto currentBit = capture.Finish();
+        if (op.CurrentBit)
+        {
+            *op.CurrentBit = static_cast<uint32_t>(currentBit);
+        }
+        return error;
     }
 
-    OpenIPC_Error ExecuteOperation(const ReferenceBundleJtagOperations::IrScan& op)
+    void WriteBack(const std::vector<uint8_t>& output, uint32_t bitCount, uint8_t* outBits, ReferenceSlot* saveTdoToSlot)
     {
-        _currentState = JtagShfIR;
-        auto output = _irRegister.Shift(op.InBits, op.BitCount);
-        assert((op.BitCount + 7) / 8 == output.size());
-        if (op.OutBits)
+        if (outBits && _capture)
         {
-            std::copy_n(output.begin(), (op.BitCount + 7) / 8, op.OutBits);
+            _capture->Append(output, bitCount);
+        }
+        else if (outBits)
+        {
+            std::copy_n(output.begin(), (bitCount + 7) / 8, outBits);
+        }
+        if (saveTdoToSlot)
+        {
+            saveTdoToSlot->Value = output;
         }
-        return OpenIPC_Error_No_Error;
     }
 
-    OpenIPC_Error ExecuteOperation(const ReferenceBundleJtagOperations::DrScan& op)
+    // Writes back bitCount bits of TDO that start bitOffset bits into the scan.
+    void WriteBackRange(const std::vector<uint8_t>& output, size_t bitCount, size_t bitOffset, uint8_t* outBits, ReferenceSlot* saveTdoToSlot)
     {
-        _currentState = JtagShfDR;
-        const auto& irRegisterValue = _irRegister.GetValue();
-        if (std::equal(irRegisterValue.begin(), irRegisterValue.end(), _idcodeIrValue.begin(), _idcodeIrValue.end()))
+        if (outBits && _capture)
         {
-            auto idcodeRegisterCopy = _idcodeRegister; // copying so we don't write to the readonly register
-            auto output = idcodeRegisterCopy.Shift(op.InBits, op.BitCount);
-            //std::vector<uint8_t> output = { 0xde, 0xad, 0xbe, 0xef };
-            assert((op.BitCount + 7) / 8 == output.size());
-            if (op.OutBits)
-            {
-                std::copy_n(output.begin(), (op.BitCount + 7) / 8, op.OutBits);
-            }
+            _capture->Append(output, static_cast<uint32_t>(bitCount));
         }
-        else
+        else if (outBits)
         {
-            auto output = _bypassRegister.Shift(op.InBits, op.BitCount);
-            assert((op.BitCount + 7) / 8 == output.size());
-            if (op.OutBits)
-            {
-                std::copy_n(output.begin(), (op.BitCount + 7) / 8, op.OutBits);
-            }
+            CopyBits(outBits, bitOffset, output.data(), 0, bitCount);
+        }
+        if (saveTdoToSlot)
+        {
+            CopyBits(saveTdoToSlot->Value.data(), bitOffset, output.data(), 0, bitCount);
         }
-        return OpenIPC_Error_No_Error;
     }
 
 };
@@ -627,6 +3822,9 @@ class ReferenceStatePortInterface
     bool _isInitialized { false };
 
     std::array<uint32_t, 4> _valueStore {};
+
+    // Serializes the calls on this interface, like ReferenceJtagInterface::_mutex
+    std::unique_ptr<std::mutex> _mutex { std::make_unique<std::mutex>() };
 public:
     ConfigHolder Configs;
     PPI_RefId InterfaceRefId;
@@ -646,6 +3844,7 @@ public:
 
     OpenIPC_Error BeginInitialization(OpenIPC_DeviceId interfaceDeviceId) noexcept
     {
+        std::lock_guard lock(*_mutex);
         if (_isInitializing)
         {
             return OpenIPC_Error_Already_Initializing;
@@ -661,6 +3860,7 @@ public:
 
     OpenIPC_Error FinishInitialization() noexcept
     {
+        std::lock_guard lock(*_mutex);
         if (!_isInitializing)
         {
             return OpenIPC_Error_Not_Initializing;
@@ -676,6 +3876,7 @@ public:
 
     OpenIPC_Error DeInitialization() noexcept
     {
+        std::lock_guard lock(*_mutex);
         if (!_isInitializing)
         {
             return OpenIPC_Error_Not_Initializing;
@@ -698,6 +3899,7 @@ public:
     OpenIPC_Error ExecuteBundle(ReferenceStatePortBundle& bundle)
     {
         PLUGIN_LOGGER.Log(InterfaceDeviceId, PPI_traceNotification, "Enter ReferenceStatePortInterface.ExecuteBundle");
+        std::lock_guard lock(*_mutex);
         OpenIPC_Error error = OpenIPC_Error_No_Error;
 
         for (const auto& operation : bundle.GetOperations())
@@ -753,6 +3955,9 @@ class ReferenceTraceInterface
     bool _isOpen{ false };
     bool _canRead{ false };
     bool _canWrite{ false };
+
+    // Serializes the calls on this interface, like ReferenceJtagInterface::_mutex
+    std::unique_ptr<std::mutex> _mutex { std::make_unique<std::mutex>() };
 public:
     // By default trace interfaces get their name from the type, and they are not given instanceIds.
     // Since names have to be unique across all devices, and we want multiple of these allowed in our
@@ -776,6 +3981,7 @@ public:
 
     OpenIPC_Error BeginInitialization(OpenIPC_DeviceId interfaceDeviceId) noexcept
     {
+        std::lock_guard lock(*_mutex);
         if (_isInitializing)
         {
             return OpenIPC_Error_Already_Initializing;
@@ -791,6 +3997,7 @@ public:
 
     OpenIPC_Error FinishInitialization() noexcept
     {
+        std::lock_guard lock(*_mutex);
         if (!_isInitializing)
         {
             return OpenIPC_Error_Not_Initializing;
@@ -806,6 +4013,7 @@ public:
 
     OpenIPC_Error DeInitialization() noexcept
     {
+        std::lock_guard lock(*_mutex);
         if (!_isInitializing)
         {
             return OpenIPC_Error_Not_Initializing;
@@ -827,6 +4035,7 @@ public:
 
     OpenIPC_Error OpenWindow(PPI_Trace_PortAccessMode accessMode)
     {
+        std::lock_guard lock(*_mutex);
         if (_isOpen)
         {
             return OpenIPC_Error_InterfacePort_Window_Already_Open;
@@ -839,6 +4048,7 @@ public:
 
     OpenIPC_Error CloseWindow()
     {
+        std::lock_guard lock(*_mutex);
         if (!_isOpen)
         {
             return OpenIPC_Error_InterfacePort_Window_Not_Open;
@@ -849,16 +4059,19 @@ public:
 
     bool IsReadDataAvailable() const
     {
+        std::lock_guard lock(*_mutex);
         return _isOpen && _canRead;
     }
 
     bool IsWindowOpen() const
     {
+        std::lock_guard lock(*_mutex);
         return _isOpen;
     }
 
     OpenIPC_Error Read(uint8_t* output, uint32_t outputSize, uint32_t& actualBytesRead) const
     {
+        std::lock_guard lock(*_mutex);
         if (!_isOpen)
         {
             return OpenIPC_Error_InterfacePort_Window_Not_Open;
@@ -874,6 +4087,7 @@ public:
 
     OpenIPC_Error Write(const uint8_t* input, uint32_t inputSize, uint32_t& actualBytesWritten) const
     {
+        std::lock_guard lock(*_mutex);
         if (!_isOpen)
         {
             return OpenIPC_Error_InterfacePort_Window_Not_Open;
@@ -899,30 +4113,79 @@ class ReferenceProbe
 {
     bool _isInitializing { false };
     bool _isInitialized { false };
-    std::vector<ReferenceJtagInterface> _jtagInterfaces;
+    std::vector<ReferenceInterface> _interfaces;
+    std::unique_ptr<ReceiverConnection> _connection;
+    std::future<OpenIPC_Error> _handshake; // Declared after _connection, so it is waited for before the connection is freed
+    // Where the receiver of this probe listens, reconnected to when the probe is initialized again
+    sockaddr_in _receiverAddress {};
+    // Channels to the receiver, shared with the JTAG interfaces. The handshake's connection becomes its first channel.
+    std::shared_ptr<ReceiverChannelPool> _receiverChannels;
+    static constexpr std::chrono::milliseconds HandshakeTimeout { 5000 };
+    // Size of the data register the receiver simulates for the probe (selected by the JTAG interfaces' IR 0x10)
+    static constexpr uint32_t ReceiverRegisterBitCount = 32;
+    // Index of the next JTAG interface's IDCODE, restarted by each plugin initialization (probes are only added
+    // under the plugin's devices lock)
+    static inline uint32_t _lastIdcodeIndex { 0 };
 public:
-    ConfigHolder Configs { { "RuntimeSetting"sv, "Default" } };
+    // Receiver.Connections: the most channels to the receiver open at once, taken by the interfaces' bundles as they execute
+    // Receiver.ReconnectAttempts and Receiver.ReconnectBackoffMs: how often a dropped channel tries to reconnect, and the
+    // wait before its first attempt (doubled for each next one), before its bundle fails with the server lost
+    // Receiver.Compression: the compression the handshake offers the receiver ("RunLength", or "None"), from the next initialization
+    ConfigHolder Configs { { "RuntimeSetting"sv, "Default" }, { "Receiver.Connections"sv, "2" }, { "Receiver.ReconnectAttempts"sv, "5" },
+                           { "Receiver.ReconnectBackoffMs"sv, "10" }, { "Receiver.Compression"sv, "RunLength" } };
     static const PPI_char* const PROBE_TYPE;
     PPI_RefId ProbeRefId;
     OpenIPC_DeviceId ProbeDeviceId { OpenIPC_INVALID_DEVICE_ID };
 
-    WSADATA wsaData;
-    SOCKET sock;
-    sockaddr_in serverAddr{};
+    static inline const std::vector<PPI_EInterfaceType> DefaultInterfaceTypes { PPI_interfaceTypeJtag, PPI_interfaceTypeJtag };
 
-    explicit ReferenceProbe(PPI_RefId probeRefId) :
+    // A probe found by discovery is created with the connection discovery made, so its handshake doesn't connect again
+    explicit ReferenceProbe(PPI_RefId probeRefId, const std::vector<PPI_EInterfaceType>& interfaceTypes = DefaultInterfaceTypes,
+                            std::unique_ptr<ReceiverConnection> connection = nullptr) :
         //_jtagInterface(42, std::vector<uint8_t> { 0x78, 0x56, 0x34, 0x12 }),
+        _connection(std::move(connection)),
         ProbeRefId(probeRefId)
     {
-        _addJtagInterface();
-        _addJtagInterface();
+        if (_connection)
+        {
+            _receiverAddress = _connection->serverAddr;
+        }
+        else
+        {
+            _receiverAddress.sin_family      = AF_INET;
+            _receiverAddress.sin_port        = htons(12345);  // Make sure this matches the receiver
+            _receiverAddress.sin_addr.s_addr = inet_addr("127.0.0.1");  // Replace with actual IP of receiver
+        }
+        _receiverChannels = std::make_shared<ReceiverChannelPool>(_receiverAddress, [this]
+                                                                  {
+                                                                      ReceiverChannelPool::Settings settings;
+                                                                      settings.Capacity           = _getConfigNumber("Receiver.Connections");
+                                                                      settings.Reconnect.Attempts = static_cast<uint32_t>(_getConfigNumber("Receiver.ReconnectAttempts"));
+                                                                      settings.Reconnect.Backoff  = std::chrono::milliseconds(_getConfigNumber("Receiver.ReconnectBackoffMs"));
+                                                                      return settings;
+                                                                  });
+        _interfaces.reserve(interfaceTypes.size());
+        for (const auto interfaceType : interfaceTypes)
+        {
+            _addInterface(interfaceType);
+        }
+    }
+
+    ~ReferenceProbe()
+    {
+        CloseConnection();
     }
 
-    ~ReferenceProbe() = default;
-    ReferenceProbe(const ReferenceProbe& other)     = delete;
-    ReferenceProbe(ReferenceProbe&& other) noexcept = default;
-    ReferenceProbe& operator=(const ReferenceProbe& other)     = delete;
-    ReferenceProbe& operator=(ReferenceProbe&& other) noexcept = default;
+    // The next JTAG interface created gets the IDCODE 0x12345600 again
+    static void RestartIdcodes() noexcept
+    {
+        _lastIdcodeIndex = 0;
+    }
+    // Not movable: the receiver channel pool reads its settings from this probe's configs
+    ReferenceProbe(const ReferenceProbe& other) = delete;
+    ReferenceProbe(ReferenceProbe&& other)      = delete;
+    ReferenceProbe& operator=(const ReferenceProbe& other) = delete;
+    ReferenceProbe& operator=(ReferenceProbe&& other)      = delete;
 
     OpenIPC_Error BeginInitialization(OpenIPC_DeviceId probeDeviceId) noexcept
     {
@@ -961,174 +4224,511 @@ public:
         CloseHandle(pi.hProcess);
         CloseHandle(pi.hThread);*/
 
-        WSAStartup(MAKEWORD(2, 2), &wsaData);
+        // The connect and the handshake run in the background, so the handshakes of all the probes being
+        // initialized overlap. FinishInitialization only waits for this probe's handshake.
+        std::string payload = "test-message";
+        std::string xml = buildXMLRequest(_receiverChannels->Session, _receiverChannels->RequestIds.Next(), payload);
+        if (!_connection)
+        {
+            _connection = std::make_unique<ReceiverConnection>();
+            _connection->serverAddr = _receiverAddress;
+        }
+        try
+        {
+            _handshake = std::async(std::launch::async, _connectAndHandshake, _connection.get(), _receiverChannels.get(), probeDeviceId, std::move(xml));
+        }
+        catch (const std::system_error&)
+        {
+            // No thread available, FinishInitialization does the handshake itself
+            _handshake = std::async(std::launch::deferred, _connectAndHandshake, _connection.get(), _receiverChannels.get(), probeDeviceId, std::move(xml));
+        }
 
-        sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        return OpenIPC_Error_No_Error;
+    }
 
-        if (sock == INVALID_SOCKET) {
-            PLUGIN_LOGGER.Log(ProbeDeviceId, PPI_errorNotification, "Socket creation failed.\n");
-            return 1;
+    OpenIPC_Error FinishInitialization() noexcept
+    {
+        if (!_isInitializing)
+        {
+            return OpenIPC_Error_Not_Initializing;
+        }
+        if (_isInitialized)
+        {
+            return OpenIPC_Error_Already_Initialized;
+        }
+        // A failed connection is reported, but (as when it was reported by BeginInitialization) doesn't stop the probe initializing
+        const auto connectionError = _handshake.valid() ? _handshake.get() : OpenIPC_Error_No_Error;
+        if (_connection && _connection->sock != INVALID_SOCKET)
+        {
+            _receiverChannels->Add(std::move(_connection));
         }
-        serverAddr.sin_family = AF_INET;
-        serverAddr.sin_port = htons(12345);  // Make sure this matches the receiver
-        serverAddr.sin_addr.s_addr = inet_addr("127.0.0.1");  // Replace with actual IP of receiver
+        _isInitializing = false;
+        _isInitialized  = true;
+        return connectionError;
+    }
 
-        if (connect(sock, (SOCKADDR*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
-            PLUGIN_LOGGER.Log(ProbeDeviceId, PPI_errorNotification, "Connection failed.\n");
-            closesocket(sock);
+    void CloseConnection() noexcept
+    {
+        if (_handshake.valid())
+        {
+            _handshake.wait();
+        }
+        if (_connection && _connection->sock != INVALID_SOCKET)
+        {
+            closesocket(_connection->sock);
             WSACleanup();
-            return 1;
         }
+        _connection.reset();
+        if (_receiverChannels)
+        {
+            _receiverChannels->Close();
+        }
+    }
+
+    PPI_ProbeInfo GetProbeInfo() noexcept
+    {
+        PPI_ProbeInfo info{};
+        CopyStringToArray(info.type,             ReferenceProbe::PROBE_TYPE);
+        CopyStringToArray(info.uniqueIdentifier, "SVE.0");
+        CopyStringToArray(info.probeInfo,        "Reference version 1.0");
+        return info;
+    }
+
+    std::vector<PPI_RefId> InterfaceGetRefIds() const noexcept
+    {
+        /*std::vector<PPI_RefId> interfaceRefIds{
+            _jtagInterface.InterfaceRefId,
+        };
+        return interfaceRefIds;*/
+        std::vector<PPI_RefId> interfaceRefIds;
+        interfaceRefIds.reserve(_interfaces.size());
+        for (const auto& probeInterface : _interfaces)
+        {
+            interfaceRefIds.push_back(std::visit([](const auto& anyInterface) { return anyInterface.InterfaceRefId; }, probeInterface));
+        }
+        return interfaceRefIds;
+    }
+
+    uint32_t GetInterfaceCount() const noexcept
+    {
+        return static_cast<uint32_t>(_interfaces.size());
+    }
+
+    ReferenceInterface& GetInterfaceAt(uint32_t interfaceSlot) noexcept
+    {
+        return _interfaces[interfaceSlot];
+    }
+
+    std::optional<uint32_t> FindInterfaceSlotByRefId(PPI_RefId interfaceRefId) const noexcept
+    {
+        for (uint32_t interfaceSlot = 0; interfaceSlot < _interfaces.size(); interfaceSlot++)
+        {
+            if (std::visit([](const auto& anyInterface) { return anyInterface.InterfaceRefId; }, _interfaces[interfaceSlot]) == interfaceRefId)
+            {
+                return interfaceSlot;
+            }
+        }
+        return std::nullopt;
+    }
+
+    MaybeReferenceInterfaceRef GetInterfaceByRefId(PPI_RefId interfaceRefId)
+    {
+        /*if (_jtagInterface.InterfaceRefId == interfaceRefId)
+        {
+            return std::ref(_jtagInterface);
+        }
+        return std::monostate();*/
+
+        const auto interfaceSlot = FindInterfaceSlotByRefId(interfaceRefId);
+        if (!interfaceSlot)
+        {
+            return std::monostate();
+        }
+        return std::visit([](auto& anyInterface) -> MaybeReferenceInterfaceRef
+                          {
+                              return std::ref(anyInterface);
+                          }, _interfaces[*interfaceSlot]);
+    }
+
+    // The handshake also initializes the session's data register on the receiver to ReceiverRegisterBitCount 0's, so
+    // the probe's receiver scans don't depend on whatever the receiver's shared register was left holding
+    std::string buildXMLRequest(uint64_t session, uint64_t request_id, const std::string& payload) {
+        const auto requestIdText = RequestIdSequence::ToText(request_id);
+        const auto sessionText   = RequestIdSequence::ToText(session);
+        std::ostringstream oss;
+        oss << "<request>"
+            << "<request_id>";
+        oss.write(requestIdText.data(), requestIdText.size());
+        oss << "</request_id>"
+            << "<session>";
+        oss.write(sessionText.data(), sessionText.size());
+        oss << "</session>"
+            << "<initialize>True</initialize>"
+            << "<size>" << ReceiverRegisterBitCount << "</size>"
+            << "<value>";
+        for (uint32_t byte = 0; byte < (ReceiverRegisterBitCount + 7) / 8; byte++)
+        {
+            oss << (byte > 0 ? ", 0x00" : "0x00");
+        }
+        oss << "</value>";
+        if (Configs.Is("Receiver.Compression", ReceiverProtocol::RunLengthCompression))
+        {
+            oss << "<compression>" << ReceiverProtocol::RunLengthCompression << "</compression>";
+        }
+        oss
+            << "<loops>" << ReceiverProtocol::LoopsAccepted << "</loops>"
+            << "<payload>" << payload << "</payload>"
+            << "</request>";
+        return oss.str();
+    }
+
+private:
+    size_t _getConfigNumber(std::string_view name)
+    {
+        return std::strtoul(Configs.TryGet(name).value_or("").c_str(), nullptr, 10);
+    }
+
+    // Sets the pool's RunLength and Loops to whether the receiver accepted the compression and the loops the handshake offered
+    static OpenIPC_Error _connectAndHandshake(ReceiverConnection* connection, ReceiverChannelPool* channels, OpenIPC_DeviceId probeDeviceId, std::string xml) noexcept
+    {
+        channels->RunLength = false;
+        channels->Loops     = false;
+        SOCKET sock = connection->sock;
+        if (sock == INVALID_SOCKET) {
+            // The connect is bounded like the response, so an unreachable receiver doesn't hold up the initialization
+            auto connected = ReceiverDiscovery::Connect(connection->serverAddr, std::chrono::steady_clock::now() + HandshakeTimeout);
+            if (!connected) {
+                PLUGIN_LOGGER.Log(probeDeviceId, PPI_errorNotification, "Connection failed.\n");
+                return 1;
+            }
+            // Its WSAStartup is balanced by the Close of the probe's connection
+            *connection = *connected;
+            sock = connection->sock;
+        }
+
+        // const char* message = "get";  // Hardcoded message instead of argv
+        char buffer[1024];
+
+        send(sock, xml.c_str(), (int)xml.size(), 0);
+
+        // A receiver that doesn't answer in time fails the handshake, and its connection isn't used as a channel
+        WSAPOLLFD pollFd { sock, POLLRDNORM, 0 };
+        if (WSAPoll(&pollFd, 1, static_cast<int>(HandshakeTimeout.count())) == 0) {
+            PLUGIN_LOGGER.Log(probeDeviceId, PPI_errorNotification, "Handshake timed out.\n");
+            ReceiverDiscovery::Close(*connection);
+            return OpenIPC_Error_Probe_Request_Timeout;
+        }
+
+        int bytesReceived = recv(sock, buffer, sizeof(buffer) - 1, 0);
+        if (bytesReceived > 0) {
+            buffer[bytesReceived] = '\0';
+
+            PLUGIN_LOGGER.Log(probeDeviceId, PPI_infoNotification, buffer);
+            channels->RunLength = ReceiverProtocol::FindElement(buffer, "compression") == ReceiverProtocol::RunLengthCompression;
+            channels->Loops     = ReceiverProtocol::FindElement(buffer, "loops") == ReceiverProtocol::LoopsAccepted;
+            const auto window   = ReceiverProtocol::FindElement(buffer, "window");
+            if (!window.empty())
+            {
+                channels->Window = std::strtoull(std::string(window).c_str(), nullptr, 10);
+            }
+        }
+        else {
+            PLUGIN_LOGGER.Log(probeDeviceId, PPI_infoNotification, "No response received.\n");
+        }
+        return OpenIPC_Error_No_Error;
+    }
+
+    uint32_t _getNextInterfaceRefId() const noexcept
+    {
+        static uint32_t lastInterfaceIndex = 42;
+        const uint32_t  newInterfaceRefId = lastInterfaceIndex;
+        lastInterfaceIndex++;
+        return newInterfaceRefId;
+    }
 
-        return OpenIPC_Error_No_Error;
+    // 0x12345600, 0x12345601, ... so every JTAG interface of a large farm still has its own IDCODE
+    std::vector<uint8_t> _getNextIdcodeValue() const noexcept
+    {
+        const uint32_t idcode = 0x12345600 + _lastIdcodeIndex;
+        const std::vector<uint8_t> newIdcodeValue = { static_cast<uint8_t>(idcode), static_cast<uint8_t>(idcode >> 8),
+                                                      static_cast<uint8_t>(idcode >> 16), static_cast<uint8_t>(idcode >> 24) };
+        _lastIdcodeIndex++;
+        return newIdcodeValue;
     }
 
-    OpenIPC_Error FinishInitialization() noexcept
+    void _addInterface(PPI_EInterfaceType interfaceType) noexcept
     {
-        // const char* message = "get";  // Hardcoded message instead of argv
-        char buffer[1024];
+        switch (interfaceType)
+        {
+        case PPI_interfaceTypeStatePort:
+            _interfaces.emplace_back(std::in_place_type<ReferenceStatePortInterface>, _getNextInterfaceRefId());
+            break;
+        case PPI_interfaceTypeHtiTrace:
+            _interfaces.emplace_back(std::in_place_type<ReferenceTraceInterface>, _getNextInterfaceRefId());
+            break;
+        default:
+            _interfaces.emplace_back(std::in_place_type<ReferenceJtagInterface>, _getNextInterfaceRefId(), _getNextIdcodeValue(), _receiverChannels);
+            break;
+        }
+    }
 
-        std::string payload = "test-message";
-        std::string request_id = getCurrentEpochMillisUTC(); 
-        std::string xml = buildXMLRequest(request_id, payload);
-        send(sock, xml.c_str(), (int)xml.size(), 0);
+};
+const PPI_char* const ReferenceProbe::PROBE_TYPE = "SVEProbe";
 
-        int bytesReceived = recv(sock, buffer, sizeof(buffer) - 1, 0);
-        if (bytesReceived > 0) {
-            buffer[bytesReceived] = '\0';
+// Handle to an object in a Slab: its slot, and the generation of the slot when the object was put there.
+struct SlabHandle
+{
+    uint32_t Index;
+    uint32_t Generation;
+};
 
-            PLUGIN_LOGGER.Log(ProbeDeviceId, PPI_infoNotification, buffer);
-        }
-        else {
-            PLUGIN_LOGGER.Log(ProbeDeviceId, PPI_infoNotification, "No response received.\n");
-        }
-        
-        if (!_isInitializing)
+// Objects stored in fixed size blocks, so they never move once constructed: adding objects allocates new
+// blocks instead of reallocating, and removing one only frees its slot (for reuse by a later object).
+// A slot's generation is bumped when its object is removed, so a handle to a removed object is detected
+// instead of silently reaching whatever object reuses the slot.
+template <typename T>
+class Slab
+{
+    static constexpr uint32_t BlockSize = 32;
+    struct Slot
+    {
+        std::optional<T> Object;
+        uint32_t Generation { 0 };
+    };
+    using Block = std::array<Slot, BlockSize>;
+    std::vector<std::unique_ptr<Block>> _blocks;
+    std::vector<uint32_t> _freeSlots;
+    uint32_t _slotCount { 0 };
+
+public:
+    template <typename... Args>
+    std::pair<SlabHandle, T*> Emplace(Args&&... args)
+    {
+        uint32_t index;
+        if (!_freeSlots.empty())
         {
-            return OpenIPC_Error_Not_Initializing;
+            index = _freeSlots.back();
+            _freeSlots.pop_back();
         }
-        if (_isInitialized)
+        else
         {
-            return OpenIPC_Error_Already_Initialized;
+            if (_slotCount % BlockSize == 0)
+            {
+                _blocks.push_back(std::make_unique<Block>());
+            }
+            index = _slotCount++;
         }
-        _isInitializing = false;
-        _isInitialized  = true;
-        return OpenIPC_Error_No_Error;
+        auto& slot = _slot(index);
+        slot.Object.emplace(std::forward<Args>(args)...);
+        return { SlabHandle{ index, slot.Generation }, &*slot.Object };
     }
 
-    PPI_ProbeInfo GetProbeInfo() noexcept
+    T* Get(SlabHandle handle) noexcept
     {
-        PPI_ProbeInfo info{};
-        CopyStringToArray(info.type,             ReferenceProbe::PROBE_TYPE);
-        CopyStringToArray(info.uniqueIdentifier, "SVE.0");
-        CopyStringToArray(info.probeInfo,        "Reference version 1.0");
-        return info;
+        if (handle.Index >= _slotCount)
+        {
+            return nullptr;
+        }
+        auto& slot = _slot(handle.Index);
+        return slot.Generation == handle.Generation && slot.Object ? &*slot.Object : nullptr;
     }
 
-    std::vector<PPI_RefId> InterfaceGetRefIds() const noexcept
+    bool Remove(SlabHandle handle) noexcept
     {
-        /*std::vector<PPI_RefId> interfaceRefIds{
-            _jtagInterface.InterfaceRefId,
-        };
-        return interfaceRefIds;*/
-        std::vector<PPI_RefId> interfaceRefIds;
-        interfaceRefIds.reserve(_jtagInterfaces.size());
-        for (const auto& jtag : _jtagInterfaces)
+        if (Get(handle) == nullptr)
         {
-            interfaceRefIds.push_back(jtag.InterfaceRefId);
+            return false;
         }
-        return interfaceRefIds;
+        auto& slot = _slot(handle.Index);
+        slot.Object.reset();
+        slot.Generation++;
+        _freeSlots.push_back(handle.Index);
+        return true;
     }
 
-    MaybeReferenceInterfaceRef GetInterfaceByRefId(PPI_RefId interfaceRefId)
+    // Calls function on every object, in slot order
+    template <typename Function>
+    void ForEach(Function&& function) const
     {
-        /*if (_jtagInterface.InterfaceRefId == interfaceRefId)
+        for (uint32_t index = 0; index < _slotCount; index++)
         {
-            return std::ref(_jtagInterface);
+            const auto& slot = _slot(index);
+            if (slot.Object)
+            {
+                function(*slot.Object);
+            }
         }
-        return std::monostate();*/
+    }
+
+    size_t Size() const noexcept
+    {
+        return _slotCount - _freeSlots.size();
+    }
+
+private:
+    Slot& _slot(uint32_t index) noexcept
+    {
+        return (*_blocks[index / BlockSize])[index % BlockSize];
+    }
+
+    const Slot& _slot(uint32_t index) const noexcept
+    {
+        return (*_blocks[index / BlockSize])[index % BlockSize];
+    }
+};
+
+// Flat open addressing (linear probing) map from a device or ref id to the slot of the object with that id.
+// A lookup is a multiplicative hash and, at the load factor kept here, about one probe of the table.
+template <typename Slot>
+class IdIndex
+{
+    struct Entry
+    {
+        uint32_t Id;
+        Slot Value;
+        bool Used;
+    };
+    std::vector<Entry> _entries = std::vector<Entry>(8);
+    uint32_t _hashShift { 32 - 3 }; // 32 - log2(_entries.size())
+    size_t _count { 0 };
 
-        const auto interfaceIter = std::find_if(_jtagInterfaces.begin(), _jtagInterfaces.end(),
-                                            [interfaceRefId](const ReferenceJtagInterface& jtag)
-                                            {
-                                                return jtag.InterfaceRefId == interfaceRefId;
-                                            });
-        if (interfaceIter == _jtagInterfaces.end())
+public:
+    const Slot* Find(uint32_t id) const noexcept
+    {
+        const size_t mask = _entries.size() - 1;
+        for (size_t position = _home(id); _entries[position].Used; position = (position + 1) & mask)
         {
-            return std::monostate();
+            if (_entries[position].Id == id)
+            {
+                return &_entries[position].Value;
+            }
         }
-        return *interfaceIter;
+        return nullptr;
     }
 
-    MaybeReferenceInterfaceRef GetInterfaceByDeviceId(OpenIPC_DeviceId interfaceDeviceId)
+    void Insert(uint32_t id, Slot value)
     {
-        /*if (_jtagInterface.InterfaceDeviceId == interfaceDeviceId)
+        if (2 * (_count + 1) > _entries.size())
         {
-            return std::ref(_jtagInterface);
+            _grow();
         }
-        return std::monostate();*/
-
-        const auto interfaceIter = std::find_if(_jtagInterfaces.begin(), _jtagInterfaces.end(),
-            [interfaceDeviceId](const ReferenceJtagInterface& jtag)
-            {
-                return jtag.InterfaceDeviceId == interfaceDeviceId;
-            });
-        if (interfaceIter == _jtagInterfaces.end())
+        const size_t mask = _entries.size() - 1;
+        size_t position   = _home(id);
+        while (_entries[position].Used && _entries[position].Id != id)
         {
-            return std::monostate();
+            position = (position + 1) & mask;
         }
-        return *interfaceIter;
-    }
-
-    std::string getCurrentEpochMillisUTC() {
-        auto now = std::chrono::system_clock::now();
-        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
-        return std::to_string(ms);
+        if (!_entries[position].Used)
+        {
+            _count++;
+        }
+        _entries[position] = Entry{ id, value, true };
     }
 
-    std::string buildXMLRequest(const std::string& request_id, const std::string& payload) {
-        std::ostringstream oss;
-        oss << "<request>"
-            << "<request_id>" << request_id << "</request_id>"
-            << "<payload>" << payload << "</payload>"
-            << "</request>";
-        return oss.str();
+    // Backward shift deletion, so the table never fills up with tombstones.
+    void Erase(uint32_t id) noexcept
+    {
+        const size_t mask = _entries.size() - 1;
+        size_t hole = _home(id);
+        while (_entries[hole].Used && _entries[hole].Id != id)
+        {
+            hole = (hole + 1) & mask;
+        }
+        if (!_entries[hole].Used)
+        {
+            return;
+        }
+        _entries[hole].Used = false;
+        _count--;
+        for (size_t position = (hole + 1) & mask; _entries[position].Used; position = (position + 1) & mask)
+        {
+            // An entry can fill the hole if the hole is no further from its home than where it is now
+            const size_t home = _home(_entries[position].Id);
+            if (((position - home) & mask) >= ((position - hole) & mask))
+            {
+                _entries[hole] = _entries[position];
+                _entries[position].Used = false;
+                hole = position;
+            }
+        }
     }
 
-private:
-    uint32_t _getNextInterfaceRefId() const noexcept
+    void Clear() noexcept
     {
-        static uint32_t lastInterfaceIndex = 42;
-        const uint32_t  newInterfaceRefId = lastInterfaceIndex;
-        lastInterfaceIndex++;
-        return newInterfaceRefId;
+        for (auto& entry : _entries)
+        {
+            entry.Used = false;
+        }
+        _count = 0;
     }
 
-    std::vector<uint8_t> _getNextIdcodeValue() const noexcept
+private:
+    // The high bits of the product depend on every bit of the id, so ids differing only in their
+    // upper half (like the probe ref ids) still spread over the table.
+    size_t _home(uint32_t id) const noexcept
     {
-        static uint8_t lastIdcodeIndex = 0;
-        const std::vector<uint8_t> newIdcodeValue = { lastIdcodeIndex, 0x56, 0x34, 0x12 };
-        lastIdcodeIndex++;
-        return newIdcodeValue;
+        return static_cast<uint32_t>(id * 0x9E3779B1u) >> _hashShift;
     }
 
-    void _addJtagInterface() noexcept
+    void _grow()
     {
-        _jtagInterfaces.emplace_back(_getNextInterfaceRefId(), _getNextIdcodeValue());
+        std::vector<Entry> entries(2 * _entries.size());
+        std::swap(entries, _entries);
+        _hashShift--;
+        _count = 0;
+        for (const auto& entry : entries)
+        {
+            if (entry.Used)
+            {
+                Insert(entry.Id, entry.Value);
+            }
+        }
     }
-
 };
-const PPI_char* const ReferenceProbe::PROBE_TYPE = "SVEProbe";
 
 // ==== Plugin ====
 class SVEPlugin
 {
     PPI_RefId _pluginId;
     static inline const std::vector<const PPI_char*> _probeTypes {ReferenceProbe::PROBE_TYPE};
-    std::vector<ReferenceProbe> _probes;
+    // Probes never move, so references to them and their interfaces stay valid while other probes come and go
+    Slab<ReferenceProbe> _probes;
+
+    // Where each probe and interface is in _probes, by id. Maintained when probes are added and removed
+    // and when probes and interfaces are initialized and deinitialized, so PPI calls don't search _probes.
+    struct InterfaceSlot
+    {
+        SlabHandle Probe;
+        uint32_t Interface;
+    };
+    IdIndex<SlabHandle> _probesByRefId;
+    IdIndex<SlabHandle> _probesByDeviceId;
+    IdIndex<InterfaceSlot> _interfacesByDeviceId;
+    // Guards _probes and the indexes. Lookups share it and only adding, removing or (de)initializing takes it
+    // exclusively; it is released before an interface runs anything, so scans only contend on their own interface.
+    mutable std::shared_mutex _devicesMutex;
+
+    // Interfaces kept locked by PPI_Lock_Target_Interface or keepLock, and the one PPI_PROBE_LOCK_HOLD scans target
+    std::vector<OpenIPC_DeviceId> _lockedInterfaces;
+    OpenIPC_DeviceId _lockTargetInterface { OpenIPC_INVALID_DEVICE_ID };
+    mutable std::mutex _lockStateMutex;
+
+    // The SVEPlugin.ReceiverEndpoints value the last discovery ran for, so it only runs again when that changes,
+    // and the probe discovered on each endpoint (by ReceiverDiscovery::EndpointKey), so it isn't discovered twice
+    std::optional<std::string> _discoveredEndpoints;
+    std::unordered_map<uint64_t, PPI_RefId> _probesByEndpoint;
+    std::mutex _discoveryMutex;
 public:
     // Plugin level configs should be minimized to avoid polluting the root config scope.
-    ConfigHolder Configs { { "SVEPlugin.Setting"sv, "Value" } };
+    // SVEPlugin.BorrowTdiBuffers: "True" when the host keeps the TDI buffers it passes to the state and register
+    // shifts valid until the bundle is executed or cleared, so the scans reference them instead of copying them.
+    // SVEPlugin.ReceiverEndpoints: "ip:port,ip:port,..." of the receivers to discover probes on, all at once, when
+    // the probes are next listed. Each receiver that accepts within SVEPlugin.DiscoveryTimeoutMs adds a probe.
+    // SVEPlugin.AddFakeProbes: number of fake probes to add when the probes are next listed (it is then reset to 0),
+    // each with the SVEPlugin.FakeProbeInterfaces interfaces: a list of "Jtag", "StatePort" and "HTI", e.g. "Jtag,HTI".
+    ConfigHolder Configs { { "SVEPlugin.Setting"sv, "Value" }, { "SVEPlugin.BorrowTdiBuffers"sv, "False" },
+                           { "SVEPlugin.ReceiverEndpoints"sv, "" }, { "SVEPlugin.DiscoveryTimeoutMs"sv, "500" },
+                           { "SVEPlugin.AddFakeProbes"sv, "0" }, { "SVEPlugin.FakeProbeInterfaces"sv, "Jtag,Jtag" } };
 
     static void PluginGetInfo(PPI_PluginApiVersion clientInterfaceVersion, PPI_PluginInfo& info) noexcept
     {
@@ -1145,6 +4745,7 @@ public:
     explicit SVEPlugin(PPI_RefId pluginId) :
         _pluginId(pluginId)
     {
+        ReferenceProbe::RestartIdcodes();
         _addFakeProbe(); // Adding an initial probe, as though we discovered one
     }
 
@@ -1160,100 +4761,377 @@ public:
         return _probeTypes;
     }
 
+    // Adds the probes requested by SVEPlugin.AddFakeProbes, and a probe for each receiver found on
+    // SVEPlugin.ReceiverEndpoints when that changed. Endpoints that already have a probe aren't connected to again.
+    void DiscoverProbes()
+    {
+        std::lock_guard discoveryLock(_discoveryMutex);
+        _addFakeProbeFarm();
+        const auto endpoints = Configs.TryGet("SVEPlugin.ReceiverEndpoints").value_or("");
+        if (endpoints.empty() || endpoints == _discoveredEndpoints)
+        {
+            return;
+        }
+        _discoveredEndpoints = endpoints;
+        const auto timeoutText = Configs.TryGet("SVEPlugin.DiscoveryTimeoutMs").value_or("");
+        const std::chrono::milliseconds timeout(std::strtoul(timeoutText.c_str(), nullptr, 10));
+
+        std::vector<sockaddr_in> newEndpoints;
+        {
+            std::shared_lock lock(_devicesMutex);
+            for (const auto& endpoint : ReceiverDiscovery::ParseEndpoints(endpoints))
+            {
+                const auto key = ReceiverDiscovery::EndpointKey(endpoint);
+                const bool isListed = std::any_of(newEndpoints.begin(), newEndpoints.end(), [key](const sockaddr_in& listed)
+                                                  {
+                                                      return ReceiverDiscovery::EndpointKey(listed) == key;
+                                                  });
+                if (_probesByEndpoint.count(key) == 0 && !isListed)
+                {
+                    newEndpoints.push_back(endpoint);
+                }
+            }
+        }
+        if (newEndpoints.empty())
+        {
+            return;
+        }
+
+        auto connections = ReceiverDiscovery::ConnectAll(newEndpoints, timeout);
+        std::unique_lock lock(_devicesMutex);
+        for (auto& connection : connections)
+        {
+            const auto key = ReceiverDiscovery::EndpointKey(connection->serverAddr);
+            const auto* probe = _addFakeProbe(ReferenceProbe::DefaultInterfaceTypes, std::move(connection));
+            _probesByEndpoint[key] = probe->ProbeRefId;
+        }
+    }
+
     std::vector<PPI_RefId> ProbeGetRefIds() const noexcept
     {
-        std::vector<PPI_RefId> probeRefIds;
-        probeRefIds.reserve(_probes.size());
-        for (const auto& probe : _probes)
+        std::shared_lock lock(_devicesMutex);
+        std::vector<PPI_RefId> probeRefIds;
+        probeRefIds.reserve(_probes.Size());
+        _probes.ForEach([&probeRefIds](const ReferenceProbe& probe)
+                        {
+                            probeRefIds.push_back(probe.ProbeRefId);
+                        });
+        return probeRefIds;
+    }
+
+    ReferenceProbe* GetProbeByRefId(PPI_RefId probeRefId) noexcept
+    {
+        std::shared_lock lock(_devicesMutex);
+        const auto* handle = _probesByRefId.Find(probeRefId);
+        return handle ? _probes.Get(*handle) : nullptr;
+    }
+
+    ReferenceProbe* GetProbeByDeviceId(OpenIPC_DeviceId probeDeviceId) noexcept
+    {
+        std::shared_lock lock(_devicesMutex);
+        const auto* handle = _probesByDeviceId.Find(probeDeviceId);
+        return handle ? _probes.Get(*handle) : nullptr;
+    }
+
+    OpenIPC_Error ProbeBeginInitialization(PPI_RefId probeRefId, OpenIPC_DeviceId probeDeviceId)
+    {
+        std::unique_lock lock(_devicesMutex);
+        const auto* handle = _probesByRefId.Find(probeRefId);
+        auto* probe = handle ? _probes.Get(*handle) : nullptr;
+        if (probe == nullptr)
+        {
+            return OpenIPC_Error_Invalid_Device_ID;
+        }
+        const auto error = probe->BeginInitialization(probeDeviceId);
+        if (error == OpenIPC_Error_No_Error)
+        {
+            _probesByDeviceId.Insert(probeDeviceId, *handle);
+        }
+        return error;
+    }
+
+    OpenIPC_Error InterfaceBeginInitialization(OpenIPC_DeviceId probeDeviceId, PPI_RefId interfaceRefId, OpenIPC_DeviceId interfaceDeviceId)
+    {
+        std::unique_lock lock(_devicesMutex);
+        const auto* probeHandle = _probesByDeviceId.Find(probeDeviceId);
+        auto* probe = probeHandle ? _probes.Get(*probeHandle) : nullptr;
+        if (probe == nullptr)
+        {
+            return OpenIPC_Error_Invalid_Device_ID;
+        }
+        const auto interfaceSlot = probe->FindInterfaceSlotByRefId(interfaceRefId);
+        if (!interfaceSlot)
+        {
+            return OpenIPC_Error_Invalid_Device_ID;
+        }
+        const auto error = std::visit([interfaceDeviceId](auto& anyInterface)
+                                      {
+                                          return anyInterface.BeginInitialization(interfaceDeviceId);
+                                      }, probe->GetInterfaceAt(*interfaceSlot));
+        if (error == OpenIPC_Error_No_Error)
+        {
+            _interfacesByDeviceId.Insert(interfaceDeviceId, InterfaceSlot{ *probeHandle, *interfaceSlot });
+        }
+        return error;
+    }
+
+    // Deinitializing waits for the interface's in-flight calls. The devices lock is only shared meanwhile, which
+    // keeps the probe from being removed under the call without blocking lookups; interface calls never take it.
+    OpenIPC_Error InterfaceDeInitialize(OpenIPC_DeviceId interfaceDeviceId)
+    {
+        OpenIPC_Error error;
+        {
+            std::shared_lock lock(_devicesMutex);
+            auto* probeInterface = _findInterface(interfaceDeviceId);
+            if (probeInterface == nullptr)
+            {
+                return OpenIPC_Error_Invalid_Device_ID;
+            }
+            error = std::visit([](auto& anyInterface) { return anyInterface.DeInitialization(); }, *probeInterface);
+        }
+        if (error == OpenIPC_Error_No_Error)
+        {
+            std::unique_lock lock(_devicesMutex);
+            _interfacesByDeviceId.Erase(interfaceDeviceId);
+        }
+        return error;
+    }
+
+    // Closes the probe's connection first, under the shared lock so the probe can't be removed meanwhile, as
+    // closing waits for the handshake; then removes the probe, unless another call removed it in between
+    OpenIPC_Error ProbeDeInitialize(OpenIPC_DeviceId probeDeviceId)
+    {
+        {
+            std::shared_lock lock(_devicesMutex);
+            const auto* handle = _probesByDeviceId.Find(probeDeviceId);
+            auto* probe = handle ? _probes.Get(*handle) : nullptr;
+            if (probe == nullptr)
+            {
+                return OpenIPC_Error_Invalid_Device_ID;
+            }
+            probe->CloseConnection();
+        }
+        return RemoveProbeByDeviceId(probeDeviceId);
+    }
+
+    ReferenceProbe* CreateProbe(const std::string_view probeType) noexcept
+    {
+        if(probeType != ReferenceProbe::PROBE_TYPE)
+        {
+            return nullptr;
+        }
+        std::unique_lock lock(_devicesMutex);
+        return _addFakeProbe();
+    }
+
+    MaybeReferenceInterfaceRef GetInterfaceByDeviceId(OpenIPC_DeviceId interfaceDeviceId) noexcept
+    {
+        std::shared_lock lock(_devicesMutex);
+        auto* probeInterface = _findInterface(interfaceDeviceId);
+        if (probeInterface == nullptr)
+        {
+            return std::monostate();
+        }
+        return std::visit([](auto& anyInterface) -> MaybeReferenceInterfaceRef
+                          {
+                              return std::ref(anyInterface);
+                          }, *probeInterface);
+    }
+
+    void LockInterface(OpenIPC_DeviceId interfaceDeviceId)
+    {
+        std::lock_guard lock(_lockStateMutex);
+        _lockInterface(interfaceDeviceId);
+    }
+
+    void UnlockInterface(OpenIPC_DeviceId interfaceDeviceId)
+    {
+        std::lock_guard lock(_lockStateMutex);
+        _unlockInterface(interfaceDeviceId);
+    }
+
+    void SetLockTargetInterface(OpenIPC_DeviceId interfaceDeviceId)
+    {
+        std::lock_guard lock(_lockStateMutex);
+        _lockInterface(interfaceDeviceId);
+        _lockTargetInterface = interfaceDeviceId;
+    }
+
+    // A copy, as other threads may lock and unlock interfaces while the caller walks it
+    std::vector<OpenIPC_DeviceId> GetLockedInterfaces() const
+    {
+        std::lock_guard lock(_lockStateMutex);
+        return _lockedInterfaces;
+    }
+
+    // Runs the operation(s) appended by append directly on the lock target interface.
+    // PPI_PROBE_LOCK_RELEASE releases the lock afterwards, PPI_PROBE_LOCK_HOLD keeps it.
+    template <typename AppendFunction>
+    OpenIPC_Error ExecuteImmediate(bool keepLock, AppendFunction&& append)
+    {
+        // Reused by every immediate operation on this thread, so immediate scans don't allocate a bundle
+        thread_local ReferenceJtagBundle immediateBundle;
+        OpenIPC_DeviceId lockTargetInterface;
+        {
+            std::lock_guard lock(_lockStateMutex);
+            lockTargetInterface = _lockTargetInterface;
+        }
+        if (lockTargetInterface == OpenIPC_INVALID_DEVICE_ID)
+        {
+            return OpenIPC_Error_Probe_Bundle_Invalid;
+        }
+        auto probeInterface = GetInterfaceByDeviceId(lockTargetInterface);
+        auto* jtagInterface = std::get_if<std::reference_wrapper<ReferenceJtagInterface>>(&probeInterface);
+        if (jtagInterface == nullptr)
+        {
+            return OpenIPC_Error_Probe_Bundle_Invalid;
+        }
+        immediateBundle.Clear();
+        OpenIPC_Error error = append(immediateBundle);
+        if (error == OpenIPC_Error_No_Error)
+        {
+            error = jtagInterface->get().ExecuteBundle(immediateBundle, keepLock);
+        }
+        immediateBundle.Clear();
+        if (!keepLock)
+        {
+            UnlockInterface(lockTargetInterface);
+        }
+        return error;
+    }
+
+    OpenIPC_Error RemoveProbeByDeviceId(OpenIPC_DeviceId probeDeviceId) noexcept
+    {
+        std::unique_lock lock(_devicesMutex);
+        const auto* foundHandle = _probesByDeviceId.Find(probeDeviceId);
+        auto* probe = foundHandle ? _probes.Get(*foundHandle) : nullptr;
+        if (probe == nullptr)
+        {
+            return OpenIPC_Error_Invalid_Device_ID;
+        }
+        const auto handle = *foundHandle;
+        for (uint32_t interfaceSlot = 0; interfaceSlot < probe->GetInterfaceCount(); interfaceSlot++)
+        {
+            const auto interfaceDeviceId = std::visit([](const auto& anyInterface) { return anyInterface.InterfaceDeviceId; },
+                                                      probe->GetInterfaceAt(interfaceSlot));
+            if (interfaceDeviceId != OpenIPC_INVALID_DEVICE_ID)
+            {
+                _interfacesByDeviceId.Erase(interfaceDeviceId);
+            }
+        }
+        for (auto entry = _probesByEndpoint.begin(); entry != _probesByEndpoint.end(); ++entry)
+        {
+            if (entry->second == probe->ProbeRefId)
+            {
+                _probesByEndpoint.erase(entry); // Rediscovered when the endpoints next change
+                break;
+            }
+        }
+        _probesByRefId.Erase(probe->ProbeRefId);
+        _probesByDeviceId.Erase(probeDeviceId);
+        _probes.Remove(handle);
+        return OpenIPC_Error_No_Error;
+    }
+
+private:
+    void _lockInterface(OpenIPC_DeviceId interfaceDeviceId)
+    {
+        if (std::find(_lockedInterfaces.begin(), _lockedInterfaces.end(), interfaceDeviceId) == _lockedInterfaces.end())
         {
-            probeRefIds.push_back(probe.ProbeRefId);
+            _lockedInterfaces.push_back(interfaceDeviceId);
         }
-        return probeRefIds;
     }
 
-    ReferenceProbe* GetProbeByRefId(PPI_RefId probeRefId) noexcept
+    void _unlockInterface(OpenIPC_DeviceId interfaceDeviceId)
     {
-        const auto probeIter = std::find_if(_probes.begin(), _probes.end(),
-                                            [probeRefId](const ReferenceProbe& probe)
-                                            {
-                                                return probe.ProbeRefId == probeRefId;
-                                            });
-        if (probeIter == _probes.end())
+        _lockedInterfaces.erase(std::remove(_lockedInterfaces.begin(), _lockedInterfaces.end(), interfaceDeviceId), _lockedInterfaces.end());
+        if (_lockTargetInterface == interfaceDeviceId)
         {
-            return nullptr;
+            _lockTargetInterface = OpenIPC_INVALID_DEVICE_ID;
         }
-        return &*probeIter;
     }
 
-    ReferenceProbe* GetProbeByDeviceId(OpenIPC_DeviceId probeDeviceId) noexcept
+    uint32_t _getNextProbeRefId() const noexcept
     {
-        const auto probeIter = std::find_if(_probes.begin(), _probes.end(),
-                                            [probeDeviceId](const ReferenceProbe& probe)
-                                            {
-                                                return probe.ProbeDeviceId == probeDeviceId;
-                                            });
-        if (probeIter == _probes.end())
-        {
-            return nullptr;
-        }
-        return &*probeIter;
+        static uint32_t lastProbeIndex = 0;
+        const uint32_t  newProbeRefId  = _pluginId | (lastProbeIndex << 16);
+        lastProbeIndex++;
+        return newProbeRefId;
     }
 
-    ReferenceProbe* CreateProbe(const std::string_view probeType) noexcept
+    ReferenceProbe* _addFakeProbe(const std::vector<PPI_EInterfaceType>& interfaceTypes = ReferenceProbe::DefaultInterfaceTypes,
+                                  std::unique_ptr<ReceiverConnection> connection = nullptr) noexcept
     {
-        if(probeType != ReferenceProbe::PROBE_TYPE)
+        const auto [handle, probe] = _probes.Emplace(_getNextProbeRefId(), interfaceTypes, std::move(connection));
+        _probesByRefId.Insert(probe->ProbeRefId, handle);
+        return probe;
+    }
+
+    void _addFakeProbeFarm()
+    {
+        const auto probeCount = std::strtoul(Configs.TryGet("SVEPlugin.AddFakeProbes").value_or("").c_str(), nullptr, 10);
+        if (probeCount == 0)
         {
-            return nullptr;
+            return;
+        }
+        Configs.TrySet("SVEPlugin.AddFakeProbes", "0");
+        const auto interfaceTypes = _parseInterfaceTypes(Configs.TryGet("SVEPlugin.FakeProbeInterfaces").value_or(""));
+        std::unique_lock lock(_devicesMutex);
+        for (unsigned long probe = 0; probe < probeCount; probe++)
+        {
+            _addFakeProbe(interfaceTypes);
         }
-        _addFakeProbe();
-        return &_probes.back();
     }
 
-    MaybeReferenceInterfaceRef GetInterfaceByDeviceId(OpenIPC_DeviceId interfaceDeviceId) noexcept
+    // Parses a list of the c_interfaceTypeString names of the interface types fake probes can have
+    static std::vector<PPI_EInterfaceType> _parseInterfaceTypes(std::string_view typeNames)
     {
-        MaybeReferenceInterfaceRef result = std::monostate();
-        for (auto& probe : _probes)
+        std::vector<PPI_EInterfaceType> interfaceTypes;
+        while (!typeNames.empty())
         {
-            result = probe.GetInterfaceByDeviceId(interfaceDeviceId);
-            if (!std::holds_alternative<std::monostate>(result))
+            const auto separator = typeNames.find(',');
+            const auto typeName  = typeNames.substr(0, separator);
+            typeNames = separator == std::string_view::npos ? std::string_view() : typeNames.substr(separator + 1);
+            for (const auto interfaceType : { PPI_interfaceTypeJtag, PPI_interfaceTypeStatePort, PPI_interfaceTypeHtiTrace })
             {
-                return result;
+                if (typeName == c_interfaceTypeString[interfaceType])
+                {
+                    interfaceTypes.push_back(interfaceType);
+                }
             }
         }
-        return result;
+        return interfaceTypes;
     }
 
-    OpenIPC_Error RemoveProbeByDeviceId(OpenIPC_DeviceId probeDeviceId) noexcept
+    // A stale entry (its probe was removed) resolves to nullptr rather than to another probe
+    ReferenceInterface* _findInterface(OpenIPC_DeviceId interfaceDeviceId) noexcept
     {
-        const auto probeIter = std::find_if(_probes.begin(), _probes.end(),
-                                            [probeDeviceId](const ReferenceProbe& probe)
-                                            {
-                                                return probe.ProbeDeviceId == probeDeviceId;
-                                            });
-        if (probeIter == _probes.end())
-        {
-            return OpenIPC_Error_Invalid_Device_ID;
-        }
-        _probes.erase(probeIter);
-        return OpenIPC_Error_No_Error;
+        const auto* slot = _interfacesByDeviceId.Find(interfaceDeviceId);
+        auto* probe = slot ? _probes.Get(slot->Probe) : nullptr;
+        return probe ? &probe->GetInterfaceAt(slot->Interface) : nullptr;
     }
 
-private:
-    uint32_t _getNextProbeRefId() const noexcept
+};
+static std::unique_ptr<SVEPlugin> EXAMPLE_PLUGIN_INSTANCE;
+
+// Appends to a bundle, or for PPI_PROBE_LOCK_HOLD/RELEASE runs the operation right away on the locked interface.
+template <typename AppendFunction>
+OpenIPC_Error AppendOrExecute(PPI_ProbeBundleHandle handle, AppendFunction&& append)
+{
+    if (handle == PPI_PROBE_LOCK_RELEASE || handle == PPI_PROBE_LOCK_HOLD)
     {
-        static uint32_t lastProbeIndex = 0;
-        const uint32_t  newProbeRefId  = _pluginId | (lastProbeIndex << 16);
-        lastProbeIndex++;
-        return newProbeRefId;
+        assert(EXAMPLE_PLUGIN_INSTANCE != nullptr);
+        return EXAMPLE_PLUGIN_INSTANCE->ExecuteImmediate(handle == PPI_PROBE_LOCK_HOLD, std::forward<AppendFunction>(append));
     }
-
-    void _addFakeProbe() noexcept
+    if (auto* jtagBundle = RetrieveJtagBundle(handle))
     {
-        _probes.emplace_back(_getNextProbeRefId());
+        return append(*jtagBundle);
     }
-
-};
-static std::unique_ptr<SVEPlugin> EXAMPLE_PLUGIN_INSTANCE;
+    else
+    {
+        return OpenIPC_Error_Probe_Bundle_Invalid;
+    }
+}
 
 // ==== PPI Implementation ====
 OpenIPC_Error PPI_PluginGetInfo(PPI_PluginApiVersion clientInterfaceVersion, PPI_PluginInfo* info)
@@ -1315,6 +5193,7 @@ OpenIPC_Error PPI_ProbeGetRefIds(uint32_t maxIds, PPI_RefId* refIds, uint32_t* p
         maxIds = 0;
     }
 
+    EXAMPLE_PLUGIN_INSTANCE->DiscoverProbes();
     const auto probeRefIds = EXAMPLE_PLUGIN_INSTANCE->ProbeGetRefIds();
     *probeCount = static_cast<uint32_t>(probeRefIds.size());
     const uint32_t copyCount = std::min(*probeCount, maxIds);
@@ -1325,12 +5204,7 @@ OpenIPC_Error PPI_ProbeGetRefIds(uint32_t maxIds, PPI_RefId* refIds, uint32_t* p
 OpenIPC_Error PPI_ProbeBeginInitialization(PPI_RefId probe_refid, OpenIPC_DeviceId probeID)
 {
     assert(EXAMPLE_PLUGIN_INSTANCE != nullptr);
-    const auto probe = EXAMPLE_PLUGIN_INSTANCE->GetProbeByRefId(probe_refid);
-    if (!probe)
-    {
-        return OpenIPC_Error_Invalid_Device_ID;
-    }
-    return probe->BeginInitialization(probeID);
+    return EXAMPLE_PLUGIN_INSTANCE->ProbeBeginInitialization(probe_refid, probeID);
 }
 
 OpenIPC_Error PPI_ProbeFinishInitialization(OpenIPC_DeviceId probeID)
@@ -1347,13 +5221,8 @@ OpenIPC_Error PPI_ProbeFinishInitialization(OpenIPC_DeviceId probeID)
 
 OpenIPC_Error PPI_ProbeDeInitialize(OpenIPC_DeviceId probeID)
 {
-
     assert(EXAMPLE_PLUGIN_INSTANCE != nullptr);
-    const auto probe = EXAMPLE_PLUGIN_INSTANCE->GetProbeByDeviceId(probeID);
-
-    closesocket(probe->sock);
-    WSACleanup();
-    return EXAMPLE_PLUGIN_INSTANCE->RemoveProbeByDeviceId(probeID);
+    return EXAMPLE_PLUGIN_INSTANCE->ProbeDeInitialize(probeID);
 }
 
 OpenIPC_Error PPI_ProbeGetInfo(PPI_RefId refId, PPI_ProbeInfo* info)
@@ -1402,175 +5271,480 @@ OpenIPC_Error PPI_InterfaceGetType(OpenIPC_DeviceId probeID, PPI_RefId interface
     {
         return OpenIPC_Error_Invalid_Device_ID;
     }
-    auto probeInterface = probe->GetInterfaceByRefId(interface_refid);
-    return std::visit([&interface_type](auto& maybeInterface)
-                      {
-                          if constexpr (is_decay_equ<decltype(maybeInterface), std::monostate>)
-                          {
-                              return OpenIPC_Error_Invalid_Device_ID;
-                          }
-                          else
-                          {
-                              *interface_type = maybeInterface.get().GetInterfaceType();
-                              return OpenIPC_Error_No_Error;
-                          }
-                      }, probeInterface);
+    auto probeInterface = probe->GetInterfaceByRefId(interface_refid);
+    return std::visit([&interface_type](auto& maybeInterface)
+                      {
+                          if constexpr (is_decay_equ<decltype(maybeInterface), std::monostate>)
+                          {
+                              return OpenIPC_Error_Invalid_Device_ID;
+                          }
+                          else
+                          {
+                              *interface_type = maybeInterface.get().GetInterfaceType();
+                              return OpenIPC_Error_No_Error;
+                          }
+                      }, probeInterface);
+}
+
+OpenIPC_Error PPI_InterfaceGetInfoJTAG(OpenIPC_DeviceId probeID, PPI_RefId interface_refid, PPI_InterfaceJTAGCapabilities* capabilities)
+{
+    assert(EXAMPLE_PLUGIN_INSTANCE != nullptr);
+    assert(capabilities != nullptr);
+    ReferenceProbe* probe = EXAMPLE_PLUGIN_INSTANCE->GetProbeByDeviceId(probeID);
+    if (probe == nullptr)
+    {
+        return OpenIPC_Error_Invalid_Device_ID;
+    }
+    auto probeInterface = probe->GetInterfaceByRefId(interface_refid);
+    return std::visit([&capabilities](auto& maybeInterface)
+                      {
+                          // Only the ReferenceJtagInterface supports this
+                          if constexpr (is_decay_equ<decltype(maybeInterface), ReferenceJtagInterface>)
+                          {
+                              *capabilities = maybeInterface.get().GetJtagCapabilities();
+                              return OpenIPC_Error_No_Error;
+                          }
+                          else
+                          {
+                              return OpenIPC_Error_Invalid_Device_ID;
+                          }
+                      }, probeInterface);
+}
+
+OpenIPC_Error PPI_InterfaceBeginInitialization(OpenIPC_DeviceId probeID, PPI_RefId interface_refid, OpenIPC_DeviceId interfaceID)
+{
+    assert(EXAMPLE_PLUGIN_INSTANCE != nullptr);
+    return EXAMPLE_PLUGIN_INSTANCE->InterfaceBeginInitialization(probeID, interface_refid, interfaceID);
+}
+
+OpenIPC_Error PPI_InterfaceFinishInitialization(OpenIPC_DeviceId interfaceID)
+{
+    assert(EXAMPLE_PLUGIN_INSTANCE != nullptr);
+    auto probeInterface = EXAMPLE_PLUGIN_INSTANCE->GetInterfaceByDeviceId(interfaceID);
+    return std::visit([](auto& maybeInterface)
+                      {
+                          if constexpr (is_decay_equ<decltype(maybeInterface), std::monostate>)
+                          {
+                              return OpenIPC_Error_Invalid_Device_ID;
+                          }
+                          else
+                          {
+                              return maybeInterface.get().FinishInitialization();
+                          }
+                      }, probeInterface);
+}
+
+OpenIPC_Error PPI_InterfaceDeInitialize(OpenIPC_DeviceId interfaceID)
+{
+    assert(EXAMPLE_PLUGIN_INSTANCE != nullptr);
+    return EXAMPLE_PLUGIN_INSTANCE->InterfaceDeInitialize(interfaceID);
+}
+
+PPI_ProbeBundleHandle PPI_Bundle_Allocate()
+{
+    return new ReferenceBundle();
+}
+
+OpenIPC_Error PPI_Bundle_Clear(PPI_ProbeBundleHandle handle)
+{
+    if (handle == PPI_PROBE_LOCK_RELEASE || handle == PPI_PROBE_LOCK_HOLD)
+    {
+        return OpenIPC_Error_No_Error;
+    }
+    auto& bundle = *RetrieveBundle(handle);
+    if (auto* jtagBundle = std::get_if<ReferenceJtagBundle>(&bundle))
+    {
+        jtagBundle->Clear(); // Slots must survive a clear
+        return OpenIPC_Error_No_Error;
+    }
+    // If the bundle is not an empty bundle, the destructor will handle the clear.
+    bundle = std::monostate();
+
+    return OpenIPC_Error_No_Error;
+}
+
+OpenIPC_Error PPI_Bundle_Execute(PPI_ProbeBundleHandle handle, OpenIPC_DeviceId deviceInterface, PPI_bool keepLock)
+{
+    assert(EXAMPLE_PLUGIN_INSTANCE != nullptr);
+    auto probeInterface = EXAMPLE_PLUGIN_INSTANCE->GetInterfaceByDeviceId(deviceInterface);
+    auto* jtagInterface = std::get_if<std::reference_wrapper<ReferenceJtagInterface>>(&probeInterface);
+    // handle could be PPI_PROBE_LOCK_RELEASE or PPI_PROBE_LOCK_HOLD or ReferenceBundle*
+    if (handle == PPI_PROBE_LOCK_RELEASE || handle == PPI_PROBE_LOCK_HOLD)
+    {
+        // Executing a lock handle only keeps or releases the lock
+        if (std::holds_alternative<std::monostate>(probeInterface))
+        {
+            return OpenIPC_Error_Invalid_Device_ID;
+        }
+        if (handle == PPI_PROBE_LOCK_HOLD)
+        {
+            EXAMPLE_PLUGIN_INSTANCE->LockInterface(deviceInterface);
+            return OpenIPC_Error_No_Error;
+        }
+        EXAMPLE_PLUGIN_INSTANCE->UnlockInterface(deviceInterface);
+        return jtagInterface ? jtagInterface->get().FlushPendingOperations() : OpenIPC_Error_No_Error;
+    }
+    const auto bundle = RetrieveBundle(handle);
+
+    if (keepLock)
+    {
+        EXAMPLE_PLUGIN_INSTANCE->LockInterface(deviceInterface);
+    }
+    else
+    {
+        EXAMPLE_PLUGIN_INSTANCE->UnlockInterface(deviceInterface);
+        if (jtagInterface && std::holds_alternative<std::monostate>(*bundle))
+        {
+            return jtagInterface->get().FlushPendingOperations();
+        }
+    }
+    return std::visit([keepLock](auto& maybeInterface, auto& maybeBundle)
+                      {
+                          if constexpr (is_decay_equ<decltype(maybeInterface), ReferenceJtagInterface>
+                                        && is_decay_equ<decltype(maybeBundle), ReferenceJtagBundle>)
+                          {
+                              return maybeInterface.get().ExecuteBundle(maybeBundle, keepLock != 0);
+                          }
+                          else if constexpr (is_decay_equ<decltype(maybeInterface), ReferenceStatePortInterface>
+                                             && is_decay_equ<decltype(maybeBundle), ReferenceStatePortBundle>)
+                          {
+                              return maybeInterface.get().ExecuteBundle(maybeBundle);
+                          }
+                          else if (is_decay_equ<decltype(maybeBundle), std::monostate>)
+                          {
+                              return OpenIPC_Error_No_Error; // Empty bundle, just say it worked.
+                          }
+                          else
+                          {
+                              return OpenIPC_Error_Invalid_Device_ID;
+                          }
+                      }, probeInterface, *bundle);
+}
+
+OpenIPC_Error PPI_Bundle_Free(PPI_ProbeBundleHandle* handle)
+{
+    assert(handle != nullptr);
+    if (*handle != PPI_PROBE_LOCK_HOLD)
+    {
+        const auto bundle = RetrieveBundle(*handle);
+        delete bundle;
+    }
+    *handle = PPI_PROBE_LOCK_RELEASE;
+    return OpenIPC_Error_No_Error;
+}
+
+OpenIPC_Error PPI_Lock_Target_Interface(OpenIPC_DeviceId deviceInterface)
+{
+    assert(EXAMPLE_PLUGIN_INSTANCE != nullptr);
+    const auto probeInterface = EXAMPLE_PLUGIN_INSTANCE->GetInterfaceByDeviceId(deviceInterface);
+    if (std::holds_alternative<std::monostate>(probeInterface))
+    {
+        return OpenIPC_Error_Invalid_Device_ID;
+    }
+    EXAMPLE_PLUGIN_INSTANCE->SetLockTargetInterface(deviceInterface);
+    return OpenIPC_Error_No_Error;
+}
+
+OpenIPC_Error PPI_List_Locked_Interfaces(uint32_t maxNumberOfInterfaces, OpenIPC_DeviceId* interfaces, uint32_t* numberOfInterfaces)
+{
+    assert(EXAMPLE_PLUGIN_INSTANCE != nullptr);
+    assert(numberOfInterfaces != nullptr);
+    assert(interfaces != nullptr || maxNumberOfInterfaces == 0);
+    // No interface has lock peers, so the locked set is already closed under the peer relation
+    const auto& lockedInterfaces = EXAMPLE_PLUGIN_INSTANCE->GetLockedInterfaces();
+    *numberOfInterfaces = static_cast<uint32_t>(lockedInterfaces.size());
+    std::copy_n(lockedInterfaces.begin(), std::min<size_t>(maxNumberOfInterfaces, lockedInterfaces.size()), interfaces);
+    return OpenIPC_Error_No_Error;
+}
+
+// Support for STATE based JTAG
+OpenIPC_Error PPI_JTAG_GoToState(PPI_ProbeBundleHandle handle, JtagStateEncode gotoState, uint32_t numberOfClocksInState, const PPI_JTAG_StateGotoOptions* const options)
+{
+    const bool waitForTrigger = options && options->waitForTrigger;
+    const bool errorOnTimeout = options && options->errorOnTimeout;
+
+    return AppendOrExecute(handle, [&](ReferenceJtagBundle& jtagBundle)
+                           {
+                               return jtagBundle.AppendJtagGoToState(gotoState, numberOfClocksInState, waitForTrigger, errorOnTimeout);
+                           });
+}
+
+namespace
+{
+    // Resolves the slot related TDI/TDO options of a shift into the slots the operation restores from and saves to.
+    OpenIPC_Error ResolveShiftSlots(uint32_t shiftLengthBits, PPI_JTAG_TDI_TDO_OPTIONS_ET tdiTdoOptions, PPI_SlotHandle savedSlot,
+                                    ReferenceSlot*& restoreTdiFromSlot, ReferenceSlot*& saveTdoToSlot)
+    {
+        restoreTdiFromSlot = nullptr;
+        saveTdoToSlot      = nullptr;
+        const bool usesSlot = tdiTdoOptions & (JtagOption_TDI_Restore_From_Slot | JtagOption_TDO_Save_To_Slot);
+        if (!usesSlot)
+        {
+            return OpenIPC_Error_No_Error;
+        }
+        if (savedSlot == PPI_SLOT_HANDLE_INVALID)
+        {
+            return OpenIPC_Error_Probe_Bundle_Invalid_Slot;
+        }
+        auto* slot = ReferenceSlot::FromOpaqueHandle(savedSlot);
+        if (slot->BitCount != shiftLengthBits)
+        {
+            return OpenIPC_Error_Probe_Bundle_Invalid_Slot;
+        }
+        if (tdiTdoOptions & JtagOption_TDI_Restore_From_Slot)
+        {
+            restoreTdiFromSlot = slot;
+        }
+        if (tdiTdoOptions & JtagOption_TDO_Save_To_Slot)
+        {
+            saveTdoToSlot = slot;
+        }
+        return OpenIPC_Error_No_Error;
+    }
+
+    std::vector<uint8_t> CopyTdi(uint32_t shiftLengthBits, const uint8_t* const inBits, PPI_JTAG_TDI_TDO_OPTIONS_ET tdiTdoOptions, const ReferenceSlot* restoreTdiFromSlot)
+    {
+        if (restoreTdiFromSlot)
+        {
+            return {}; // TDI comes from the slot when the bundle is executed
+        }
+        if (inBits == nullptr)
+        {
+            const bool useAllOnes = tdiTdoOptions & JtagOption_TDI_All_Ones;
+            return std::vector((shiftLengthBits + 7) / 8, useAllOnes ? static_cast<uint8_t>(0xFF) : static_cast<uint8_t>(0));
+        }
+        // Need to copy inBits, since it's lifetime is not guaranteed beyond this method.
+        // However outBits which is guaranteed to live until either bundle_clear or bundle_execute (if it is provided)
+        return std::vector(inBits, inBits + (shiftLengthBits + 7) / 8);
+    }
+
+    // Like CopyTdi, but only references inBits when the host guarantees (SVEPlugin.BorrowTdiBuffers) that it lives
+    // until bundle_clear or bundle_execute, the same lifetime outBits already has.
+    // A null inBits is kept as its fill value instead of a buffer of 0's or 1's.
+    ReferenceBundleJtagOperations::ScanTdi TakeTdi(uint32_t shiftLengthBits, const uint8_t* const inBits, PPI_JTAG_TDI_TDO_OPTIONS_ET tdiTdoOptions, const ReferenceSlot* restoreTdiFromSlot)
+    {
+        if (inBits == nullptr && restoreTdiFromSlot == nullptr)
+        {
+            return ReferenceBundleJtagOperations::ScanTdi::Fill(tdiTdoOptions & JtagOption_TDI_All_Ones);
+        }
+        if (inBits != nullptr && restoreTdiFromSlot == nullptr && EXAMPLE_PLUGIN_INSTANCE != nullptr && EXAMPLE_PLUGIN_INSTANCE->Configs.IsTrue("SVEPlugin.BorrowTdiBuffers"))
+        {
+            return ReferenceBundleJtagOperations::ScanTdi::Borrow(inBits);
+        }
+        return ReferenceBundleJtagOperations::ScanTdi(CopyTdi(shiftLengthBits, inBits, tdiTdoOptions, restoreTdiFromSlot));
+    }
+
+    // Spreads the 8 bits of a byte into the even bits of a 16 bit value.
+    uint16_t SpreadBits(uint8_t byte)
+    {
+        uint16_t value = byte;
+        value = (value | static_cast<uint16_t>(value << 4)) & 0x0F0F;
+        value = (value | static_cast<uint16_t>(value << 2)) & 0x3333;
+        value = (value | static_cast<uint16_t>(value << 1)) & 0x5555;
+        return value;
+    }
+
+    // Interleaves TDI and TMS a byte at a time, TDI in the even bits and TMS in the odd bits.
+    // An empty tdi (TDI restored from a slot at execution) leaves the TDI bits 0.
+    std::vector<uint8_t> InterleavePins(uint32_t shiftLengthBits, const std::vector<uint8_t>& tdi, const uint8_t* const tms)
+    {
+        const size_t byteCount = (shiftLengthBits + 7) / 8;
+        std::vector<uint8_t> pins(2 * byteCount);
+        for (size_t i = 0; i < byteCount; i++)
+        {
+            const uint16_t tdiBits = tdi.empty() ? 0 : SpreadBits(tdi[i]);
+            const uint16_t pair    = static_cast<uint16_t>(tdiBits | (SpreadBits(tms[i]) << 1));
+            pins[2 * i]     = static_cast<uint8_t>(pair);
+            pins[2 * i + 1] = static_cast<uint8_t>(pair >> 8);
+        }
+        return pins;
+    }
+
+    // A null mask or match buffer of a slot operation is expanded to a buffer of all 0's or all 1's.
+    std::vector<uint8_t> CopySlotBuffer(uint32_t numberOfBits, const uint8_t* const buffer, bool defaultToOnes)
+    {
+        if (buffer == nullptr)
+        {
+            return std::vector((numberOfBits + 7) / 8, defaultToOnes ? static_cast<uint8_t>(0xFF) : static_cast<uint8_t>(0));
+        }
+        return std::vector(buffer, buffer + (numberOfBits + 7) / 8);
+    }
 }
 
-OpenIPC_Error PPI_InterfaceGetInfoJTAG(OpenIPC_DeviceId probeID, PPI_RefId interface_refid, PPI_InterfaceJTAGCapabilities* capabilities)
+OpenIPC_Error PPI_JTAG_StateIRShift(PPI_ProbeBundleHandle handle, uint32_t shiftLengthBits, const uint8_t* const inBits, uint8_t* outBits, const PPI_JTAG_StateShiftOptions* const options)
 {
-    assert(EXAMPLE_PLUGIN_INSTANCE != nullptr);
-    assert(capabilities != nullptr);
-    ReferenceProbe* probe = EXAMPLE_PLUGIN_INSTANCE->GetProbeByDeviceId(probeID);
-    if (probe == nullptr)
+    const PPI_JTAG_TDI_TDO_OPTIONS_ET tdiTdoOptions = options ? options->TdiTdoOptions : static_cast<PPI_JTAG_TDI_TDO_OPTIONS_ET>(JtagOption_TDI_Default);
+    ReferenceSlot* restoreTdiFromSlot;
+    ReferenceSlot* saveTdoToSlot;
+    if (const auto error = ResolveShiftSlots(shiftLengthBits, tdiTdoOptions, options ? options->savedSlot : PPI_SLOT_HANDLE_INVALID, restoreTdiFromSlot, saveTdoToSlot))
     {
-        return OpenIPC_Error_Invalid_Device_ID;
+        return error;
     }
-    auto probeInterface = probe->GetInterfaceByRefId(interface_refid);
-    return std::visit([&capabilities](auto& maybeInterface)
-                      {
-                          // Only the ReferenceJtagInterface supports this
-                          if constexpr (is_decay_equ<decltype(maybeInterface), ReferenceJtagInterface>)
-                          {
-                              *capabilities = maybeInterface.get().GetJtagCapabilities();
-                              return OpenIPC_Error_No_Error;
-                          }
-                          else
-                          {
-                              return OpenIPC_Error_Invalid_Device_ID;
-                          }
-                      }, probeInterface);
+    auto inData = TakeTdi(shiftLengthBits, inBits, tdiTdoOptions, restoreTdiFromSlot);
+    return AppendOrExecute(handle, [&](ReferenceJtagBundle& jtagBundle)
+                           {
+                               return jtagBundle.AppendIrScan(shiftLengthBits, std::move(inData), outBits, restoreTdiFromSlot, saveTdoToSlot);
+                           });
 }
 
-OpenIPC_Error PPI_InterfaceBeginInitialization(OpenIPC_DeviceId probeID, PPI_RefId interface_refid, OpenIPC_DeviceId interfaceID)
+OpenIPC_Error PPI_JTAG_StateDRShift(PPI_ProbeBundleHandle handle, uint32_t shiftLengthBits, const uint8_t* const inBits, uint8_t* outBits, const PPI_JTAG_StateShiftOptions* const options)
 {
-    assert(EXAMPLE_PLUGIN_INSTANCE != nullptr);
-    ReferenceProbe* probe = EXAMPLE_PLUGIN_INSTANCE->GetProbeByDeviceId(probeID);
-    if (probe == nullptr)
+    const PPI_JTAG_TDI_TDO_OPTIONS_ET tdiTdoOptions = options ? options->TdiTdoOptions : static_cast<PPI_JTAG_TDI_TDO_OPTIONS_ET>(JtagOption_TDI_Default);
+    ReferenceSlot* restoreTdiFromSlot;
+    ReferenceSlot* saveTdoToSlot;
+    if (const auto error = ResolveShiftSlots(shiftLengthBits, tdiTdoOptions, options ? options->savedSlot : PPI_SLOT_HANDLE_INVALID, restoreTdiFromSlot, saveTdoToSlot))
     {
-        return OpenIPC_Error_Invalid_Device_ID;
+        return error;
     }
-
-    auto probeInterface = probe->GetInterfaceByRefId(interface_refid);
-    return std::visit([interfaceID](auto& maybeInterface)
-                      {
-                          if constexpr (is_decay_equ<decltype(maybeInterface), std::monostate>)
-                          {
-                              return OpenIPC_Error_Invalid_Device_ID;
-                          }
-                          else
-                          {
-                              return maybeInterface.get().BeginInitialization(interfaceID);
-                          }
-                      }, probeInterface);
+    auto inData = TakeTdi(shiftLengthBits, inBits, tdiTdoOptions, restoreTdiFromSlot);
+    return AppendOrExecute(handle, [&](ReferenceJtagBundle& jtagBundle)
+                           {
+                               return jtagBundle.AppendDrScan(shiftLengthBits, std::move(inData), outBits, restoreTdiFromSlot, saveTdoToSlot);
+                           });
 }
 
-OpenIPC_Error PPI_InterfaceFinishInitialization(OpenIPC_DeviceId interfaceID)
+// Support for REGISTER based JTAG
+OpenIPC_Error PPI_JTAG_RegisterShiftCapabilities(OpenIPC_DeviceId jtagInterface, PPI_bool* supportPauseStates)
 {
     assert(EXAMPLE_PLUGIN_INSTANCE != nullptr);
-    auto probeInterface = EXAMPLE_PLUGIN_INSTANCE->GetInterfaceByDeviceId(interfaceID);
-    return std::visit([](auto& maybeInterface)
+    auto probeInterface = EXAMPLE_PLUGIN_INSTANCE->GetInterfaceByDeviceId(jtagInterface);
+    return std::visit([supportPauseStates](auto& maybeInterface)
                       {
-                          if constexpr (is_decay_equ<decltype(maybeInterface), std::monostate>)
+                          if constexpr (is_decay_equ<decltype(maybeInterface), ReferenceJtagInterface>)
                           {
-                              return OpenIPC_Error_Invalid_Device_ID;
+                              if (supportPauseStates)
+                              {
+                                  *supportPauseStates = maybeInterface.get().SupportsPauseInRegisterInterface() ? 1 : 0;
+                              }
+                              return OpenIPC_Error_No_Error;
                           }
                           else
                           {
-                              return maybeInterface.get().FinishInitialization();
+                              return OpenIPC_Error_Probe_Invalid_JTAG_Device;
                           }
                       }, probeInterface);
 }
 
-OpenIPC_Error PPI_InterfaceDeInitialize(OpenIPC_DeviceId interfaceID)
+namespace
 {
-    assert(EXAMPLE_PLUGIN_INSTANCE != nullptr);
-    auto probeInterface = EXAMPLE_PLUGIN_INSTANCE->GetInterfaceByDeviceId(interfaceID);
-    return std::visit([](auto& maybeInterface)
-                      {
-                          if constexpr (is_decay_equ<decltype(maybeInterface), std::monostate>)
-                          {
-                              return OpenIPC_Error_Invalid_Device_ID;
-                          }
-                          else
-                          {
-                              return maybeInterface.get().DeInitialization();
-                          }
-                      }, probeInterface);
+    OpenIPC_Error AppendRegisterShift(PPI_ProbeBundleHandle handle, bool isIrScan, uint32_t shiftLengthBits, const uint8_t* const inBits, uint8_t* outBits, const PPI_JTAG_RegisterOptions* const options)
+    {
+        const PPI_JTAG_TDI_TDO_OPTIONS_ET tdiTdoOptions = options ? options->tdiTdoOptions : static_cast<PPI_JTAG_TDI_TDO_OPTIONS_ET>(JtagOption_TDI_Default);
+        const bool stopInPause = options && options->stopInPauseNotRunTestIdle;
+        ReferenceSlot* restoreTdiFromSlot;
+        ReferenceSlot* saveTdoToSlot;
+        if (const auto error = ResolveShiftSlots(shiftLengthBits, tdiTdoOptions, options ? options->savedSlot : PPI_SLOT_HANDLE_INVALID, restoreTdiFromSlot, saveTdoToSlot))
+        {
+            return error;
+        }
+        auto inData = TakeTdi(shiftLengthBits, inBits, tdiTdoOptions, restoreTdiFromSlot);
+        return AppendOrExecute(handle, [&](ReferenceJtagBundle& jtagBundle)
+                               {
+                                   return jtagBundle.AppendRegisterScan(isIrScan, stopInPause, shiftLengthBits, std::move(inData), outBits, restoreTdiFromSlot, saveTdoToSlot);
+                               });
+    }
 }
 
-PPI_ProbeBundleHandle PPI_Bundle_Allocate()
+OpenIPC_Error PPI_JTAG_IRRegisterShift(PPI_ProbeBundleHandle handle, uint32_t shiftLengthBits, const uint8_t* const inBits, uint8_t* outBits, const PPI_JTAG_RegisterOptions* const options)
 {
-    return new ReferenceBundle();
+    return AppendRegisterShift(handle, true, shiftLengthBits, inBits, outBits, options);
 }
 
-OpenIPC_Error PPI_Bundle_Clear(PPI_ProbeBundleHandle handle)
+OpenIPC_Error PPI_JTAG_DRRegisterShift(PPI_ProbeBundleHandle handle, uint32_t shiftLengthBits, const uint8_t* const inBits, uint8_t* outBits, const PPI_JTAG_RegisterOptions* const options)
 {
-    assert(handle != nullptr);
-    auto& bundle = *RetrieveBundle(handle);
-    // If the bundle is not an empty bundle, the destructor will handle the clear.
-    bundle = std::monostate();
+    return AppendRegisterShift(handle, false, shiftLengthBits, inBits, outBits, options);
+}
 
+// Support for JTAG padding
+OpenIPC_Error PPI_JTAG_GetInterfacePadding(OpenIPC_DeviceId device, uint32_t* irPaddingNearTDI, uint32_t* irPaddingNearTDO, uint32_t* drPaddingNearTDI, uint32_t* drPaddingNearTDO, PPI_bool* drValueConstantOne)
+{
+    assert(EXAMPLE_PLUGIN_INSTANCE != nullptr);
+    const auto probeInterface = EXAMPLE_PLUGIN_INSTANCE->GetInterfaceByDeviceId(device);
+    const auto* jtagInterface = std::get_if<std::reference_wrapper<ReferenceJtagInterface>>(&probeInterface);
+    if (jtagInterface == nullptr)
+    {
+        return OpenIPC_Error_Probe_Invalid_JTAG_Device;
+    }
+    const auto& padding = jtagInterface->get().GetPadding();
+    if (irPaddingNearTDI)
+    {
+        *irPaddingNearTDI = padding.IrPaddingNearTdi;
+    }
+    if (irPaddingNearTDO)
+    {
+        *irPaddingNearTDO = padding.IrPaddingNearTdo;
+    }
+    if (drPaddingNearTDI)
+    {
+        *drPaddingNearTDI = padding.DrPaddingNearTdi;
+    }
+    if (drPaddingNearTDO)
+    {
+        *drPaddingNearTDO = padding.DrPaddingNearTdo;
+    }
+    if (drValueConstantOne)
+    {
+        *drValueConstantOne = padding.DrValueConstantOne ? 1 : 0;
+    }
     return OpenIPC_Error_No_Error;
 }
 
-OpenIPC_Error PPI_Bundle_Execute(PPI_ProbeBundleHandle handle, OpenIPC_DeviceId deviceInterface, PPI_bool keepLock)
+OpenIPC_Error PPI_JTAG_SetInterfacePadding(OpenIPC_DeviceId device, uint32_t irPaddingNearTDI, uint32_t irPaddingNearTDO, uint32_t drPaddingNearTDI, uint32_t drPaddingNearTDO, PPI_bool drValueConstantOne)
 {
-    (void)keepLock; // don't care about keepLock since the probe has no sharing considerations.
-    // handle could be PPI_PROBE_LOCK_RELEASE or PPI_PROBE_LOCK_HOLD or ReferenceBundle*
-    if (handle == PPI_PROBE_LOCK_RELEASE || handle == PPI_PROBE_LOCK_HOLD)
+    assert(EXAMPLE_PLUGIN_INSTANCE != nullptr);
+    const auto probeInterface = EXAMPLE_PLUGIN_INSTANCE->GetInterfaceByDeviceId(device);
+    const auto* jtagInterface = std::get_if<std::reference_wrapper<ReferenceJtagInterface>>(&probeInterface);
+    if (jtagInterface == nullptr)
     {
-        return OpenIPC_Error_Operation_Not_Supported;
+        return OpenIPC_Error_Probe_Invalid_JTAG_Device;
     }
-    const auto bundle = RetrieveBundle(handle);
-
-    auto probeInterface = EXAMPLE_PLUGIN_INSTANCE->GetInterfaceByDeviceId(deviceInterface);
-    return std::visit([](auto& maybeInterface, auto& maybeBundle)
-                      {
-                          if constexpr (is_decay_equ<decltype(maybeInterface), ReferenceJtagInterface>
-                                        && is_decay_equ<decltype(maybeBundle), ReferenceJtagBundle>)
-                          {
-                              return maybeInterface.get().ExecuteBundle(maybeBundle);
-                          }
-                          else if constexpr (is_decay_equ<decltype(maybeInterface), ReferenceStatePortInterface>
-                                             && is_decay_equ<decltype(maybeBundle), ReferenceStatePortBundle>)
-                          {
-                              return maybeInterface.get().ExecuteBundle(maybeBundle);
-                          }
-                          else if (is_decay_equ<decltype(maybeBundle), std::monostate>)
-                          {
-                              return OpenIPC_Error_No_Error; // Empty bundle, just say it worked.
-                          }
-                          else
-                          {
-                              return OpenIPC_Error_Invalid_Device_ID;
-                          }
-                      }, probeInterface, *bundle);
+    return jtagInterface->get().SetPadding(JtagPadding{ irPaddingNearTDI, irPaddingNearTDO, drPaddingNearTDI, drPaddingNearTDO, drValueConstantOne != 0 });
 }
 
-OpenIPC_Error PPI_Bundle_Free(PPI_ProbeBundleHandle* handle)
+OpenIPC_Error PPI_JTAG_GetCurrentBundlePadding(PPI_ProbeBundleHandle bundle, int32_t* irPaddingNearTDI, int32_t* irPaddingNearTDO, int32_t* drPaddingNearTDI, int32_t* drPaddingNearTDO, PPI_bool* drValueConstantOne)
 {
-    assert(handle != nullptr);
-    const auto bundle = RetrieveBundle(*handle);
-    delete bundle;
+    if (bundle == PPI_PROBE_LOCK_RELEASE || bundle == PPI_PROBE_LOCK_HOLD)
+    {
+        return OpenIPC_Error_Probe_Bundle_Invalid;
+    }
+    const auto* jtagBundle = RetrieveJtagBundle(bundle);
+    if (jtagBundle == nullptr)
+    {
+        return OpenIPC_Error_Probe_Bundle_Invalid;
+    }
+    const auto& padding = jtagBundle->GetPadding();
+    if (irPaddingNearTDI)
+    {
+        *irPaddingNearTDI = padding.IrPaddingNearTdi;
+    }
+    if (irPaddingNearTDO)
+    {
+        *irPaddingNearTDO = padding.IrPaddingNearTdo;
+    }
+    if (drPaddingNearTDI)
+    {
+        *drPaddingNearTDI = padding.DrPaddingNearTdi;
+    }
+    if (drPaddingNearTDO)
+    {
+        *drPaddingNearTDO = padding.DrPaddingNearTdo;
+    }
+    if (drValueConstantOne)
+    {
+        *drValueConstantOne = padding.DrValueConstantOne ? 1 : 0;
+    }
     return OpenIPC_Error_No_Error;
 }
 
-// Support for STATE based JTAG
-OpenIPC_Error PPI_JTAG_GoToState(PPI_ProbeBundleHandle handle, JtagStateEncode gotoState, uint32_t numberOfClocksInState, const PPI_JTAG_StateGotoOptions* const options)
+OpenIPC_Error PPI_JTAG_UpdateBundlePadding(PPI_ProbeBundleHandle bundle, int32_t irPaddingNearTDI, int32_t irPaddingNearTDO, int32_t drPaddingNearTDI, int32_t drPaddingNearTDO, PPI_bool drValueConstantOne)
 {
-    assert(handle != nullptr);
-    const bool waitForTrigger = options && options->waitForTrigger;
-    const bool errorOnTimeout = options && options->errorOnTimeout;
-
-    const auto bundle = RetrieveBundle(handle);
-    if (std::holds_alternative<std::monostate>(*bundle))
+    if (bundle == PPI_PROBE_LOCK_RELEASE || bundle == PPI_PROBE_LOCK_HOLD)
     {
-        *bundle = ReferenceJtagBundle{}; // Empty bundle can become a Jtag bundle
+        return OpenIPC_Error_Probe_Bundle_Invalid;
     }
-    if (auto* jtagBundle = std::get_if<ReferenceJtagBundle>(bundle))
+    if (auto* jtagBundle = RetrieveJtagBundle(bundle))
     {
-        return jtagBundle->AppendJtagGoToState(gotoState, numberOfClocksInState, waitForTrigger, errorOnTimeout);
+        return jtagBundle->AppendUpdatePadding(JtagPaddingDelta{ irPaddingNearTDI, irPaddingNearTDO, drPaddingNearTDI, drPaddingNearTDO, drValueConstantOne != 0 });
     }
     else
     {
@@ -1578,82 +5752,148 @@ OpenIPC_Error PPI_JTAG_GoToState(PPI_ProbeBundleHandle handle, JtagStateEncode g
     }
 }
 
-OpenIPC_Error PPI_JTAG_StateIRShift(PPI_ProbeBundleHandle handle, uint32_t shiftLengthBits, const uint8_t* const inBits, uint8_t* outBits, const PPI_JTAG_StateShiftOptions* const options)
+// Support for PINS based JTAG
+OpenIPC_Error PPI_JTAG_PinsShift(PPI_ProbeBundleHandle handle, uint32_t shiftLengthBits, const uint8_t* const tdi, const uint8_t* const tms, uint8_t* tdo, const PPI_JTAG_PinsOptions* const options)
 {
-    assert(handle != nullptr);
-    if (options)
+    const PPI_JTAG_TDI_TDO_OPTIONS_ET tdiTdoOptions = options ? options->tdiTdoOptions : static_cast<PPI_JTAG_TDI_TDO_OPTIONS_ET>(JtagOption_TDI_Default);
+    const PPI_JTAG_TMS_OPTIONS_ET tmsOptions        = options ? options->tmsOptions : static_cast<PPI_JTAG_TMS_OPTIONS_ET>(JtagOption_TMS_Default);
+    ReferenceSlot* restoreTdiFromSlot;
+    ReferenceSlot* saveTdoToSlot;
+    if (const auto error = ResolveShiftSlots(shiftLengthBits, tdiTdoOptions, options ? options->savedSlot : PPI_SLOT_HANDLE_INVALID, restoreTdiFromSlot, saveTdoToSlot))
     {
-        if (options->savedSlot != PPI_SLOT_HANDLE_INVALID
-            || options->TdiTdoOptions & JtagOption_TDI_Restore_From_Slot
-            || options->TdiTdoOptions & JtagOption_TDO_Save_To_Slot)
-        {
-            return OpenIPC_Error_Operation_Not_Supported; // We are not supporting slots
-        }
+        return error;
     }
-    std::vector<uint8_t> inData;
-    if (inBits == nullptr)
+    auto pins = CopyTdi(shiftLengthBits, tdi, tdiTdoOptions, restoreTdiFromSlot);
+    if (tms)
     {
-        const bool useAllOnes = options && options->TdiTdoOptions & JtagOption_TDI_All_Ones;
-        inData = std::vector((shiftLengthBits + 7) / 8, useAllOnes ? static_cast<uint8_t>(0xFF) : static_cast<uint8_t>(0));
+        pins = InterleavePins(shiftLengthBits, pins, tms);
     }
-    else
+    return AppendOrExecute(handle, [&](ReferenceJtagBundle& jtagBundle)
+                           {
+                               return jtagBundle.AppendPinsScan(shiftLengthBits, std::move(pins), tms != nullptr, tmsOptions, tdo, restoreTdiFromSlot, saveTdoToSlot);
+                           });
+}
+
+// ==== Slots ====
+PPI_SlotHandle PPI_Slot_Allocate(PPI_ProbeBundleHandle handle, uint64_t bitSize)
+{
+    if (handle == PPI_PROBE_LOCK_RELEASE || handle == PPI_PROBE_LOCK_HOLD || bitSize > std::numeric_limits<uint32_t>::max())
     {
-        // Need to copy inBits, since it's lifetime is not guaranteed beyond this method.
-        // However outBits which is guaranteed to live until either bundle_clear or bundle_execute (if it is provided)
-        inData = std::vector(inBits, inBits + (shiftLengthBits + 7) / 8);
+        return PPI_SLOT_HANDLE_INVALID;
     }
-    const auto bundle = RetrieveBundle(handle);
-    if (std::holds_alternative<std::monostate>(*bundle))
+    if (auto* jtagBundle = RetrieveJtagBundle(handle))
     {
-        *bundle = ReferenceJtagBundle{}; // Empty bundle can become a Jtag bundle
+        return jtagBundle->AllocateSlot(static_cast<uint32_t>(bitSize))->ToOpaqueHandle();
     }
-    if (auto* jtagBundle = std::get_if<ReferenceJtagBundle>(bundle))
+    return PPI_SLOT_HANDLE_INVALID;
+}
+
+OpenIPC_Error PPI_Slot_Free(PPI_SlotHandle* handle)
+{
+    assert(handle != nullptr);
+    if (*handle == PPI_SLOT_HANDLE_INVALID)
     {
-        return jtagBundle->AppendIrScan(shiftLengthBits, std::move(inData), outBits);
+        return OpenIPC_Error_Probe_Bundle_Invalid_Slot;
     }
-    else
+    // Past this, the slot is only kept alive by the loops that use it
+    if (!SLOT_REGISTRY.Free(ReferenceSlot::FromOpaqueHandle(*handle)))
     {
-        return OpenIPC_Error_Probe_Bundle_Invalid;
+        return OpenIPC_Error_Probe_Bundle_Invalid_Slot;
     }
+    *handle = PPI_SLOT_HANDLE_INVALID;
+    return OpenIPC_Error_No_Error;
 }
 
-OpenIPC_Error PPI_JTAG_StateDRShift(PPI_ProbeBundleHandle handle, uint32_t shiftLengthBits, const uint8_t* const inBits, uint8_t* outBits, const PPI_JTAG_StateShiftOptions* const options)
+OpenIPC_Error PPI_Slot_Size(PPI_SlotHandle handle, uint32_t* bitSize)
 {
-    assert(handle != nullptr);
-    if (options)
+    assert(bitSize != nullptr);
+    if (handle == PPI_SLOT_HANDLE_INVALID)
     {
-        if (options->savedSlot != PPI_SLOT_HANDLE_INVALID
-            || options->TdiTdoOptions & JtagOption_TDI_Restore_From_Slot
-            || options->TdiTdoOptions & JtagOption_TDO_Save_To_Slot)
-        {
-            return OpenIPC_Error_Operation_Not_Supported; // We are not supporting slots
-        }
+        return OpenIPC_Error_Probe_Bundle_Invalid_Slot;
+    }
+    *bitSize = ReferenceSlot::FromOpaqueHandle(handle)->BitCount;
+    return OpenIPC_Error_No_Error;
+}
+
+OpenIPC_Error PPI_Slot_Modification(PPI_ProbeBundleHandle handle, PPI_SlotHandle savedSlot, uint32_t numberOfBits, const uint8_t* const mask, const uint8_t* const valueToOrIn, PPI_Slot_ModificationOptions* options)
+{
+    (void)options; // Not used by this version of PPI
+    if (savedSlot == PPI_SLOT_HANDLE_INVALID)
+    {
+        return OpenIPC_Error_Probe_Bundle_Invalid_Slot;
     }
-    std::vector<uint8_t> inData;
-    if (inBits == nullptr)
+    auto* slot = ReferenceSlot::FromOpaqueHandle(savedSlot);
+    if (slot->BitCount != numberOfBits)
     {
-        const bool useAllOnes = options && options->TdiTdoOptions & JtagOption_TDI_All_Ones;
-        inData = std::vector((shiftLengthBits + 7) / 8, useAllOnes ? static_cast<uint8_t>(0xFF) : static_cast<uint8_t>(0));
+        return OpenIPC_Error_Probe_Bundle_Invalid_Slot;
     }
-    else
+    return AppendOrExecute(handle, [&](ReferenceJtagBundle& jtagBundle)
+                           {
+                               return jtagBundle.AppendSlotModification(slot, CopySlotBuffer(numberOfBits, mask, false), CopySlotBuffer(numberOfBits, valueToOrIn, false));
+                           });
+}
+
+OpenIPC_Error PPI_Slot_ComparisonToConstant(PPI_ProbeBundleHandle handle, PPI_SlotHandle savedSlot, uint32_t numberOfBits, const uint8_t* const mask, const uint8_t* const match, PPI_bool* comparisonResult, const PPI_Slot_ComparisonOptions* const options)
+{
+    const PPI_Slot_COMPARISON_ET comparisonOption = options ? options->option : static_cast<PPI_Slot_COMPARISON_ET>(Comparison_Match_Any_Zeros);
+    const bool exitBundleOnComparisonFailure = options && options->exitBundleOnComparisonFailure;
+    if (savedSlot == PPI_SLOT_HANDLE_INVALID)
     {
-        // Need to copy inBits, since it's lifetime is not guaranteed beyond this method.
-        // However outBits which is guaranteed to live until either bundle_clear or bundle_execute (if it is provided)
-        inData = std::vector(inBits, inBits + (shiftLengthBits + 7) / 8);
+        return OpenIPC_Error_Probe_Bundle_Invalid_Slot;
     }
-    const auto bundle = RetrieveBundle(handle);
-    if (std::holds_alternative<std::monostate>(*bundle))
+    auto* slot = ReferenceSlot::FromOpaqueHandle(savedSlot);
+    if (slot->BitCount != numberOfBits)
     {
-        *bundle = ReferenceJtagBundle{}; // Empty bundle can become a Jtag bundle
+        return OpenIPC_Error_Probe_Bundle_Invalid_Slot;
     }
-    if (auto* jtagBundle = std::get_if<ReferenceJtagBundle>(bundle))
+    return AppendOrExecute(handle, [&](ReferenceJtagBundle& jtagBundle)
+                           {
+                               return jtagBundle.AppendSlotComparison(slot,
+                                                                      CopySlotBuffer(numberOfBits, mask,  comparisonOption & Comparison_Mask_Ones),
+                                                                      CopySlotBuffer(numberOfBits, match, comparisonOption & Comparison_Match_Any_Ones),
+                                                                      comparisonResult, exitBundleOnComparisonFailure);
+                           });
+}
+
+// ==== Loops ====
+OpenIPC_Error PPI_Loop_LoopBreakOnComparisonSuccess(PPI_ProbeBundleHandle handle, PPI_ProbeBundleHandle body, uint32_t maxNumberOfIterations, const PPI_Loop_LoopWithBreakOptions* const options)
+{
+    const bool continueOnTimeoutError = options && options->continueOnTimeoutError;
+    if (body == PPI_PROBE_LOCK_RELEASE || body == PPI_PROBE_LOCK_HOLD || body == handle)
     {
-        return jtagBundle->AppendDrScan(shiftLengthBits, std::move(inData), outBits);
+        return OpenIPC_Error_Probe_Invalid_Parameter;
     }
-    else
+    const auto* bodyBundle = RetrieveJtagBundle(body);
+    if (bodyBundle == nullptr)
     {
-        return OpenIPC_Error_Probe_Bundle_Invalid;
+        return OpenIPC_Error_Probe_Invalid_Parameter;
     }
+    return AppendOrExecute(handle, [&](ReferenceJtagBundle& jtagBundle)
+                           {
+                               return jtagBundle.AppendLoopBreakOnComparisonSuccess(*bodyBundle, maxNumberOfIterations, continueOnTimeoutError);
+                           });
+}
+
+OpenIPC_Error PPI_Loop_CaptureAll(PPI_ProbeBundleHandle handle, PPI_ProbeBundleHandle body, uint32_t numberOfIterations, uint32_t bufferLengthInBytes, uint8_t* bufferForIterations, uint32_t* currentBit, const PPI_Loop_Options* const options)
+{
+    (void)options; // Not used by this version of PPI
+    if (body == PPI_PROBE_LOCK_RELEASE || body == PPI_PROBE_LOCK_HOLD || body == handle)
+    {
+        return OpenIPC_Error_Probe_Invalid_Parameter;
+    }
+    if (bufferForIterations == nullptr && bufferLengthInBytes > 0)
+    {
+        return OpenIPC_Error_Null_Pointer;
+    }
+    const auto* bodyBundle = RetrieveJtagBundle(body);
+    if (bodyBundle == nullptr)
+    {
+        return OpenIPC_Error_Probe_Invalid_Parameter;
+    }
+    return AppendOrExecute(handle, [&](ReferenceJtagBundle& jtagBundle)
+                           {
+                               return jtagBundle.AppendLoopCaptureAll(*bodyBundle, numberOfIterations, bufferLengthInBytes, bufferForIterations, currentBit);
+                           });
 }
 
 // This method may become optional in the future. In that case, OpenIPC will assume all interfaces have independent locks
@@ -1667,10 +5907,60 @@ OpenIPC_Error PPI_InterfaceListLockInterfacePeers(OpenIPC_DeviceId interfaceID,
     {
         return OpenIPC_Error_Invalid_Device_ID;
     }
+    // Each interface serializes on its own lock, so calls on one never wait on another
     *numberOfPeerInterfaces = 0;
     return OpenIPC_Error_No_Error;
 }
 
+OpenIPC_Error PPI_InterfaceScan(OpenIPC_DeviceId interfaceID, const uint32_t* input, uint32_t inputdwords, uint32_t* output, uint32_t maxoutputdwords, uint32_t* outputdwords)
+{
+    assert(EXAMPLE_PLUGIN_INSTANCE != nullptr);
+    assert(outputdwords != nullptr);
+    if ((input == nullptr && inputdwords > 0) || (output == nullptr && maxoutputdwords > 0))
+    {
+        return OpenIPC_Error_Null_Pointer;
+    }
+    *outputdwords = 0;
+    auto probeInterface = EXAMPLE_PLUGIN_INSTANCE->GetInterfaceByDeviceId(interfaceID);
+    return std::visit([&](auto& maybeInterface)
+                      {
+                          if constexpr (is_decay_equ<decltype(maybeInterface), std::monostate>)
+                          {
+                              return OpenIPC_Error_Invalid_Device_ID;
+                          }
+                          else if constexpr (is_decay_equ<decltype(maybeInterface), ReferenceJtagInterface>)
+                          {
+                              return maybeInterface.get().ExecuteScanStream(input, inputdwords, output, maxoutputdwords, *outputdwords);
+                          }
+                          else
+                          {
+                              return OpenIPC_Error_Operation_Not_Supported;
+                          }
+                      }, probeInterface);
+}
+
+OpenIPC_Error PPI_InterfaceOperationCancel(OpenIPC_DeviceId interfaceID)
+{
+    assert(EXAMPLE_PLUGIN_INSTANCE != nullptr);
+    auto probeInterface = EXAMPLE_PLUGIN_INSTANCE->GetInterfaceByDeviceId(interfaceID);
+    return std::visit([](auto& maybeInterface)
+                      {
+                          if constexpr (is_decay_equ<decltype(maybeInterface), std::monostate>)
+                          {
+                              return OpenIPC_Error_Invalid_Device_ID;
+                          }
+                          else if constexpr (is_decay_equ<decltype(maybeInterface), ReferenceJtagInterface>)
+                          {
+                              return maybeInterface.get().CancelOperations();
+                          }
+                          else
+                          {
+                              // Executes its operations without waiting on the receiver, so there is nothing to cancel
+                              return OpenIPC_Error_No_Error;
+                          }
+                      }, probeInterface);
+}
+
 OpenIPC_Error PPI_StatePortGetDefinitions(OpenIPC_DeviceId deviceId, const PPI_InterfaceStatePortDefinition** definitions, uint32_t definitionsSize, uint32_t* numberOfDefinitions)
 {
     assert(definitions != nullptr || definitionsSize == 0);
@@ -0,0 +1,573 @@
+/////////////////////////<Source Code Embedded Notices>/////////////////////////
+//
+// INTEL CONFIDENTIAL
+// Copyright (C) Intel Corporation All Rights Reserved.
+//
+// The source code contained or described herein and all documents related to
+// the source code ("Material") are owned by Intel Corporation or its suppliers
+// or licensors. Title to the Material remains with Intel Corporation or its
+// suppliers and licensors. The Material contains trade secrets and proprietary
+// and confidential information of Intel or its suppliers and licensors. The
+// Material is protected by worldwide copyright and trade secret laws and
+// treaty provisions. No part of the Material may be used, copied, reproduced,
+// modified, published, uploaded, posted, transmitted, distributed, or disclosed
+// in any way without Intel's prior express written permission.
+//
+// No license under any patent, copyright, trade secret or other intellectual
+// property right is granted to or conferred upon you by disclosure or delivery
+// of the Materials, either expressly, by implication, inducement, estoppel or
+// otherwise. Any license under such intellectual property rights must be
+// express and approved by Intel in writing.
+//
+/////////////////////////<Source Code Embedded Notices>/////////////////////////
+
+// Behavior tests: drive the plugin's JTAG interface through the PPI and check what the scans, slots and loops do,
+// not only that the methods are exported.
+//
+// Usage: ReferencePlugin_BehaviorTest <plugin>
+
+#include "plugin_test_api.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <exception>
+
+namespace // helpers
+{
+    using namespace PluginTest;
+
+    bool GetBit(const uint8_t* bytes, size_t bit)
+    {
+        return (bytes[bit / 8] >> (bit % 8)) & 1;
+    }
+
+    void SetBit(uint8_t* bytes, size_t bit, bool value)
+    {
+        bytes[bit / 8] = static_cast<uint8_t>(value ? bytes[bit / 8] | (1 << (bit % 8)) : bytes[bit / 8] & ~(1 << (bit % 8)));
+    }
+
+    // PPI_InterfaceScan command stream encoding, see the ReferenceInterfaceScan namespace of the plugin
+    namespace InterfaceScanStream
+    {
+        constexpr uint32_t IrScan = 0x02;
+        constexpr uint32_t DrScan = 0x03;
+
+        constexpr uint32_t CaptureTdo    = 0x01;
+        constexpr uint32_t FillTdi       = 0x04;
+        constexpr uint32_t FillOnes      = 0x08;
+        constexpr uint32_t CompressedTdi = 0x10;
+        constexpr uint32_t DeltaTdo      = 0x20;
+
+        constexpr uint32_t Raw       = 0x0;
+        constexpr uint32_t RunLength = 0x1;
+        constexpr uint32_t Unchanged = 0x2;
+        constexpr uint32_t XorDelta  = 0x3;
+        constexpr uint32_t RunToken  = 0x80000000;
+
+        constexpr uint32_t Header(uint32_t opcode, uint32_t flags, uint32_t pollId = 0)
+        {
+            return opcode | (flags << 8) | (pollId << 16);
+        }
+
+        constexpr uint32_t PayloadEncoding(uint32_t payloadHeader)
+        {
+            return payloadHeader >> 28;
+        }
+
+        constexpr uint32_t PayloadSize(uint32_t payloadHeader)
+        {
+            return payloadHeader & ((1u << 28) - 1);
+        }
+
+        // Expands run-length tokens: a token with bit 31 set is a run of the dword after it, otherwise a count of literals
+        std::vector<uint32_t> RunLengthDecode(const uint32_t* tokens, size_t tokenDwords)
+        {
+            std::vector<uint32_t> payload;
+            for (size_t position = 0; position < tokenDwords;)
+            {
+                const uint32_t count = tokens[position] & ~RunToken;
+                if (tokens[position++] & RunToken)
+                {
+                    payload.insert(payload.end(), count, tokens[position++]);
+                }
+                else
+                {
+                    payload.insert(payload.end(), tokens + position, tokens + position + count);
+                    position += count;
+                }
+            }
+            return payload;
+        }
+    }
+
+    uint32_t ToUint32(const uint8_t (&bytes)[4])
+    {
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    }
+
+    // The plugin, initialized for one test, with the first JTAG interface of its first probe initialized.
+    // Configs are set before the probes are listed, so plugin level configs take effect on them.
+    class JtagFixture : public PluginFixture
+    {
+    public:
+        static constexpr OpenIPC_DeviceId ProbeDeviceId = 10;
+        static constexpr OpenIPC_DeviceId JtagDeviceId  = 100;
+
+        JtagFixture(const PluginApi& api, const std::vector<std::pair<std::string, std::string>>& pluginConfigs = {}) :
+            PluginFixture(api)
+        {
+            for (const auto& [name, value] : pluginConfigs)
+            {
+                SetConfig(0, name, value);
+            }
+            PPI_RefId probeRefIds[16];
+            uint32_t probeCount = 0;
+            RequireNoError(api.ProbeGetRefIds(16, probeRefIds, &probeCount), "PPI_ProbeGetRefIds failed.");
+            RequireNoError(api.ProbeBeginInitialization(probeRefIds[0], ProbeDeviceId), "PPI_ProbeBeginInitialization failed.");
+            api.ProbeFinishInitialization(ProbeDeviceId); // The receiver isn't needed, a failed handshake still initializes the probe
+            PPI_RefId interfaceRefIds[16];
+            uint32_t interfaceCount = 0;
+            RequireNoError(api.InterfaceGetRefIds(ProbeDeviceId, 16, interfaceRefIds, &interfaceCount), "PPI_InterfaceGetRefIds failed.");
+            RequireNoError(api.InterfaceBeginInitialization(ProbeDeviceId, interfaceRefIds[0], JtagDeviceId), "PPI_InterfaceBeginInitialization failed.");
+            RequireNoError(api.InterfaceFinishInitialization(JtagDeviceId), "PPI_InterfaceFinishInitialization failed.");
+        }
+
+        // Selects the IDCODE instruction and reads the IDCODE
+        uint32_t ReadIdcode()
+        {
+            const uint8_t idcodeInstruction = 0x02;
+            uint8_t idcode[4] = {};
+            auto bundle = _api.BundleAllocate();
+            RequireNoError(_api.StateIRShift(bundle, 8, &idcodeInstruction, nullptr, nullptr), "PPI_JTAG_StateIRShift failed.");
+            RequireNoError(_api.StateDRShift(bundle, 32, nullptr, idcode, nullptr), "PPI_JTAG_StateDRShift failed.");
+            RequireNoError(_api.BundleExecute(bundle, JtagDeviceId, 0), "PPI_Bundle_Execute failed.");
+            _api.BundleFree(&bundle);
+            return ToUint32(idcode);
+        }
+    };
+}
+
+// A loop keeps the slots its body uses alive after the body and the slot are freed, PPI_Slot_Free releases a slot
+// whether or not its bundle was freed first, and the data in the slots is reset when the lock is released.
+int TestSlotsAndLoops(const PluginApi& api)
+{
+    JtagFixture fixture(api);
+    const uint32_t idcode = fixture.ReadIdcode();
+    const uint8_t idcodeBytes[4] = { static_cast<uint8_t>(idcode), static_cast<uint8_t>(idcode >> 8),
+                                     static_cast<uint8_t>(idcode >> 16), static_cast<uint8_t>(idcode >> 24) };
+    const uint8_t allOnes[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+    const uint8_t idcodeInstruction = 0x02;
+
+    auto loopBundle  = api.BundleAllocate();
+    auto slotBundle  = api.BundleAllocate();
+    auto bodyBundle  = api.BundleAllocate();
+    auto slot = api.SlotAllocate(slotBundle, 32);
+    RequireEqual(slot != PPI_SLOT_HANDLE_INVALID, true, "PPI_Slot_Allocate failed.");
+    uint32_t slotSize = 0;
+    RequireNoError(api.SlotSize(slot, &slotSize), "PPI_Slot_Size failed.");
+    RequireEqual(slotSize, 32u, "Wrong slot size.");
+
+    PPI_JTAG_StateShiftOptions saveToSlot { JtagOption_TDO_Save_To_Slot, slot };
+    PPI_bool matched = 0;
+    RequireNoError(api.StateIRShift(bodyBundle, 8, &idcodeInstruction, nullptr, nullptr), "PPI_JTAG_StateIRShift failed.");
+    RequireNoError(api.StateDRShift(bodyBundle, 32, nullptr, nullptr, &saveToSlot), "PPI_JTAG_StateDRShift failed.");
+    RequireNoError(api.SlotComparisonToConstant(bodyBundle, slot, 32, allOnes, idcodeBytes, &matched, nullptr), "PPI_Slot_ComparisonToConstant failed.");
+    RequireNoError(api.LoopBreakOnComparisonSuccess(loopBundle, bodyBundle, 10, nullptr), "PPI_Loop_LoopBreakOnComparisonSuccess failed.");
+
+    // Only the loop is left holding the slot
+    api.BundleFree(&bodyBundle);
+    RequireNoError(api.SlotFree(&slot), "PPI_Slot_Free failed.");
+    RequireEqual(slot == PPI_SLOT_HANDLE_INVALID, true, "PPI_Slot_Free didn't invalidate the handle.");
+    RequireEqual<int>(api.SlotFree(&slot), OpenIPC_Error_Probe_Bundle_Invalid_Slot, "Freeing an invalid slot didn't fail.");
+    api.BundleFree(&slotBundle);
+    RequireNoError(api.BundleExecute(loopBundle, JtagFixture::JtagDeviceId, 0), "Executing the loop failed.");
+    RequireEqual<int>(matched, 1, "The loop's comparison didn't match the IDCODE.");
+    api.BundleFree(&loopBundle);
+
+    // The TDO saved to a slot is still there for the next bundle while the lock is kept, and is reset on the release
+    auto saveBundle    = api.BundleAllocate();
+    auto compareBundle = api.BundleAllocate();
+    slot = api.SlotAllocate(saveBundle, 32);
+    saveToSlot.savedSlot = slot;
+    const uint8_t zeros[4] = {};
+    RequireNoError(api.StateIRShift(saveBundle, 8, &idcodeInstruction, nullptr, nullptr), "PPI_JTAG_StateIRShift failed.");
+    RequireNoError(api.StateDRShift(saveBundle, 32, nullptr, nullptr, &saveToSlot), "PPI_JTAG_StateDRShift failed.");
+    RequireNoError(api.BundleExecute(saveBundle, JtagFixture::JtagDeviceId, 1), "Executing the save failed.");
+    RequireNoError(api.SlotComparisonToConstant(compareBundle, slot, 32, allOnes, idcodeBytes, &matched, nullptr), "PPI_Slot_ComparisonToConstant failed.");
+    RequireNoError(api.BundleExecute(compareBundle, JtagFixture::JtagDeviceId, 0), "Executing the comparison failed.");
+    RequireEqual<int>(matched, 1, "The slot lost its TDO while the lock was kept.");
+    api.BundleClear(compareBundle);
+    RequireNoError(api.SlotComparisonToConstant(compareBundle, slot, 32, allOnes, zeros, &matched, nullptr), "PPI_Slot_ComparisonToConstant failed.");
+    RequireNoError(api.BundleExecute(compareBundle, JtagFixture::JtagDeviceId, 0), "Executing the comparison failed.");
+    RequireEqual<int>(matched, 1, "The slot wasn't reset when the lock was released.");
+    api.BundleFree(&compareBundle);
+    api.BundleFree(&saveBundle);
+    // A slot stays allocated until PPI_Slot_Free, even after its bundle is freed
+    RequireNoError(api.SlotFree(&slot), "Freeing the slot after its bundle failed.");
+    return 0;
+}
+
+// Loop capture packs every iteration's TDO back to back, including scans that aren't a whole number of bytes,
+// and wraps around to the start of the buffer once it is full.
+int TestCaptureWrapAround(const PluginApi& api)
+{
+    JtagFixture fixture(api);
+    const uint32_t idcode = fixture.ReadIdcode();
+    const uint8_t idcodeBytes[4] = { static_cast<uint8_t>(idcode), static_cast<uint8_t>(idcode >> 8),
+                                     static_cast<uint8_t>(idcode >> 16), static_cast<uint8_t>(idcode >> 24) };
+    const uint8_t idcodeInstruction = 0x02;
+    const uint8_t bypassInstruction = 0xFF;
+    const uint8_t one = 1;
+    uint8_t unused[4];
+
+    // Each iteration captures the 32 bit IDCODE, shifted back in so it reads the same every time, and the 1 bit bypass
+    auto loopBundle = api.BundleAllocate();
+    auto bodyBundle = api.BundleAllocate();
+    RequireNoError(api.StateIRShift(bodyBundle, 8, &idcodeInstruction, nullptr, nullptr), "PPI_JTAG_StateIRShift failed.");
+    RequireNoError(api.StateDRShift(bodyBundle, 32, idcodeBytes, unused, nullptr), "PPI_JTAG_StateDRShift failed.");
+    RequireNoError(api.StateIRShift(bodyBundle, 8, &bypassInstruction, nullptr, nullptr), "PPI_JTAG_StateIRShift failed.");
+    RequireNoError(api.StateDRShift(bodyBundle, 1, &one, unused, nullptr), "PPI_JTAG_StateDRShift failed.");
+
+    const uint32_t iterations = 7;
+    uint8_t buffer[10];
+    std::memset(buffer, 0xAA, sizeof(buffer));
+    uint32_t currentBit = 0;
+    RequireNoError(api.LoopCaptureAll(loopBundle, bodyBundle, iterations, sizeof(buffer), buffer, &currentBit, nullptr), "PPI_Loop_CaptureAll failed.");
+    RequireNoError(api.BundleExecute(loopBundle, JtagFixture::JtagDeviceId, 0), "Executing the capture loop failed.");
+
+    const size_t bufferBitCount = sizeof(buffer) * 8;
+    uint8_t expected[sizeof(buffer)] = {};
+    size_t bit = 0;
+    for (uint32_t iteration = 0; iteration < iterations; iteration++)
+    {
+        for (size_t idcodeBit = 0; idcodeBit < 32; idcodeBit++, bit++)
+        {
+            SetBit(expected, bit % bufferBitCount, GetBit(idcodeBytes, idcodeBit));
+        }
+        SetBit(expected, bit++ % bufferBitCount, iteration > 0); // The bypass register starts out as 0
+    }
+    RequireEqual<size_t>(currentBit, bit % bufferBitCount, "Wrong current bit after the capture wrapped around.");
+    for (size_t byte = 0; byte < sizeof(buffer); byte++)
+    {
+        RequireEqual<int>(buffer[byte], expected[byte], "Wrong captured byte " + std::to_string(byte) + ".");
+    }
+    api.BundleFree(&bodyBundle);
+    api.BundleFree(&loopBundle);
+    return 0;
+}
+
+// Padding bits are shifted around the scan: the scan's TDO is the TAP's, and TDO past the TAP's register is the
+// near TDI padding (bypass bits capturing 0's) followed by the DR padding value. Bundles queued while the lock is
+// kept run before a padding change, under the padding they were executed with.
+int TestPaddingAndDeferredOperations(const PluginApi& api)
+{
+    JtagFixture fixture(api);
+    const uint32_t idcode = fixture.ReadIdcode();
+    const uint8_t idcodeInstruction = 0x02;
+    const uint8_t zeros[5] = {};
+
+    RequireNoError(api.SetInterfacePadding(JtagFixture::JtagDeviceId, 0, 0, 5, 3, 1), "PPI_JTAG_SetInterfacePadding failed.");
+    auto bundle = api.BundleAllocate();
+    uint8_t tdo[5] = {};
+    RequireNoError(api.StateIRShift(bundle, 8, &idcodeInstruction, nullptr, nullptr), "PPI_JTAG_StateIRShift failed.");
+    RequireNoError(api.StateDRShift(bundle, 40, zeros, tdo, nullptr), "PPI_JTAG_StateDRShift failed.");
+    RequireNoError(api.BundleExecute(bundle, JtagFixture::JtagDeviceId, 0), "Executing the padded scan failed.");
+    RequireEqual(ToUint32(reinterpret_cast<const uint8_t(&)[4]>(tdo)), idcode, "The padded scan didn't read the IDCODE.");
+    RequireEqual<int>(tdo[4], 0xE0, "Wrong padding bits after the IDCODE.");
+    api.BundleClear(bundle);
+
+    // Load 0x20 (BYPASS) into the IR, then queue a 4 bit IR scan of 0's and change the IR padding before it runs.
+    // Without padding it shifts the IR to 0x02 (IDCODE). Through 4 bits of near TDI padding, the TAP would see
+    // the 0's of the padding first and end up with 0x00 (BYPASS).
+    const uint8_t instructionAbove = 0x20;
+    RequireNoError(api.SetInterfacePadding(JtagFixture::JtagDeviceId, 0, 0, 0, 0, 0), "PPI_JTAG_SetInterfacePadding failed.");
+    RequireNoError(api.StateIRShift(bundle, 8, &instructionAbove, nullptr, nullptr), "PPI_JTAG_StateIRShift failed.");
+    RequireNoError(api.BundleExecute(bundle, JtagFixture::JtagDeviceId, 0), "Loading the IR failed.");
+    api.BundleClear(bundle);
+    RequireNoError(api.StateIRShift(bundle, 4, zeros, nullptr, nullptr), "PPI_JTAG_StateIRShift failed.");
+    RequireNoError(api.BundleExecute(bundle, JtagFixture::JtagDeviceId, 1), "Queueing the IR scan failed.");
+    RequireNoError(api.SetInterfacePadding(JtagFixture::JtagDeviceId, 4, 0, 0, 0, 0), "PPI_JTAG_SetInterfacePadding failed.");
+    api.BundleClear(bundle);
+    RequireNoError(api.StateDRShift(bundle, 32, zeros, tdo, nullptr), "PPI_JTAG_StateDRShift failed.");
+    RequireNoError(api.BundleExecute(bundle, JtagFixture::JtagDeviceId, 0), "Reading the IDCODE failed.");
+    RequireEqual(ToUint32(reinterpret_cast<const uint8_t(&)[4]>(tdo)), idcode, "The queued instruction ran under the new padding.");
+    api.BundleFree(&bundle);
+    return 0;
+}
+
+// Scans without TDI shift generated 0's or 1's, through the padding of a bundle scan and in chunks in a
+// PPI_InterfaceScan stream.
+int TestFilledTdi(const PluginApi& api)
+{
+    JtagFixture fixture(api);
+    const uint8_t bypassInstruction = 0xFF;
+
+    // The bypass bit starts out as 0, then sees the 3 near TDI 0's and the 2 near TDO padding 0's before the 1's
+    RequireNoError(api.SetInterfacePadding(JtagFixture::JtagDeviceId, 0, 0, 3, 2, 0), "PPI_JTAG_SetInterfacePadding failed.");
+    auto bundle = api.BundleAllocate();
+    uint8_t tdo[4] = {};
+    const PPI_JTAG_StateShiftOptions fillWithOnes { JtagOption_TDI_All_Ones, PPI_SLOT_HANDLE_INVALID };
+    RequireNoError(api.StateIRShift(bundle, 8, &bypassInstruction, nullptr, nullptr), "PPI_JTAG_StateIRShift failed.");
+    RequireNoError(api.StateDRShift(bundle, 20, nullptr, tdo, &fillWithOnes), "PPI_JTAG_StateDRShift failed.");
+    RequireNoError(api.BundleExecute(bundle, JtagFixture::JtagDeviceId, 0), "Executing the filled scan failed.");
+    RequireEqual(ToUint32(tdo), 0xFFFC0u, "Wrong TDO of the filled scan.");
+    api.BundleFree(&bundle);
+
+    // The bypass bit now holds a 1, which comes out ahead of the 0's
+    using namespace InterfaceScanStream;
+    const uint32_t input[] = { Header(IrScan, FillTdi | FillOnes), 8,
+                               Header(DrScan, FillTdi | CaptureTdo), 40 };
+    uint32_t output[2] = {};
+    uint32_t outputDwords = 0;
+    RequireNoError(api.InterfaceScan(JtagFixture::JtagDeviceId, input, 4, output, 2, &outputDwords), "PPI_InterfaceScan failed.");
+    RequireEqual(outputDwords, 2u, "Wrong TDO payload size.");
+    RequireEqual(output[0], 1u, "Wrong first TDO dword of the filled stream scan.");
+    RequireEqual(output[1], 0u, "Wrong second TDO dword of the filled stream scan.");
+    return 0;
+}
+
+// With InterfaceScan.Compression set to RunLength, compressed TDI is expanded, TDO payloads come back run-length
+// encoded when that is smaller, and a DeltaTdo poll is answered relative to the TDO the host last got for it.
+// A stream that fails leaves the host's bases where the last successful stream left them.
+int TestCompressedInterfaceScan(const PluginApi& api)
+{
+    JtagFixture fixture(api);
+    const uint32_t idcode = fixture.ReadIdcode();
+    fixture.SetConfig(JtagFixture::JtagDeviceId, "InterfaceScan.Compression", "RunLength");
+    using namespace InterfaceScanStream;
+
+    // A 256 bit DR scan of the IDCODE register reads the IDCODE, then the first 224 bits of its TDI
+    const auto pollStream = [&](std::vector<uint32_t> encodedTdi, bool thenOverflow)
+    {
+        std::vector<uint32_t> input { Header(IrScan, 0), 8, 0x02, Header(DrScan, CaptureTdo | CompressedTdi | DeltaTdo, 7), 256,
+                                      static_cast<uint32_t>(encodedTdi.size()) };
+        input.insert(input.end(), encodedTdi.begin(), encodedTdi.end());
+        if (thenOverflow)
+        {
+            input.insert(input.end(), { Header(DrScan, CaptureTdo | FillTdi), 256 });
+        }
+        return input;
+    };
+    const std::vector<uint32_t> zerosTdi { RunToken | 8, 0 };
+    const std::vector<uint32_t> patternTdi { RunToken | 3, 0, 1, 0xFFFF, RunToken | 4, 0 };
+    const std::vector<uint32_t> zerosTdo { idcode, 0, 0, 0, 0, 0, 0, 0 };
+    const std::vector<uint32_t> patternTdo { idcode, 0, 0, 0, 0xFFFF, 0, 0, 0 };
+
+    uint32_t output[16] = {};
+    uint32_t outputDwords = 0;
+    auto input = pollStream(zerosTdi, false);
+    RequireNoError(api.InterfaceScan(JtagFixture::JtagDeviceId, input.data(), static_cast<uint32_t>(input.size()), output, 16, &outputDwords), "PPI_InterfaceScan failed.");
+    RequireEqual(PayloadEncoding(output[0]), RunLength, "The first poll wasn't run-length encoded.");
+    RequireEqual(outputDwords, 1 + PayloadSize(output[0]), "Wrong output size of the first poll.");
+    RequireEqual(RunLengthDecode(output + 1, PayloadSize(output[0])) == zerosTdo, true, "The first poll didn't decode to its TDO.");
+
+    // The overflowing stream's delta never reaches the host
+    input = pollStream(patternTdi, true);
+    RequireEqual<int>(api.InterfaceScan(JtagFixture::JtagDeviceId, input.data(), static_cast<uint32_t>(input.size()), output, 7, &outputDwords),
+                      OpenIPC_Error_Probe_Invalid_Size, "The overflowing stream didn't fail.");
+
+    input = pollStream(zerosTdi, false);
+    RequireNoError(api.InterfaceScan(JtagFixture::JtagDeviceId, input.data(), static_cast<uint32_t>(input.size()), output, 16, &outputDwords), "PPI_InterfaceScan failed.");
+    RequireEqual(PayloadEncoding(output[0]), Unchanged, "The repeated poll wasn't answered as unchanged.");
+    RequireEqual(outputDwords, 1u, "The unchanged poll has a payload.");
+
+    input = pollStream(patternTdi, false);
+    RequireNoError(api.InterfaceScan(JtagFixture::JtagDeviceId, input.data(), static_cast<uint32_t>(input.size()), output, 16, &outputDwords), "PPI_InterfaceScan failed.");
+    RequireEqual(PayloadEncoding(output[0]), XorDelta, "The changed poll wasn't answered with a delta.");
+    auto rebuilt = RunLengthDecode(output + 1, PayloadSize(output[0]));
+    RequireEqual(rebuilt.size(), zerosTdo.size(), "Wrong delta size.");
+    for (size_t dword = 0; dword < rebuilt.size(); dword++)
+    {
+        rebuilt[dword] ^= zerosTdo[dword];
+    }
+    RequireEqual(rebuilt == patternTdo, true, "The delta didn't rebuild the changed poll's TDO.");
+    return 0;
+}
+
+// A scan longer than the 512K bit streaming chunk is shifted through the padding and the TAP a chunk at a time, with
+// the same TDO as a scan shifted at once: the bypass bit's 0, the near TDI padding's 0's, the near TDO padding value,
+// then the scan's TDI. The bypass bit is left holding the scan's last bit.
+int TestStreamedPaddedScan(const PluginApi& api)
+{
+    JtagFixture fixture(api);
+    const uint8_t bypassInstruction = 0xFF;
+    const uint32_t bitCount = 512 * 1024 + 1001;
+    std::vector<uint8_t> tdi((bitCount + 7) / 8);
+    for (size_t byte = 0; byte < tdi.size(); byte++)
+    {
+        tdi[byte] = static_cast<uint8_t>(byte * 7 + 3);
+    }
+    std::vector<uint8_t> tdo(tdi.size(), 0);
+
+    RequireNoError(api.SetInterfacePadding(JtagFixture::JtagDeviceId, 0, 0, 5, 3, 1), "PPI_JTAG_SetInterfacePadding failed.");
+    auto bundle = api.BundleAllocate();
+    RequireNoError(api.StateIRShift(bundle, 8, &bypassInstruction, nullptr, nullptr), "PPI_JTAG_StateIRShift failed.");
+    RequireNoError(api.StateDRShift(bundle, bitCount, tdi.data(), tdo.data(), nullptr), "PPI_JTAG_StateDRShift failed.");
+    RequireNoError(api.BundleExecute(bundle, JtagFixture::JtagDeviceId, 0), "Executing the streamed scan failed.");
+    for (size_t bit = 0; bit < bitCount; bit++)
+    {
+        const bool expected = bit < 6 ? false : bit < 9 ? true : GetBit(tdi.data(), bit - 9);
+        if (GetBit(tdo.data(), bit) != expected)
+        {
+            RequireEqual(GetBit(tdo.data(), bit), expected, "Wrong TDO of the streamed scan at bit " + std::to_string(bit) + ".");
+        }
+    }
+
+    RequireNoError(api.SetInterfacePadding(JtagFixture::JtagDeviceId, 0, 0, 0, 0, 0), "PPI_JTAG_SetInterfacePadding failed.");
+    api.BundleClear(bundle);
+    const uint8_t zero = 0;
+    uint8_t bypassTdo = 0;
+    RequireNoError(api.StateDRShift(bundle, 1, &zero, &bypassTdo, nullptr), "PPI_JTAG_StateDRShift failed.");
+    RequireNoError(api.BundleExecute(bundle, JtagFixture::JtagDeviceId, 0), "Reading the bypass bit failed.");
+    RequireEqual<bool>(bypassTdo, GetBit(tdi.data(), bitCount - 1), "The bypass bit didn't keep the streamed scan's last bit.");
+    api.BundleFree(&bundle);
+    return 0;
+}
+
+// PPI_JTAG_PinsShift clocks TMS given next to TDI through the TAP's state machine, shifting the IR and the DR in their
+// shift states. The TMS patterns stay in the state the last pins shift left the TAP in, exit it on the last clock,
+// or walk on from it.
+int TestPinsShift(const PluginApi& api)
+{
+    JtagFixture fixture(api);
+    const uint8_t idcodeInstruction = 0x02;
+    const uint16_t drTdi = 0xB3A;
+
+    uint8_t tdi[5] = {};
+    uint8_t tms[5] = {};
+    uint32_t clock = 0;
+    const auto addClock = [&](bool tmsBit, bool tdiBit)
+    {
+        SetBit(tms, clock, tmsBit);
+        SetBit(tdi, clock, tdiBit);
+        clock++;
+    };
+    // Test-Logic-Reset (which selects IDCODE), Run-Test/Idle, Select-DR, Select-IR, Capture-IR, Shift-IR
+    for (const char tmsBit : std::string("1111101100"))
+    {
+        addClock(tmsBit == '1', false);
+    }
+    // BYPASS, exiting to Exit1-IR on the last bit
+    for (uint32_t bit = 0; bit < 8; bit++)
+    {
+        addClock(bit == 7, true);
+    }
+    // Update-IR, Select-DR, Capture-DR, Shift-DR, then 12 bits through the bypass register
+    for (const char tmsBit : std::string("1100"))
+    {
+        addClock(tmsBit == '1', false);
+    }
+    for (uint32_t bit = 0; bit < 12; bit++)
+    {
+        addClock(false, (drTdi >> bit) & 1);
+    }
+
+    uint8_t tdo[5] = {};
+    auto bundle = api.BundleAllocate();
+    RequireNoError(api.PinsShift(bundle, clock, tdi, tms, tdo, nullptr), "PPI_JTAG_PinsShift failed.");
+    RequireNoError(api.BundleExecute(bundle, JtagFixture::JtagDeviceId, 0), "Executing the pins shift failed.");
+    api.BundleFree(&bundle);
+    for (uint32_t bit = 0; bit < clock; bit++)
+    {
+        // The IR shifts out the IDCODE instruction, and the bypass bit its 0 and then the TDI a clock later
+        bool expected = false;
+        if (bit >= 10 && bit < 18)
+        {
+            expected = (idcodeInstruction >> (bit - 10)) & 1;
+        }
+        else if (bit >= 23)
+        {
+            expected = (drTdi >> (bit - 23)) & 1;
+        }
+        RequireEqual(GetBit(tdo, bit), expected, "Wrong TDO of the pins shift at clock " + std::to_string(bit) + ".");
+    }
+
+    // All 0's stays in Shift-DR, the last one exits to Exit1-DR, all 1's walks on through Update-DR to Select-DR,
+    // and from there TMS 00001 goes through Capture-DR to shift 3 bits
+    const uint8_t stayTdi    = 0x5A;
+    const uint8_t exitTdi    = 0x0E;
+    const uint8_t shiftTdi   = 0x00;
+    const uint8_t shiftTms   = 0x10;
+    uint8_t stayTdo  = 0;
+    uint8_t exitTdo  = 0;
+    uint8_t walkTdo  = 0xFF;
+    uint8_t shiftTdo = 0;
+    PPI_JTAG_PinsOptions options { JtagOption_TDI_Default, JtagOption_TMS_Default, PPI_SLOT_HANDLE_INVALID };
+    bundle = api.BundleAllocate();
+    RequireNoError(api.PinsShift(bundle, 8, &stayTdi, nullptr, &stayTdo, &options), "PPI_JTAG_PinsShift failed.");
+    options.tmsOptions = JtagOption_TMS_Last_One;
+    RequireNoError(api.PinsShift(bundle, 4, &exitTdi, nullptr, &exitTdo, &options), "PPI_JTAG_PinsShift failed.");
+    options.tmsOptions = JtagOption_TMS_All_Ones;
+    RequireNoError(api.PinsShift(bundle, 2, nullptr, nullptr, &walkTdo, &options), "PPI_JTAG_PinsShift failed.");
+    RequireNoError(api.PinsShift(bundle, 5, &shiftTdi, &shiftTms, &shiftTdo, nullptr), "PPI_JTAG_PinsShift failed.");
+    RequireNoError(api.BundleExecute(bundle, JtagFixture::JtagDeviceId, 0), "Executing the TMS patterns failed.");
+    api.BundleFree(&bundle);
+    RequireEqual<int>(stayTdo, 0xB5, "Wrong TDO of the shift that stays in Shift-DR.");
+    RequireEqual<int>(exitTdo, 0x0C, "Wrong TDO of the shift that exits on its last clock.");
+    RequireEqual<int>(walkTdo, 0x00, "Wrong TDO of the walk out of Exit1-DR.");
+    RequireEqual<int>(shiftTdo, 0x04, "Wrong TDO of the shift from Select-DR.");
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Probe Plugin Name must be passed as the first argument.\n";
+        return 1;
+    }
+    const auto dllHandle = LoadDll(argv[1]);
+    PluginApi api {};
+    if (!dllHandle || !LoadApi(dllHandle, api))
+    {
+        std::cerr << "Failed to load dll " << std::quoted(argv[1]) << ".\n";
+        return 1;
+    }
+    try
+    {
+        if (auto result = TestSlotsAndLoops(api))
+        {
+            std::cout << "TestSlotsAndLoops failed.\n";
+            return result;
+        }
+        if (auto result = TestCaptureWrapAround(api))
+        {
+            std::cout << "TestCaptureWrapAround failed.\n";
+            return result;
+        }
+        if (auto result = TestPaddingAndDeferredOperations(api))
+        {
+            std::cout << "TestPaddingAndDeferredOperations failed.\n";
+            return result;
+        }
+        if (auto result = TestFilledTdi(api))
+        {
+            std::cout << "TestFilledTdi failed.\n";
+            return result;
+        }
+        if (auto result = TestCompressedInterfaceScan(api))
+        {
+            std::cout << "TestCompressedInterfaceScan failed.\n";
+            return result;
+        }
+        if (auto result = TestStreamedPaddedScan(api))
+        {
+            std::cout << "TestStreamedPaddedScan failed.\n";
+            return result;
+        }
+        if (auto result = TestPinsShift(api))
+        {
+            std::cout << "TestPinsShift failed.\n";
+            return result;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    std::cout << "All tests passed.\n";
+    return 0; // PASS
+}
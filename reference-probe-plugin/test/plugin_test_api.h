@@ -0,0 +1,201 @@
+/////////////////////////<Source Code Embedded Notices>/////////////////////////
+//
+// INTEL CONFIDENTIAL
+// Copyright (C) Intel Corporation All Rights Reserved.
+//
+// The source code contained or described herein and all documents related to
+// the source code ("Material") are owned by Intel Corporation or its suppliers
+// or licensors. Title to the Material remains with Intel Corporation or its
+// suppliers and licensors. The Material contains trade secrets and proprietary
+// and confidential information of Intel or its suppliers and licensors. The
+// Material is protected by worldwide copyright and trade secret laws and
+// treaty provisions. No part of the Material may be used, copied, reproduced,
+// modified, published, uploaded, posted, transmitted, distributed, or disclosed
+// in any way without Intel's prior express written permission.
+//
+// No license under any patent, copyright, trade secret or other intellectual
+// property right is granted to or conferred upon you by disclosure or delivery
+// of the Materials, either expressly, by implication, inducement, estoppel or
+// otherwise. Any license under such intellectual property rights must be
+// express and approved by Intel in writing.
+//
+/////////////////////////<Source Code Embedded Notices>/////////////////////////
+
+// What the tests and the benchmark that drive the plugin through the PPI share: loading the plugin and its
+// functions, the checks, and the plugin's initialization for one test.
+
+#pragma once
+
+#include <ProbePlugin.h>
+#include <BundleOperations.h>
+#include <JtagStateBasedOperations.h>
+#include <JTAGPinsBasedOperations.h>
+#include <SlotOperations.h>
+#include <LoopOperations.h>
+#include <JTAGPaddingOperations.h>
+#include <InterfaceScanBulkOperations.h>
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <memory>
+#include <cstring>
+
+#if defined(_WIN32)
+    #include <windows.h>
+#else
+    #include <dlfcn.h>
+#endif
+
+namespace PluginTest
+{
+    #if defined(_WIN32)
+        using DllHandle = std::unique_ptr<std::remove_pointer_t<HMODULE>, decltype(& ::FreeLibrary)>;
+        inline DllHandle LoadDll(const std::string& dllName)
+        {
+            ::SetDllDirectoryA(".");
+            return DllHandle(::LoadLibraryA(dllName.c_str()), &::FreeLibrary);
+        }
+
+        inline void* GetProcedureFromDll(const DllHandle& dllHandle, const char* procName)
+        {
+            return reinterpret_cast<void*>(::GetProcAddress(dllHandle.get(), procName));
+        }
+    #else
+        using DllHandle = std::unique_ptr<void, void (*)(void*)>;
+        inline DllHandle LoadDll(const std::string& dllName)
+        {
+            return DllHandle(dlopen(("./" + dllName).c_str(), RTLD_LAZY | RTLD_LOCAL), [](void* handle) { dlclose(handle); });
+        }
+
+        inline void* GetProcedureFromDll(const DllHandle& dllHandle, const char* procName)
+        {
+            return dlsym(dllHandle.get(), procName);
+        }
+    #endif
+
+    // The PPI functions the tests drive
+    struct PluginApi
+    {
+        PPI_PluginInitialize_TYPE              PluginInitialize;
+        PPI_PluginDeinitialize_TYPE            PluginDeinitialize;
+        PPI_DeviceSetConfig_TYPE               DeviceSetConfig;
+        PPI_ProbeGetRefIds_TYPE                ProbeGetRefIds;
+        PPI_ProbeBeginInitialization_TYPE      ProbeBeginInitialization;
+        PPI_ProbeFinishInitialization_TYPE     ProbeFinishInitialization;
+        PPI_InterfaceGetRefIds_TYPE            InterfaceGetRefIds;
+        PPI_InterfaceGetType_TYPE              InterfaceGetType;
+        PPI_InterfaceBeginInitialization_TYPE  InterfaceBeginInitialization;
+        PPI_InterfaceFinishInitialization_TYPE InterfaceFinishInitialization;
+        PPI_Lock_Target_Interface_TYPE         LockTargetInterface;
+        PPI_Bundle_Allocate_TYPE               BundleAllocate;
+        PPI_Bundle_Execute_TYPE                BundleExecute;
+        PPI_Bundle_Clear_TYPE                  BundleClear;
+        PPI_Bundle_Free_TYPE                   BundleFree;
+        PPI_JTAG_StateIRShift_TYPE             StateIRShift;
+        PPI_JTAG_StateDRShift_TYPE             StateDRShift;
+        PPI_JTAG_PinsShift_TYPE                PinsShift;
+        PPI_Slot_Allocate_TYPE                 SlotAllocate;
+        PPI_Slot_Free_TYPE                     SlotFree;
+        PPI_Slot_Size_TYPE                     SlotSize;
+        PPI_Slot_ComparisonToConstant_TYPE     SlotComparisonToConstant;
+        PPI_Loop_LoopBreakOnComparisonSuccess_TYPE LoopBreakOnComparisonSuccess;
+        PPI_Loop_CaptureAll_TYPE               LoopCaptureAll;
+        PPI_JTAG_SetInterfacePadding_TYPE      SetInterfacePadding;
+        PPI_InterfaceScan_TYPE                 InterfaceScan;
+        PPI_InterfaceOperationCancel_TYPE      InterfaceOperationCancel;
+    };
+
+    template<typename T>
+    bool Load(const DllHandle& dllHandle, T& function, const char* name)
+    {
+        function = reinterpret_cast<T>(GetProcedureFromDll(dllHandle, name));
+        if (function == nullptr)
+        {
+            std::cerr << "Failed to find PPI function " << std::quoted(name) << ".\n";
+        }
+        return function != nullptr;
+    }
+
+    inline bool LoadApi(const DllHandle& dllHandle, PluginApi& api)
+    {
+        return Load(dllHandle, api.PluginInitialize,              "PPI_PluginInitialize")
+            && Load(dllHandle, api.PluginDeinitialize,            "PPI_PluginDeinitialize")
+            && Load(dllHandle, api.DeviceSetConfig,               "PPI_DeviceSetConfig")
+            && Load(dllHandle, api.ProbeGetRefIds,                "PPI_ProbeGetRefIds")
+            && Load(dllHandle, api.ProbeBeginInitialization,      "PPI_ProbeBeginInitialization")
+            && Load(dllHandle, api.ProbeFinishInitialization,     "PPI_ProbeFinishInitialization")
+            && Load(dllHandle, api.InterfaceGetRefIds,            "PPI_InterfaceGetRefIds")
+            && Load(dllHandle, api.InterfaceGetType,              "PPI_InterfaceGetType")
+            && Load(dllHandle, api.InterfaceBeginInitialization,  "PPI_InterfaceBeginInitialization")
+            && Load(dllHandle, api.InterfaceFinishInitialization, "PPI_InterfaceFinishInitialization")
+            && Load(dllHandle, api.LockTargetInterface,           "PPI_Lock_Target_Interface")
+            && Load(dllHandle, api.BundleAllocate,                "PPI_Bundle_Allocate")
+            && Load(dllHandle, api.BundleExecute,                 "PPI_Bundle_Execute")
+            && Load(dllHandle, api.BundleClear,                   "PPI_Bundle_Clear")
+            && Load(dllHandle, api.BundleFree,                    "PPI_Bundle_Free")
+            && Load(dllHandle, api.StateIRShift,                  "PPI_JTAG_StateIRShift")
+            && Load(dllHandle, api.StateDRShift,                  "PPI_JTAG_StateDRShift")
+            && Load(dllHandle, api.PinsShift,                     "PPI_JTAG_PinsShift")
+            && Load(dllHandle, api.SlotAllocate,                  "PPI_Slot_Allocate")
+            && Load(dllHandle, api.SlotFree,                      "PPI_Slot_Free")
+            && Load(dllHandle, api.SlotSize,                      "PPI_Slot_Size")
+            && Load(dllHandle, api.SlotComparisonToConstant,      "PPI_Slot_ComparisonToConstant")
+            && Load(dllHandle, api.LoopBreakOnComparisonSuccess,  "PPI_Loop_LoopBreakOnComparisonSuccess")
+            && Load(dllHandle, api.LoopCaptureAll,                "PPI_Loop_CaptureAll")
+            && Load(dllHandle, api.SetInterfacePadding,           "PPI_JTAG_SetInterfacePadding")
+            && Load(dllHandle, api.InterfaceScan,                 "PPI_InterfaceScan")
+            && Load(dllHandle, api.InterfaceOperationCancel,      "PPI_InterfaceOperationCancel");
+    }
+
+    template<typename T>
+    void RequireEqual(const T& actual, const T& expected, std::string_view message)
+    {
+        if (actual != expected)
+        {
+            std::cerr << message << " Got " << actual << " but expected " << expected << ".\n";
+            throw std::runtime_error("");
+        }
+    }
+
+    inline void RequireNoError(OpenIPC_Error error, std::string_view message)
+    {
+        RequireEqual<int>(error, OpenIPC_Error_No_Error, message);
+    }
+
+    // Sets a config of the plugin (deviceId 0) or of one of its devices
+    inline OpenIPC_Error SetConfig(const PluginApi& api, OpenIPC_DeviceId deviceId, const std::string& name, const std::string& value)
+    {
+        PPI_char configValue[PPI_MAX_INFO_LEN] = {};
+        std::strncpy(configValue, value.c_str(), PPI_MAX_INFO_LEN - 1);
+        return api.DeviceSetConfig(deviceId, name.c_str(), configValue);
+    }
+
+    // The plugin, initialized for one test and deinitialized at its end
+    class PluginFixture
+    {
+    protected:
+        const PluginApi& _api;
+    public:
+        explicit PluginFixture(const PluginApi& api) :
+            _api(api)
+        {
+            RequireNoError(api.PluginInitialize(1, ""), "PPI_PluginInitialize failed.");
+        }
+
+        ~PluginFixture()
+        {
+            _api.PluginDeinitialize();
+        }
+
+        PluginFixture(const PluginFixture&) = delete;
+        PluginFixture& operator=(const PluginFixture&) = delete;
+
+        void SetConfig(OpenIPC_DeviceId deviceId, const std::string& name, const std::string& value)
+        {
+            RequireNoError(PluginTest::SetConfig(_api, deviceId, name, value), "PPI_DeviceSetConfig failed for " + name + ".");
+        }
+    };
+}
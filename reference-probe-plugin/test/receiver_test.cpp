@@ -0,0 +1,1088 @@
+/////////////////////////<Source Code Embedded Notices>/////////////////////////
+//
+// INTEL CONFIDENTIAL
+// Copyright (C) Intel Corporation All Rights Reserved.
+//
+// The source code contained or described herein and all documents related to
+// the source code ("Material") are owned by Intel Corporation or its suppliers
+// or licensors. Title to the Material remains with Intel Corporation or its
+// suppliers and licensors. The Material contains trade secrets and proprietary
+// and confidential information of Intel or its suppliers and licensors. The
+// Material is protected by worldwide copyright and trade secret laws and
+// treaty provisions. No part of the Material may be used, copied, reproduced,
+// modified, published, uploaded, posted, transmitted, distributed, or disclosed
+// in any way without Intel's prior express written permission.
+//
+// No license under any patent, copyright, trade secret or other intellectual
+// property right is granted to or conferred upon you by disclosure or delivery
+// of the Materials, either expressly, by implication, inducement, estoppel or
+// otherwise. Any license under such intellectual property rights must be
+// express and approved by Intel in writing.
+//
+/////////////////////////<Source Code Embedded Notices>/////////////////////////
+
+// Receiver tests: drive the plugin's receiver scans (JTAG scans of the DR selected by IR 0x10) against a receiver
+// running in the test, and check what goes over the wire. The receiver answers the requests with the listener's own
+// request handling, so the plugin is checked against the listener's sessions, register model and encoding.
+//
+// Usage: ReferencePlugin_ReceiverTest <plugin>
+
+#include "requests.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <set>
+#include <string>
+#include <exception>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <sstream>
+#include <utility>
+
+#if defined(_WIN32)
+    #include <winsock2.h>
+    #pragma comment(lib, "ws2_32.lib")
+#else
+    #include <csignal>
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <arpa/inet.h>
+    #include <unistd.h>
+#endif
+
+// After winsock2.h, which must come before windows.h
+#include "plugin_test_api.h"
+
+namespace // helpers
+{
+    using namespace PluginTest;
+
+    #if defined(_WIN32)
+        using Socket       = SOCKET;
+        using SocketLength = int;
+        constexpr Socket NoSocket   = INVALID_SOCKET;
+        constexpr int ShutdownBoth  = SD_BOTH;
+        constexpr int SendFlags     = 0;
+
+        void CloseSocket(Socket socket)
+        {
+            ::closesocket(socket);
+        }
+
+        bool ConnectWithin(Socket socket, const sockaddr_in& address, std::chrono::milliseconds timeout)
+        {
+            u_long nonBlocking = 1;
+            ::ioctlsocket(socket, FIONBIO, &nonBlocking);
+            ::connect(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+            WSAPOLLFD pollFd { socket, POLLWRNORM, 0 };
+            return ::WSAPoll(&pollFd, 1, static_cast<INT>(timeout.count())) > 0;
+        }
+    #else
+        using Socket       = int;
+        using SocketLength = socklen_t;
+        constexpr Socket NoSocket   = -1;
+        constexpr int ShutdownBoth  = SHUT_RDWR;
+        constexpr int SendFlags     = MSG_NOSIGNAL;
+
+        void CloseSocket(Socket socket)
+        {
+            ::close(socket);
+        }
+
+        bool ConnectWithin(Socket socket, const sockaddr_in& address, std::chrono::milliseconds timeout)
+        {
+            ::fcntl(socket, F_SETFL, ::fcntl(socket, F_GETFL) | O_NONBLOCK);
+            ::connect(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+            pollfd pollFd { socket, POLLOUT, 0 };
+            return ::poll(&pollFd, 1, static_cast<int>(timeout.count())) > 0;
+        }
+    #endif
+
+    // Text of the first <tag> element of xml, empty if it has none
+    std::string FindElement(const std::string& xml, const std::string& tag)
+    {
+        const auto begin = xml.find("<" + tag + ">");
+        const auto end   = xml.find("</" + tag + ">");
+        if (begin == std::string::npos || end == std::string::npos || end < begin)
+        {
+            return {};
+        }
+        return xml.substr(begin + tag.size() + 2, end - begin - tag.size() - 2);
+    }
+
+    // A receiver listening on a loopback port, answering the requests with the listener's handleRequest. It serves
+    // each connection on a thread of its own, as the listener's receiver does, and records what goes over the wire.
+    // Only one is expected to run at a time: the listener's sessions and receive window are its globals.
+    class FakeReceiver
+    {
+        Socket _listenSocket { NoSocket };
+        uint16_t _port { 0 };
+        std::thread _acceptThread;
+        std::mutex _mutex;
+        std::condition_variable _shiftsChanged;
+        std::vector<Socket> _clients;
+        std::vector<std::thread> _clientThreads;
+        std::vector<Socket> _backlog; // Connects that fill the backlog of a listening socket that stalls connects
+        std::vector<std::string> _requests;         // Every request received, in order
+        std::vector<std::string> _responses;        // And the response to each of them
+        std::vector<std::string> _canceled;         // Ids of the requests the plugin canceled
+        size_t _connections { 0 };
+        size_t _mostRequestsPerReceive { 0 };
+        // The most request bytes a connection had received and not answered yet
+        size_t _mostUnansweredBytes { 0 };
+        // Connections with shift requests being answered, the most there were at once, and how many there have to
+        // be before any of them is answered (until the hold times out)
+        size_t _shiftingConnections { 0 };
+        size_t _mostShiftingConnections { 0 };
+        size_t _holdShiftsFor { 0 };
+        // Set to drop the connection of the next shift request after executing it, and set while it is being dropped
+        bool _dropNextShift { false };
+        bool _dropping { false };
+        size_t _replays { 0 };
+        std::chrono::milliseconds _holdTimeout { 0 };
+        // The responses are held back until this many requests were received
+        size_t _holdResponsesFor { 0 };
+
+    public:
+        // window is the window of request bytes advertised in the responses
+        explicit FakeReceiver(size_t window = 64 * 1024)
+        {
+            receiveWindow = window;
+            #if defined(_WIN32)
+                WSADATA wsaData;
+                WSAStartup(MAKEWORD(2, 2), &wsaData);
+            #endif
+            _listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            sockaddr_in address {};
+            address.sin_family      = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port        = 0; // Any free port
+            SocketLength addressLength = sizeof(address);
+            const int reuse = 1; // For StallConnects to listen on the port again while its connections are open
+            setsockopt(_listenSocket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+            if (_listenSocket == NoSocket
+                || bind(_listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+                || listen(_listenSocket, SOMAXCONN) != 0
+                || getsockname(_listenSocket, reinterpret_cast<sockaddr*>(&address), &addressLength) != 0)
+            {
+                throw std::runtime_error("The receiver couldn't listen.");
+            }
+            _port = ntohs(address.sin_port);
+            _acceptThread = std::thread([this] { _accept(); });
+        }
+
+        ~FakeReceiver()
+        {
+            shutdown(_listenSocket, ShutdownBoth);
+            CloseSocket(_listenSocket);
+            if (_acceptThread.joinable())
+            {
+                _acceptThread.join();
+            }
+            for (const auto socket : _backlog)
+            {
+                CloseSocket(socket);
+            }
+            {
+                std::lock_guard lock(_mutex);
+                for (const auto client : _clients)
+                {
+                    shutdown(client, ShutdownBoth);
+                }
+                _holdShiftsFor = 0;
+            }
+            _shiftsChanged.notify_all();
+            for (auto& clientThread : _clientThreads)
+            {
+                clientThread.join();
+            }
+            #if defined(_WIN32)
+                WSACleanup();
+            #endif
+        }
+
+        FakeReceiver(const FakeReceiver&) = delete;
+        FakeReceiver& operator=(const FakeReceiver&) = delete;
+
+        // "127.0.0.1:port", for SVEPlugin.ReceiverEndpoints
+        std::string Endpoint() const
+        {
+            return "127.0.0.1:" + std::to_string(_port);
+        }
+
+        std::vector<std::string> Requests()
+        {
+            std::lock_guard lock(_mutex);
+            return _requests;
+        }
+
+        std::vector<std::string> Responses()
+        {
+            std::lock_guard lock(_mutex);
+            return _responses;
+        }
+
+        std::vector<std::string> Canceled()
+        {
+            std::lock_guard lock(_mutex);
+            return _canceled;
+        }
+
+        size_t ShiftingConnections()
+        {
+            std::lock_guard lock(_mutex);
+            return _shiftingConnections;
+        }
+
+        size_t Connections()
+        {
+            std::lock_guard lock(_mutex);
+            return _connections;
+        }
+
+        // The most requests that came in one receive, as when they were sent in one batch
+        size_t MostRequestsPerReceive()
+        {
+            std::lock_guard lock(_mutex);
+            return _mostRequestsPerReceive;
+        }
+
+        // Requests answered with the response they got before
+        size_t Replays()
+        {
+            std::lock_guard lock(_mutex);
+            return _replays;
+        }
+
+        // The next shift request is executed, but its connection is closed instead of answering it
+        void DropNextShift()
+        {
+            std::lock_guard lock(_mutex);
+            _dropNextShift = true;
+        }
+
+        size_t MostUnansweredBytes()
+        {
+            std::lock_guard lock(_mutex);
+            return _mostUnansweredBytes;
+        }
+
+        size_t MostShiftingConnections()
+        {
+            std::lock_guard lock(_mutex);
+            return _mostShiftingConnections;
+        }
+
+        // Holds back the responses to shift requests until that many connections are waiting for theirs, or the
+        // timeout passes. Only requests sent on connections of their own get past it together.
+        void HoldShiftsUntil(size_t connections, std::chrono::milliseconds timeout)
+        {
+            {
+                std::lock_guard lock(_mutex);
+                _holdShiftsFor = connections;
+                _holdTimeout   = timeout;
+            }
+            _shiftsChanged.notify_all();
+        }
+
+        // Holds back the responses until the receiver got that many requests, in all. A plugin that waits for a
+        // response before sending its next request only gets it back once its request times out.
+        void HoldResponsesUntil(size_t requests)
+        {
+            std::lock_guard lock(_mutex);
+            _holdResponsesFor = requests;
+        }
+
+        // New connects to the receiver hang: the listening socket is replaced by one that never accepts, with its
+        // backlog filled. The connections made before are still served. Only where a connect past a full backlog
+        // is left pending rather than refused, as on Linux.
+        void StallConnects()
+        {
+            shutdown(_listenSocket, ShutdownBoth);
+            CloseSocket(_listenSocket);
+            _acceptThread.join();
+            _listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            sockaddr_in address {};
+            address.sin_family      = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port        = htons(_port);
+            const int reuse = 1;
+            setsockopt(_listenSocket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+            if (bind(_listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(_listenSocket, 0) != 0)
+            {
+                throw std::runtime_error("The receiver couldn't listen again.");
+            }
+            for (bool isConnected = true; isConnected && _backlog.size() < 8;)
+            {
+                isConnected = ConnectWithin(_backlog.emplace_back(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)), address, std::chrono::milliseconds(50));
+            }
+        }
+
+    private:
+        void _accept()
+        {
+            while (true)
+            {
+                const Socket client = accept(_listenSocket, nullptr, nullptr);
+                if (client == NoSocket)
+                {
+                    return;
+                }
+                std::lock_guard lock(_mutex);
+                _connections++;
+                _clients.push_back(client);
+                _clientThreads.emplace_back([this, client] { _serve(client); });
+            }
+        }
+
+        // Requests are cut out of the received bytes at each </request>, and the responses to the requests of one
+        // receive are sent back together, as the listener's receiver does
+        void _serve(Socket client)
+        {
+            static constexpr std::string_view requestEnd = "</request>";
+            std::string pending;
+            std::string responses;
+            std::set<std::string> clientSessions; // The sessions that sent requests on this connection
+            char buffer[4096];
+            while (true)
+            {
+                const int count = recv(client, buffer, sizeof(buffer), 0);
+                if (count <= 0)
+                {
+                    break;
+                }
+                pending.append(buffer, static_cast<size_t>(count));
+                {
+                    std::lock_guard lock(_mutex);
+                    _mostUnansweredBytes = std::max(_mostUnansweredBytes, pending.size());
+                }
+                std::vector<std::string> requests;
+                for (auto end = pending.find(requestEnd); end != std::string::npos; end = pending.find(requestEnd))
+                {
+                    requests.push_back(pending.substr(0, end + requestEnd.size()));
+                    pending.erase(0, end + requestEnd.size());
+                }
+                {
+                    std::lock_guard lock(_mutex);
+                    _mostRequestsPerReceive = std::max(_mostRequestsPerReceive, requests.size());
+                }
+                const bool isShifting = std::any_of(requests.begin(), requests.end(), [](const std::string& request)
+                                                    {
+                                                        return FindElement(request, "initialize") == "False";
+                                                    });
+                if (isShifting)
+                {
+                    _beginShifting();
+                }
+                for (const auto& request : requests)
+                {
+                    responses += _handleRequest(request, clientSessions);
+                }
+                if (isShifting)
+                {
+                    _endShifting();
+                }
+                {
+                    std::lock_guard lock(_mutex);
+                    if (std::exchange(_dropping, false))
+                    {
+                        break;
+                    }
+                    if (_requests.size() < _holdResponsesFor)
+                    {
+                        continue;
+                    }
+                }
+                for (size_t sent = 0; sent < responses.size();)
+                {
+                    const int sentCount = send(client, responses.data() + sent, static_cast<int>(responses.size() - sent), SendFlags);
+                    if (sentCount <= 0)
+                    {
+                        break;
+                    }
+                    sent += static_cast<size_t>(sentCount);
+                }
+                responses.clear();
+            }
+            releaseSessions(clientSessions);
+            shutdown(client, ShutdownBoth);
+            std::lock_guard lock(_mutex);
+            _clients.erase(std::remove(_clients.begin(), _clients.end(), client), _clients.end());
+            CloseSocket(client);
+        }
+
+        void _beginShifting()
+        {
+            std::unique_lock lock(_mutex);
+            _shiftingConnections++;
+            _mostShiftingConnections = std::max(_mostShiftingConnections, _shiftingConnections);
+            _shiftsChanged.notify_all();
+            _shiftsChanged.wait_for(lock, _holdTimeout, [this] { return _shiftingConnections >= _holdShiftsFor; });
+        }
+
+        void _endShifting()
+        {
+            std::lock_guard lock(_mutex);
+            _shiftingConnections--;
+        }
+
+        std::string _handleRequest(const std::string& request, std::set<std::string>& clientSessions)
+        {
+            std::ostringstream log;
+            auto response = handleRequest(request, log, clientSessions);
+            std::lock_guard lock(_mutex);
+            _requests.push_back(request);
+            _responses.push_back(response);
+            if (log.str().find("Replayed response") != std::string::npos)
+            {
+                _replays++;
+            }
+            std::stringstream canceled(FindElement(request, "cancel"));
+            for (std::string id; std::getline(canceled, id, ',');)
+            {
+                _canceled.push_back(id.substr(id.find_first_not_of(' ')));
+            }
+            if (FindElement(request, "initialize") == "False")
+            {
+                _dropping = std::exchange(_dropNextShift, false) || _dropping;
+            }
+            return response;
+        }
+    };
+
+    // The plugin, initialized for one test, with the probe it discovered on the receiver and both of that probe's
+    // JTAG interfaces initialized
+    class ReceiverFixture : public PluginFixture
+    {
+    public:
+        static constexpr OpenIPC_DeviceId ProbeDeviceId    = 10;
+        static constexpr OpenIPC_DeviceId JtagDeviceIds[2] = { 100, 101 };
+
+        ReceiverFixture(const PluginApi& api, const FakeReceiver& receiver) :
+            PluginFixture(api)
+        {
+            SetConfig(0, "SVEPlugin.ReceiverEndpoints", receiver.Endpoint());
+            PPI_RefId probeRefIds[16];
+            uint32_t probeCount = 0;
+            RequireNoError(api.ProbeGetRefIds(16, probeRefIds, &probeCount), "PPI_ProbeGetRefIds failed.");
+            RequireEqual(probeCount, 2u, "The probe on the receiver wasn't discovered.");
+            RequireNoError(api.ProbeBeginInitialization(probeRefIds[1], ProbeDeviceId), "PPI_ProbeBeginInitialization failed.");
+            RequireNoError(api.ProbeFinishInitialization(ProbeDeviceId), "The handshake with the receiver failed.");
+            PPI_RefId interfaceRefIds[16];
+            uint32_t interfaceCount = 0;
+            RequireNoError(api.InterfaceGetRefIds(ProbeDeviceId, 16, interfaceRefIds, &interfaceCount), "PPI_InterfaceGetRefIds failed.");
+            for (uint32_t index = 0; index < 2; index++)
+            {
+                RequireNoError(api.InterfaceBeginInitialization(ProbeDeviceId, interfaceRefIds[index], JtagDeviceIds[index]), "PPI_InterfaceBeginInitialization failed.");
+                RequireNoError(api.InterfaceFinishInitialization(JtagDeviceIds[index]), "PPI_InterfaceFinishInitialization failed.");
+            }
+        }
+
+        // Selects the receiver's data register and shifts up to 32 bits through it, returning its TDO
+        uint32_t ShiftReceiver(OpenIPC_DeviceId jtagDeviceId, uint32_t bitCount, uint32_t tdi)
+        {
+            uint32_t tdo = 0;
+            RequireNoError(TryShiftReceiver(jtagDeviceId, bitCount, tdi, tdo), "The receiver scan failed.");
+            return tdo;
+        }
+
+        // As ShiftReceiver, returning the error of the bundle
+        OpenIPC_Error TryShiftReceiver(OpenIPC_DeviceId jtagDeviceId, uint32_t bitCount, uint32_t tdi, uint32_t& tdo)
+        {
+            const uint8_t receiverInstruction = 0x10;
+            const uint8_t tdiBytes[4] = { static_cast<uint8_t>(tdi), static_cast<uint8_t>(tdi >> 8),
+                                          static_cast<uint8_t>(tdi >> 16), static_cast<uint8_t>(tdi >> 24) };
+            uint8_t tdoBytes[4] = {};
+            auto bundle = _api.BundleAllocate();
+            RequireNoError(_api.StateIRShift(bundle, 8, &receiverInstruction, nullptr, nullptr), "PPI_JTAG_StateIRShift failed.");
+            RequireNoError(_api.StateDRShift(bundle, bitCount, tdiBytes, tdoBytes, nullptr), "PPI_JTAG_StateDRShift failed.");
+            const auto error = _api.BundleExecute(bundle, jtagDeviceId, 0);
+            _api.BundleFree(&bundle);
+            tdo = tdoBytes[0] | (tdoBytes[1] << 8) | (tdoBytes[2] << 16) | (static_cast<uint32_t>(tdoBytes[3]) << 24);
+            return error;
+        }
+    };
+}
+
+// The handshake initializes the probe's register on the receiver, and the receiver's register is shifted as the
+// plugin's TAP registers are: an exact shift swaps the value, and an under-shift moves the register down by the
+// shifted bits, filling its top with the TDI.
+int TestReceiverRegister(const PluginApi& api)
+{
+    FakeReceiver receiver;
+    ReceiverFixture fixture(api, receiver);
+    const auto handshake = receiver.Requests().at(0);
+    RequireEqual(FindElement(handshake, "initialize"), std::string("True"), "The handshake didn't initialize the register.");
+    RequireEqual(FindElement(handshake, "size"), std::string("32"), "The handshake initialized a register of the wrong size.");
+
+    const auto jtag = ReceiverFixture::JtagDeviceIds[0];
+    RequireEqual(fixture.ShiftReceiver(jtag, 32, 0x87654321), 0u, "The initialized register wasn't 0.");
+    RequireEqual(fixture.ShiftReceiver(jtag, 32, 0xA5A5A5A5), 0x87654321u, "The register didn't keep the shifted value.");
+    RequireEqual(fixture.ShiftReceiver(jtag, 8, 0xFF), 0xA5u, "The under-shift didn't shift the register's low bits out.");
+    RequireEqual(fixture.ShiftReceiver(jtag, 32, 0), 0xFFA5A5A5u, "The under-shift didn't fill the top of the register.");
+    return 0;
+}
+
+// Bundles executing on the probe's two JTAG interfaces at once each get a channel of their own, so the receiver
+// has requests waiting on two connections at the same time.
+int TestChannelPerBundle(const PluginApi& api)
+{
+    FakeReceiver receiver;
+    ReceiverFixture fixture(api, receiver);
+    receiver.HoldShiftsUntil(2, std::chrono::seconds(5));
+    std::vector<std::thread> threads;
+    std::vector<std::string> errors(2);
+    for (size_t index = 0; index < 2; index++)
+    {
+        threads.emplace_back([&, index]
+                             {
+                                 try
+                                 {
+                                     fixture.ShiftReceiver(ReceiverFixture::JtagDeviceIds[index], 32, 0);
+                                 }
+                                 catch (const std::exception&)
+                                 {
+                                     errors[index] = "The receiver scan of interface " + std::to_string(index) + " failed.";
+                                 }
+                             });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    RequireEqual(errors[0] + errors[1], std::string(), "A bundle failed.");
+    RequireEqual(receiver.MostShiftingConnections(), size_t(2), "The bundles didn't run on channels of their own.");
+    RequireEqual(receiver.Connections(), size_t(2), "The bundles didn't reuse the handshake's connection.");
+    return 0;
+}
+
+// The handshake negotiates RunLength compression. Byte lists then carry runs, and a scan repeated with the same TDI
+// on an interface (like a polled register) is answered with its delta from the last TDO, or as unchanged, which the
+// plugin turns back into the TDO.
+int TestCompressedReceiverScans(const PluginApi& api)
+{
+    FakeReceiver receiver;
+    ReceiverFixture fixture(api, receiver);
+    RequireEqual(FindElement(receiver.Requests().at(0), "compression"), std::string("RunLength"), "The handshake didn't offer compression.");
+
+    const auto poll = ReceiverFixture::JtagDeviceIds[0];
+    const auto set  = ReceiverFixture::JtagDeviceIds[1];
+    RequireEqual(fixture.ShiftReceiver(poll, 32, 0), 0u, "The first poll read the wrong TDO.");
+    const auto firstPoll = receiver.Requests().back();
+    RequireEqual(FindElement(firstPoll, "input"), std::string("0x00*4"), "The TDI wasn't sent as a run.");
+    RequireEqual(FindElement(firstPoll, "deltaBase"), std::string(), "The first poll named a base.");
+
+    fixture.ShiftReceiver(set, 32, 0x11223344);
+    RequireEqual(fixture.ShiftReceiver(poll, 32, 0), 0x11223344u, "The second poll read the wrong TDO.");
+    const auto secondPoll = receiver.Requests().size() - 1;
+    fixture.ShiftReceiver(set, 32, 0x11223345);
+    RequireEqual(fixture.ShiftReceiver(poll, 32, 0), 0x11223345u, "The TDO wasn't rebuilt from the delta.");
+    RequireEqual(FindElement(receiver.Requests().back(), "deltaKey"), FindElement(firstPoll, "deltaKey"), "The poll's delta key changed.");
+    RequireEqual(FindElement(receiver.Requests().back(), "deltaBase"), FindElement(receiver.Requests().at(secondPoll), "request_id"),
+                 "The poll didn't name the last poll as its base.");
+    RequireEqual(FindElement(receiver.Responses().back(), "delta"), std::string("0x01, 0x00*3"), "The receiver didn't send the delta.");
+
+    RequireEqual(fixture.ShiftReceiver(poll, 32, 0), 0u, "The fourth poll read the wrong TDO.");
+    RequireEqual(fixture.ShiftReceiver(poll, 32, 0), 0u, "The TDO wasn't kept for an unchanged response.");
+    RequireEqual(FindElement(receiver.Responses().back(), "unchanged"), std::string("True"), "The receiver didn't answer unchanged.");
+    return 0;
+}
+
+// The receiver scans of a PPI_InterfaceScan stream are queued, not exchanged one at a time: they reach the receiver
+// together, and their TDO payloads are written in the order of the stream once all of them are answered.
+int TestReceiverScanStream(const PluginApi& api)
+{
+    FakeReceiver receiver;
+    ReceiverFixture fixture(api, receiver);
+    const auto jtag = ReceiverFixture::JtagDeviceIds[0];
+    fixture.SetConfig(jtag, "Receiver.CoalesceWindowUs", "1000000");
+    const uint32_t captureDr = 0x03 | (0x01 << 8);
+    const uint32_t input[] = { 0x02, 8, 0x10,
+                               captureDr, 32, 0x11111111,
+                               0x03, 32, 0x22222222,
+                               captureDr, 32, 0x33333333,
+                               captureDr, 32, 0 };
+    uint32_t output[3] = {};
+    uint32_t outputDwords = 0;
+    RequireNoError(api.InterfaceScan(jtag, input, sizeof(input) / sizeof(input[0]), output, 3, &outputDwords), "PPI_InterfaceScan failed.");
+    RequireEqual(outputDwords, 3u, "Wrong output size of the stream.");
+    RequireEqual(output[0], 0u, "Wrong TDO of the stream's first receiver scan.");
+    RequireEqual(output[1], 0x22222222u, "Wrong TDO of the stream's third receiver scan.");
+    RequireEqual(output[2], 0x33333333u, "Wrong TDO of the stream's last receiver scan.");
+    RequireEqual(receiver.MostRequestsPerReceive(), size_t(4), "The stream's receiver scans weren't queued.");
+    return 0;
+}
+
+// A PPI_InterfaceScan stream that fails after a queued receiver scan still completes the scan before returning, and
+// the next stream's receiver scans are answered in step.
+int TestFailedScanStream(const PluginApi& api)
+{
+    FakeReceiver receiver;
+    ReceiverFixture fixture(api, receiver);
+    const auto jtag = ReceiverFixture::JtagDeviceIds[0];
+    fixture.SetConfig(jtag, "Receiver.CoalesceWindowUs", "1000000");
+    const uint32_t captureDr = 0x03 | (0x01 << 8);
+    const uint32_t failing[] = { 0x02, 8, 0x10,
+                                 captureDr, 32, 0x11111111,
+                                 0xFF, 0 };
+    uint32_t output[1] = {};
+    uint32_t outputDwords = 0;
+    RequireEqual<int>(api.InterfaceScan(jtag, failing, sizeof(failing) / sizeof(failing[0]), output, 1, &outputDwords),
+                      OpenIPC_Error_Probe_Invalid_Parameter, "The stream with a bad opcode didn't fail.");
+    const uint32_t input[] = { captureDr, 32, 0x22222222 };
+    RequireNoError(api.InterfaceScan(jtag, input, sizeof(input) / sizeof(input[0]), output, 1, &outputDwords), "PPI_InterfaceScan failed.");
+    RequireEqual(output[0], 0x11111111u, "Wrong TDO of the receiver scan after the failed stream.");
+    return 0;
+}
+
+// A PPI_InterfaceScan stream is forwarded to the receiver as one batch, even when the coalescing would send a
+// bundle's receiver scans one at a time.
+int TestScanStreamBatch(const PluginApi& api)
+{
+    FakeReceiver receiver;
+    ReceiverFixture fixture(api, receiver);
+    const auto jtag = ReceiverFixture::JtagDeviceIds[0];
+    fixture.SetConfig(jtag, "Receiver.CoalesceWindowUs", "0");
+    std::vector<uint32_t> input { 0x02, 8, 0x10 };
+    for (uint32_t scan = 0; scan < 16; scan++)
+    {
+        input.insert(input.end(), { 0x03 | (0x01 << 8), 32, scan });
+    }
+    uint32_t output[16] = {};
+    uint32_t outputDwords = 0;
+    RequireNoError(api.InterfaceScan(jtag, input.data(), static_cast<uint32_t>(input.size()), output, 16, &outputDwords), "PPI_InterfaceScan failed.");
+    RequireEqual(outputDwords, 16u, "Wrong output size of the stream.");
+    RequireEqual(output[15], 14u, "Wrong TDO of the stream's last receiver scan.");
+    RequireEqual(receiver.MostRequestsPerReceive(), size_t(16), "The stream wasn't sent as one batch.");
+    return 0;
+}
+
+// With a receiver window that only takes one request at a time, a stream's queued receiver scans wait for each
+// other's responses instead of going over the window.
+int TestSmallReceiveWindow(const PluginApi& api)
+{
+    FakeReceiver receiver(300);
+    ReceiverFixture fixture(api, receiver);
+    const auto jtag = ReceiverFixture::JtagDeviceIds[0];
+    std::vector<uint32_t> input { 0x02, 8, 0x10 };
+    for (uint32_t scan = 0; scan < 16; scan++)
+    {
+        input.insert(input.end(), { 0x03 | (0x01 << 8), 32, scan });
+    }
+    uint32_t output[16] = {};
+    uint32_t outputDwords = 0;
+    RequireNoError(api.InterfaceScan(jtag, input.data(), static_cast<uint32_t>(input.size()), output, 16, &outputDwords), "PPI_InterfaceScan failed.");
+    for (uint32_t scan = 1; scan < 16; scan++)
+    {
+        RequireEqual(output[scan], scan - 1, "Wrong TDO of a receiver scan.");
+    }
+    RequireEqual(receiver.MostUnansweredBytes() <= 300, true, "The requests went over the receiver's window.");
+    RequireEqual(receiver.MostRequestsPerReceive(), size_t(1), "The requests weren't sent one at a time.");
+    return 0;
+}
+
+// With Receiver.FlowControl set to FailFast, a receiver scan that doesn't fit in the window fails the bundle, and
+// the TDO of the scans queued before it is still written back.
+int TestFailFastFlowControl(const PluginApi& api)
+{
+    FakeReceiver receiver(300);
+    ReceiverFixture fixture(api, receiver);
+    const auto jtag = ReceiverFixture::JtagDeviceIds[0];
+    fixture.SetConfig(jtag, "Receiver.FlowControl", "FailFast");
+    fixture.ShiftReceiver(jtag, 32, 0x12345678);
+
+    const uint8_t receiverInstruction = 0x10;
+    const uint8_t tdi[4] = {};
+    uint8_t firstTdo[4] = { 0xEE, 0xEE, 0xEE, 0xEE };
+    uint8_t secondTdo[4] = { 0xEE, 0xEE, 0xEE, 0xEE };
+    auto bundle = api.BundleAllocate();
+    RequireNoError(api.StateIRShift(bundle, 8, &receiverInstruction, nullptr, nullptr), "PPI_JTAG_StateIRShift failed.");
+    RequireNoError(api.StateDRShift(bundle, 32, tdi, firstTdo, nullptr), "PPI_JTAG_StateDRShift failed.");
+    RequireNoError(api.StateDRShift(bundle, 32, tdi, secondTdo, nullptr), "PPI_JTAG_StateDRShift failed.");
+    const auto error = api.BundleExecute(bundle, jtag, 0);
+    api.BundleFree(&bundle);
+    RequireEqual<int>(error, OpenIPC_Error_Probe_Connection_Transient_Error, "The scan past the window didn't fail the bundle.");
+    RequireEqual(firstTdo[0] | (firstTdo[1] << 8) | (firstTdo[2] << 16) | (static_cast<uint32_t>(firstTdo[3]) << 24), 0x12345678u,
+                 "The TDO of the scan queued before the full window wasn't written back.");
+    RequireEqual<int>(secondTdo[0], 0xEE, "The failed scan wrote TDO back.");
+    return 0;
+}
+
+// A channel whose connection drops reconnects and sends its unanswered requests again. The receiver answers a
+// request it already executed with the response it sent before, so the register isn't shifted twice.
+int TestReconnectReplay(const PluginApi& api)
+{
+    FakeReceiver receiver;
+    ReceiverFixture fixture(api, receiver);
+    const auto jtag = ReceiverFixture::JtagDeviceIds[0];
+    RequireEqual(fixture.ShiftReceiver(jtag, 32, 0x11111111), 0u, "Wrong TDO of the first receiver scan.");
+    receiver.DropNextShift();
+    RequireEqual(fixture.ShiftReceiver(jtag, 32, 0x22222222), 0x11111111u, "Wrong TDO of the receiver scan whose connection dropped.");
+    RequireEqual(receiver.Connections(), size_t(2), "The channel didn't reconnect.");
+    RequireEqual(receiver.Replays(), size_t(1), "The request wasn't sent again.");
+    RequireEqual(fixture.ShiftReceiver(jtag, 32, 0), 0x22222222u, "The replayed request shifted the register again.");
+    return 0;
+}
+
+// A receiver scan longer than a streamed chunk is sent as chunks that each take a part of the receiver's window. The
+// chunks after the first are sent before the first is answered, and the TDO of all of them is written back around
+// the interface's padding, or into a PPI_InterfaceScan stream's output.
+int TestStreamedReceiverScan(const PluginApi& api)
+{
+    FakeReceiver receiver;
+    ReceiverFixture fixture(api, receiver);
+    const auto jtag = ReceiverFixture::JtagDeviceIds[0];
+    fixture.SetConfig(jtag, "Receiver.CoalesceWindowUs", "0");
+    fixture.SetConfig(jtag, "Receiver.RequestTimeoutMs", "5000");
+    fixture.ShiftReceiver(jtag, 32, 0x12345678);
+    RequireNoError(api.SetInterfacePadding(jtag, 0, 0, 5, 3, 1), "PPI_JTAG_SetInterfacePadding failed.");
+
+    const uint32_t bitCount = 512 * 1024 + 1001;
+    std::vector<uint8_t> tdi((bitCount + 7) / 8);
+    for (size_t index = 0; index < tdi.size(); index++)
+    {
+        tdi[index] = static_cast<uint8_t>(index * 7 + 3);
+    }
+    std::vector<uint8_t> tdo(tdi.size(), 0);
+    const auto firstRequest = receiver.Requests().size();
+    receiver.HoldResponsesUntil(firstRequest + 3);
+    const uint8_t receiverInstruction = 0x10;
+    auto bundle = api.BundleAllocate();
+    RequireNoError(api.StateIRShift(bundle, 8, &receiverInstruction, nullptr, nullptr), "PPI_JTAG_StateIRShift failed.");
+    RequireNoError(api.StateDRShift(bundle, bitCount, tdi.data(), tdo.data(), nullptr), "PPI_JTAG_StateDRShift failed.");
+    const auto error = api.BundleExecute(bundle, jtag, 0);
+    api.BundleFree(&bundle);
+    RequireNoError(error, "The streamed receiver scan failed.");
+
+    // The receiver's 32 bit register shifts out its value, then the TAP's TDI: the near TDI padding's 0's, the
+    // near TDO padding's 1's and the scan
+    const auto bit = [](const std::vector<uint8_t>& bits, size_t index) { return (bits[index / 8] >> (index % 8)) & 1; };
+    for (size_t index = 0; index < bitCount; index++)
+    {
+        const int expected = index < 32 ? (0x12345678u >> index) & 1 : index < 37 ? 0 : index < 40 ? 1 : bit(tdi, index - 40);
+        if (bit(tdo, index) != expected)
+        {
+            RequireEqual(bit(tdo, index), expected, "Wrong TDO of the streamed receiver scan at bit " + std::to_string(index) + ".");
+        }
+    }
+    const auto requests = receiver.Requests();
+    RequireEqual(requests.size() - firstRequest > 3, true, "The scan wasn't sent as chunks.");
+    for (size_t index = firstRequest; index < requests.size(); index++)
+    {
+        RequireEqual(requests[index].size() <= 64 * 1024 / 4 + 256, true, "A chunk took more than its part of the window.");
+    }
+
+    // A PPI_InterfaceScan stream's long receiver scan is sent as chunks the same way
+    const auto firstStreamRequest = receiver.Requests().size();
+    receiver.HoldResponsesUntil(firstStreamRequest + 3);
+    const uint32_t fillOnes = 0x03 | ((0x01 | 0x04 | 0x08) << 8);
+    const uint32_t input[] = { 0x02, 8, 0x10,
+                               fillOnes, bitCount,
+                               0x03 | (0x01 << 8), 32, 0 };
+    const uint32_t scanDwords = (bitCount + 31) / 32;
+    std::vector<uint32_t> output(scanDwords + 1, 0);
+    uint32_t outputDwords = 0;
+    RequireNoError(api.InterfaceScan(jtag, input, sizeof(input) / sizeof(input[0]), output.data(), static_cast<uint32_t>(output.size()), &outputDwords),
+                   "PPI_InterfaceScan failed.");
+    RequireEqual(outputDwords, scanDwords + 1, "Wrong output size of the stream.");
+    RequireEqual(output[1], 0xFFFFFFFFu, "Wrong TDO of the stream's long receiver scan.");
+    RequireEqual(output[scanDwords - 1], 0xFFFFFFFFu >> (32 * scanDwords - bitCount), "Wrong TDO of the end of the stream's long receiver scan.");
+    RequireEqual(output[scanDwords], 0xFFFFFFFFu, "Wrong TDO of the receiver scan after the long one.");
+    RequireEqual(receiver.Requests().size() - firstStreamRequest > 3, true, "The stream's scan wasn't sent as chunks.");
+    return 0;
+}
+
+// Against a receiver that stalls, a receiver scan fails once Receiver.RequestTimeoutMs passes, and the receiver is
+// asked to drop the request. PPI_InterfaceOperationCancel aborts the bundle waiting on the receiver and the bundle
+// waiting for the interface behind it, but not the bundles executed after it.
+int TestTimeoutAndCancel(const PluginApi& api)
+{
+    static constexpr OpenIPC_Error CanceledError = OpenIPC_Error_Operation_Invalid;
+    FakeReceiver receiver;
+    ReceiverFixture fixture(api, receiver);
+    const auto jtag = ReceiverFixture::JtagDeviceIds[0];
+    const auto waitFor = [](auto condition)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!condition() && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return condition();
+    };
+    uint32_t tdo = 0;
+    receiver.HoldShiftsUntil(100, std::chrono::seconds(30));
+
+    fixture.SetConfig(jtag, "Receiver.RequestTimeoutMs", "200");
+    const auto start = std::chrono::steady_clock::now();
+    RequireEqual<int>(fixture.TryShiftReceiver(jtag, 32, 0, tdo), OpenIPC_Error_Probe_Request_Timeout, "The stalled receiver scan didn't time out.");
+    RequireEqual(std::chrono::steady_clock::now() - start < std::chrono::seconds(5), true, "The timeout took too long.");
+    RequireEqual(waitFor([&] { return !receiver.Canceled().empty(); }), true, "The timed out request wasn't canceled.");
+    RequireEqual<size_t>(receiver.Canceled().size(), 1, "Requests besides the timed out one were canceled.");
+
+    fixture.SetConfig(jtag, "Receiver.RequestTimeoutMs", "0");
+    const auto stalled = receiver.ShiftingConnections();
+    OpenIPC_Error errors[2] = { OpenIPC_Error_No_Error, OpenIPC_Error_No_Error };
+    std::thread executing([&] { uint32_t unused = 0; errors[0] = fixture.TryShiftReceiver(jtag, 32, 0, unused); });
+    const bool reachedReceiver = waitFor([&] { return receiver.ShiftingConnections() > stalled; });
+    std::thread waiting([&] { uint32_t unused = 0; errors[1] = fixture.TryShiftReceiver(jtag, 32, 0, unused); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50)); // For it to wait for the interface
+    const auto cancelError = api.InterfaceOperationCancel(jtag);
+    executing.join();
+    waiting.join();
+    RequireEqual(reachedReceiver, true, "The receiver scan didn't reach the receiver.");
+    RequireNoError(cancelError, "PPI_InterfaceOperationCancel failed.");
+    RequireEqual<int>(errors[0], CanceledError, "The bundle waiting on the receiver wasn't canceled.");
+    RequireEqual<int>(errors[1], CanceledError, "The bundle waiting for the interface wasn't canceled.");
+
+    receiver.HoldShiftsUntil(0, std::chrono::milliseconds(0));
+    RequireNoError(fixture.TryShiftReceiver(jtag, 32, 0, tdo), "The bundle executed after the cancel failed.");
+    return 0;
+}
+
+// A polling loop whose receiver scan times out stops with the timeout, unless it continues on timeout errors: then
+// each iteration polls again on a channel of its own, and the loop ends after its last iteration.
+int TestLoopTimeout(const PluginApi& api)
+{
+    FakeReceiver receiver;
+    ReceiverFixture fixture(api, receiver);
+    const auto jtag = ReceiverFixture::JtagDeviceIds[0];
+    fixture.SetConfig(jtag, "Receiver.RequestTimeoutMs", "100");
+    receiver.HoldShiftsUntil(100, std::chrono::seconds(30));
+
+    const uint8_t receiverInstruction = 0x10;
+    const uint8_t allOnes[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+    auto body = api.BundleAllocate();
+    auto slot = api.SlotAllocate(body, 32);
+    PPI_JTAG_StateShiftOptions saveToSlot { JtagOption_TDO_Save_To_Slot, slot };
+    PPI_bool matched = 0;
+    RequireNoError(api.StateIRShift(body, 8, &receiverInstruction, nullptr, nullptr), "PPI_JTAG_StateIRShift failed.");
+    RequireNoError(api.StateDRShift(body, 32, nullptr, nullptr, &saveToSlot), "PPI_JTAG_StateDRShift failed.");
+    RequireNoError(api.SlotComparisonToConstant(body, slot, 32, allOnes, allOnes, &matched, nullptr), "PPI_Slot_ComparisonToConstant failed.");
+
+    const auto runLoop = [&](PPI_bool continueOnTimeoutError)
+    {
+        PPI_Loop_LoopWithBreakOptions options { continueOnTimeoutError };
+        auto loop = api.BundleAllocate();
+        RequireNoError(api.LoopBreakOnComparisonSuccess(loop, body, 3, &options), "PPI_Loop_LoopBreakOnComparisonSuccess failed.");
+        const auto error = api.BundleExecute(loop, jtag, 0);
+        api.BundleFree(&loop);
+        return error;
+    };
+    const auto waitForCanceled = [&](size_t count)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (receiver.Canceled().size() < count && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return receiver.Canceled().size();
+    };
+    RequireEqual<int>(runLoop(0), OpenIPC_Error_Probe_Request_Timeout, "The loop didn't stop with the timeout.");
+    RequireEqual<int>(matched, 0, "The comparison ran on the TDO of the timed out scan.");
+    RequireEqual(waitForCanceled(1), size_t(1), "The loop didn't cancel exactly its one timed out request.");
+    RequireNoError(runLoop(1), "The loop continuing on timeouts failed.");
+    RequireEqual(waitForCanceled(4), size_t(4), "The loop didn't poll again after each timeout.");
+    api.SlotFree(&slot);
+    api.BundleFree(&body);
+    return 0;
+}
+
+// A polling loop is evaluated by the receiver in one request: it runs the body's receiver scans until an iteration's
+// comparison matches, or the iteration cap, and sends back the TDO of the last iteration only.
+int TestReceiverLoop(const PluginApi& api)
+{
+    FakeReceiver receiver;
+    ReceiverFixture fixture(api, receiver);
+    const auto jtag = ReceiverFixture::JtagDeviceIds[0];
+    const auto handshakeResponse = receiver.Responses().at(0);
+    RequireEqual(FindElement(handshakeResponse, "loops"), std::string("True"), "The receiver didn't accept loops.");
+
+    const uint8_t receiverInstruction = 0x10;
+    const uint8_t allOnes = 0xFF;
+    const auto runLoop = [&](uint8_t tdi, uint32_t maxNumberOfIterations, PPI_bool& matched)
+    {
+        uint8_t tdo = 0x5A;
+        auto body = api.BundleAllocate();
+        auto slot = api.SlotAllocate(body, 8);
+        PPI_JTAG_StateShiftOptions saveToSlot { JtagOption_TDO_Save_To_Slot, slot };
+        RequireNoError(api.StateIRShift(body, 8, &receiverInstruction, nullptr, nullptr), "PPI_JTAG_StateIRShift failed.");
+        RequireNoError(api.StateDRShift(body, 8, &tdi, &tdo, &saveToSlot), "PPI_JTAG_StateDRShift failed.");
+        RequireNoError(api.SlotComparisonToConstant(body, slot, 8, &allOnes, &tdi, &matched, nullptr), "PPI_Slot_ComparisonToConstant failed.");
+        auto loop = api.BundleAllocate();
+        RequireNoError(api.LoopBreakOnComparisonSuccess(loop, body, maxNumberOfIterations, nullptr), "PPI_Loop_LoopBreakOnComparisonSuccess failed.");
+        RequireNoError(api.BundleExecute(loop, jtag, 0), "The loop failed.");
+        api.BundleFree(&loop);
+        api.SlotFree(&slot);
+        api.BundleFree(&body);
+        return tdo;
+    };
+
+    // Each under-shift of 0xFF moves the register down a byte, so the fifth one is the first to shift 0xFF out
+    PPI_bool matched = 0;
+    RequireEqual<int>(runLoop(0xFF, 10, matched), 0xFF, "The loop didn't write back the TDO of its last iteration.");
+    RequireEqual<int>(matched, 1, "The loop's comparison didn't match.");
+    RequireEqual(FindElement(receiver.Responses().back(), "iterations"), std::string("5"), "The loop didn't break on the first match.");
+
+    RequireEqual<int>(runLoop(0x00, 3, matched), 0xFF, "The loop didn't write back the TDO of its last iteration.");
+    RequireEqual<int>(matched, 0, "The loop's comparison matched.");
+    RequireEqual(FindElement(receiver.Responses().back(), "iterations"), std::string("3"), "The loop didn't run up to its cap.");
+    RequireEqual(fixture.ShiftReceiver(jtag, 32, 0), 0x000000FFu, "The loop didn't leave the register as its iterations did.");
+
+    const auto requests = receiver.Requests();
+    RequireEqual(requests.size(), size_t(4), "The loops weren't a request each.");
+    RequireEqual(std::count_if(requests.begin(), requests.end(), [](const std::string& request) { return !FindElement(request, "loop").empty(); }),
+                 std::ptrdiff_t(2), "The loops weren't sent as loop requests.");
+    return 0;
+}
+
+// Against a receiver that stopped accepting connects, a receiver scan fails by its request deadline, whether its
+// channel is reconnecting or being opened, and a cancel gives up on a connect that has no deadline.
+int TestStalledConnects(const PluginApi& api)
+{
+#if defined(_WIN32)
+    // A connect past a full backlog is refused right away, there is no stalled connect to bound
+    return 0;
+#else
+    FakeReceiver receiver;
+    ReceiverFixture fixture(api, receiver);
+    const auto jtag = ReceiverFixture::JtagDeviceIds[0];
+    static constexpr OpenIPC_Error CanceledError = OpenIPC_Error_Operation_Invalid;
+    uint32_t tdo = 0;
+    const auto timed = [](auto function)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const OpenIPC_Error error = function();
+        return std::make_pair(error, std::chrono::steady_clock::now() - start);
+    };
+    fixture.ShiftReceiver(jtag, 32, 0);
+    receiver.DropNextShift();
+    receiver.StallConnects();
+
+    fixture.SetConfig(jtag, "Receiver.RequestTimeoutMs", "300");
+    auto [error, elapsed] = timed([&] { return fixture.TryShiftReceiver(jtag, 32, 0, tdo); });
+    RequireEqual<int>(error, OpenIPC_Error_Probe_Request_Timeout, "The scan whose channel couldn't reconnect didn't time out.");
+    RequireEqual(elapsed < std::chrono::seconds(3), true, "The reconnect went past the request deadline.");
+
+    std::tie(error, elapsed) = timed([&] { return fixture.TryShiftReceiver(jtag, 32, 0, tdo); });
+    RequireEqual<int>(error, OpenIPC_Error_Remote_Connection_Unable_To_Connect, "The scan whose channel couldn't be opened didn't fail.");
+    RequireEqual(elapsed < std::chrono::seconds(3), true, "Opening the channel went past the request deadline.");
+
+    fixture.SetConfig(jtag, "Receiver.RequestTimeoutMs", "0");
+    std::tie(error, elapsed) = timed([&]
+    {
+        std::thread canceling([&] { std::this_thread::sleep_for(std::chrono::milliseconds(100)); api.InterfaceOperationCancel(jtag); });
+        const auto shiftError = fixture.TryShiftReceiver(jtag, 32, 0, tdo);
+        canceling.join();
+        return shiftError;
+    });
+    RequireEqual<int>(error, CanceledError, "The cancel didn't give up on the connect.");
+    RequireEqual(elapsed < std::chrono::seconds(3), true, "The cancel didn't interrupt the connect.");
+    return 0;
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Probe Plugin Name must be passed as the first argument.\n";
+        return 1;
+    }
+    #if !defined(_WIN32)
+        std::signal(SIGPIPE, SIG_IGN); // A send on a connection the other side closed fails instead
+    #endif
+    const auto dllHandle = LoadDll(argv[1]);
+    PluginApi api {};
+    if (!dllHandle || !LoadApi(dllHandle, api))
+    {
+        std::cerr << "Failed to load dll " << std::quoted(argv[1]) << ".\n";
+        return 1;
+    }
+    try
+    {
+        if (auto result = TestReceiverRegister(api))
+        {
+            std::cout << "TestReceiverRegister failed.\n";
+            return result;
+        }
+        if (auto result = TestChannelPerBundle(api))
+        {
+            std::cout << "TestChannelPerBundle failed.\n";
+            return result;
+        }
+        if (auto result = TestCompressedReceiverScans(api))
+        {
+            std::cout << "TestCompressedReceiverScans failed.\n";
+            return result;
+        }
+        if (auto result = TestReceiverScanStream(api))
+        {
+            std::cout << "TestReceiverScanStream failed.\n";
+            return result;
+        }
+        if (auto result = TestFailedScanStream(api))
+        {
+            std::cout << "TestFailedScanStream failed.\n";
+            return result;
+        }
+        if (auto result = TestScanStreamBatch(api))
+        {
+            std::cout << "TestScanStreamBatch failed.\n";
+            return result;
+        }
+        if (auto result = TestSmallReceiveWindow(api))
+        {
+            std::cout << "TestSmallReceiveWindow failed.\n";
+            return result;
+        }
+        if (auto result = TestFailFastFlowControl(api))
+        {
+            std::cout << "TestFailFastFlowControl failed.\n";
+            return result;
+        }
+        if (auto result = TestStreamedReceiverScan(api))
+        {
+            std::cout << "TestStreamedReceiverScan failed.\n";
+            return result;
+        }
+        if (auto result = TestReconnectReplay(api))
+        {
+            std::cout << "TestReconnectReplay failed.\n";
+            return result;
+        }
+        if (auto result = TestTimeoutAndCancel(api))
+        {
+            std::cout << "TestTimeoutAndCancel failed.\n";
+            return result;
+        }
+        if (auto result = TestLoopTimeout(api))
+        {
+            std::cout << "TestLoopTimeout failed.\n";
+            return result;
+        }
+        if (auto result = TestReceiverLoop(api))
+        {
+            std::cout << "TestReceiverLoop failed.\n";
+            return result;
+        }
+        if (auto result = TestStalledConnects(api))
+        {
+            std::cout << "TestStalledConnects failed.\n";
+            return result;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    std::cout << "All tests passed.\n";
+    return 0; // PASS
+}
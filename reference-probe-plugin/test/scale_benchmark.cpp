@@ -0,0 +1,274 @@
+/////////////////////////<Source Code Embedded Notices>/////////////////////////
+//
+// INTEL CONFIDENTIAL
+// Copyright (C) Intel Corporation All Rights Reserved.
+//
+// The source code contained or described herein and all documents related to
+// the source code ("Material") are owned by Intel Corporation or its suppliers
+// or licensors. Title to the Material remains with Intel Corporation or its
+// suppliers and licensors. The Material contains trade secrets and proprietary
+// and confidential information of Intel or its suppliers and licensors. The
+// Material is protected by worldwide copyright and trade secret laws and
+// treaty provisions. No part of the Material may be used, copied, reproduced,
+// modified, published, uploaded, posted, transmitted, distributed, or disclosed
+// in any way without Intel's prior express written permission.
+//
+// No license under any patent, copyright, trade secret or other intellectual
+// property right is granted to or conferred upon you by disclosure or delivery
+// of the Materials, either expressly, by implication, inducement, estoppel or
+// otherwise. Any license under such intellectual property rights must be
+// express and approved by Intel in writing.
+//
+/////////////////////////<Source Code Embedded Notices>/////////////////////////
+
+// Scale benchmark: builds a farm of fake probes (SVEPlugin.AddFakeProbes) and times interface lookup,
+// locking and bundle dispatch across all of its interfaces, single threaded and from several threads.
+//
+// Usage: ReferencePlugin_ScaleBenchmark <plugin> [probes] [interfaces of each probe] [threads]
+//        e.g. ReferencePlugin_ScaleBenchmark libProbePluginReference_x64.so 250 Jtag,Jtag,StatePort,HTI 8
+
+#include "plugin_test_api.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+
+namespace // helpers
+{
+    using namespace PluginTest;
+
+    struct FarmInterface
+    {
+        OpenIPC_DeviceId Probe;
+        PPI_RefId RefId;
+        OpenIPC_DeviceId Device;
+        PPI_EInterfaceType Type;
+    };
+
+    template<typename Function>
+    double TimeNanosecondsPerCall(size_t calls, Function&& function)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+        return calls == 0 ? 0.0 : elapsed.count() / static_cast<double>(calls);
+    }
+
+    void Report(const char* measurement, double nanosecondsPerCall)
+    {
+        std::cout << std::left << std::setw(40) << measurement << std::right << std::setw(12) << std::fixed
+                  << std::setprecision(1) << nanosecondsPerCall << " ns/call\n";
+    }
+
+    // The plugin gives its JTAG interfaces the IDCODEs 0x12345600, 0x12345601, ... in the order it creates them
+    constexpr uint32_t FirstIdcode = 0x12345600;
+
+    uint32_t ToIdcode(const uint8_t (&idcode)[4])
+    {
+        return static_cast<uint32_t>(idcode[0]) | (static_cast<uint32_t>(idcode[1]) << 8)
+             | (static_cast<uint32_t>(idcode[2]) << 16) | (static_cast<uint32_t>(idcode[3]) << 24);
+    }
+
+    // Reads the IDCODE of a JTAG interface: an IR scan selecting it, then a 32 bit DR scan
+    OpenIPC_Error ReadIdcode(const PluginApi& api, PPI_ProbeBundleHandle bundle, OpenIPC_DeviceId jtagInterface, uint8_t (&idcode)[4])
+    {
+        const uint8_t idcodeInstruction = 0x02;
+        OpenIPC_Error error = api.StateIRShift(bundle, 8, &idcodeInstruction, nullptr, nullptr);
+        if (error == OpenIPC_Error_No_Error)
+        {
+            error = api.StateDRShift(bundle, 32, nullptr, idcode, nullptr);
+        }
+        if (error == OpenIPC_Error_No_Error)
+        {
+            error = api.BundleExecute(bundle, jtagInterface, 0);
+        }
+        api.BundleClear(bundle);
+        return error;
+    }
+
+    // The same scans run right away on the lock target interface, releasing the lock after the last one
+    OpenIPC_Error ReadIdcodeImmediately(const PluginApi& api, uint8_t (&idcode)[4])
+    {
+        const uint8_t idcodeInstruction = 0x02;
+        OpenIPC_Error error = api.StateIRShift(PPI_PROBE_LOCK_HOLD, 8, &idcodeInstruction, nullptr, nullptr);
+        if (error == OpenIPC_Error_No_Error)
+        {
+            error = api.StateDRShift(PPI_PROBE_LOCK_RELEASE, 32, nullptr, idcode, nullptr);
+        }
+        return error;
+    }
+}
+
+int RunBenchmark(const PluginApi& api, unsigned long probeCount, const std::string& interfaceTypes, unsigned long threadCount)
+{
+    if (api.PluginInitialize(1, "") != OpenIPC_Error_No_Error)
+    {
+        std::cerr << "PPI_PluginInitialize failed.\n";
+        return 1;
+    }
+    SetConfig(api, 0, "SVEPlugin.FakeProbeInterfaces", interfaceTypes);
+    SetConfig(api, 0, "SVEPlugin.AddFakeProbes", std::to_string(probeCount));
+
+    // Build the farm: list the probes (which adds the fake ones), then initialize every probe and interface
+    uint32_t listedProbes = 0;
+    api.ProbeGetRefIds(0, nullptr, &listedProbes);
+    std::vector<PPI_RefId> probeRefIds(listedProbes);
+    api.ProbeGetRefIds(listedProbes, probeRefIds.data(), &listedProbes);
+
+    std::vector<FarmInterface> interfaces;
+    OpenIPC_DeviceId nextDeviceId = 1;
+    const auto buildStart = std::chrono::steady_clock::now();
+    for (const auto probeRefId : probeRefIds)
+    {
+        const OpenIPC_DeviceId probe = nextDeviceId++;
+        api.ProbeBeginInitialization(probeRefId, probe);
+        api.ProbeFinishInitialization(probe); // The receiver isn't needed, a failed handshake still initializes the probe
+        PPI_RefId interfaceRefIds[255];
+        uint32_t interfaceCount = 0;
+        if (api.InterfaceGetRefIds(probe, 255, interfaceRefIds, &interfaceCount) != OpenIPC_Error_No_Error)
+        {
+            std::cerr << "PPI_InterfaceGetRefIds failed.\n";
+            return 1;
+        }
+        for (uint32_t index = 0; index < interfaceCount && index < 255; index++)
+        {
+            FarmInterface farmInterface { probe, interfaceRefIds[index], nextDeviceId++, PPI_interfaceTypeJtag };
+            if (api.InterfaceGetType(probe, farmInterface.RefId, &farmInterface.Type) != OpenIPC_Error_No_Error
+                || api.InterfaceBeginInitialization(probe, farmInterface.RefId, farmInterface.Device) != OpenIPC_Error_No_Error
+                || api.InterfaceFinishInitialization(farmInterface.Device) != OpenIPC_Error_No_Error)
+            {
+                std::cerr << "Initializing interface " << farmInterface.Device << " failed.\n";
+                return 1;
+            }
+            interfaces.push_back(farmInterface);
+        }
+    }
+    const auto buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart);
+
+    // The probes are listed in the order they were created, so the n-th JTAG interface has IDCODE FirstIdcode + n.
+    // The state port and trace interfaces can't run JTAG bundles, which must be refused rather than ignored.
+    std::vector<OpenIPC_DeviceId> jtagInterfaces;
+    std::vector<OpenIPC_DeviceId> otherInterfaces;
+    for (const auto& farmInterface : interfaces)
+    {
+        switch (farmInterface.Type)
+        {
+        case PPI_interfaceTypeJtag:
+            jtagInterfaces.push_back(farmInterface.Device);
+            break;
+        case PPI_interfaceTypeStatePort:
+        case PPI_interfaceTypeHtiTrace:
+            otherInterfaces.push_back(farmInterface.Device);
+            break;
+        default:
+            std::cerr << "Interface " << farmInterface.Device << " has the unexpected type " << farmInterface.Type << ".\n";
+            return 1;
+        }
+    }
+    std::cout << listedProbes << " probes, " << interfaces.size() << " interfaces (" << jtagInterfaces.size()
+              << " JTAG), initialized in " << std::fixed << std::setprecision(1) << buildTime.count() << " ms\n";
+
+    size_t failures = 0;
+    size_t wrongIdcodes = 0;
+    const auto checkIdcode = [](size_t jtagIndex, const uint8_t (&idcode)[4])
+    {
+        return ToIdcode(idcode) == FirstIdcode + jtagIndex;
+    };
+    PPI_EInterfaceType interfaceType;
+    Report("PPI_InterfaceGetType", TimeNanosecondsPerCall(interfaces.size(), [&]
+           {
+               for (const auto& farmInterface : interfaces)
+               {
+                   failures += api.InterfaceGetType(farmInterface.Probe, farmInterface.RefId, &interfaceType) != OpenIPC_Error_No_Error;
+               }
+           }));
+
+    auto bundle = api.BundleAllocate();
+    uint8_t idcode[4];
+    Report("PPI_Bundle_Execute (IDCODE read)", TimeNanosecondsPerCall(jtagInterfaces.size(), [&]
+           {
+               for (size_t index = 0; index < jtagInterfaces.size(); index++)
+               {
+                   failures += ReadIdcode(api, bundle, jtagInterfaces[index], idcode) != OpenIPC_Error_No_Error;
+                   wrongIdcodes += !checkIdcode(index, idcode);
+               }
+           }));
+    for (const auto otherInterface : otherInterfaces)
+    {
+        failures += ReadIdcode(api, bundle, otherInterface, idcode) != OpenIPC_Error_Invalid_Device_ID;
+    }
+    api.BundleFree(&bundle);
+
+    Report("Lock + immediate IDCODE read + release", TimeNanosecondsPerCall(jtagInterfaces.size(), [&]
+           {
+               for (size_t index = 0; index < jtagInterfaces.size(); index++)
+               {
+                   failures += api.LockTargetInterface(jtagInterfaces[index]) != OpenIPC_Error_No_Error;
+                   failures += ReadIdcodeImmediately(api, idcode) != OpenIPC_Error_No_Error;
+                   wrongIdcodes += !checkIdcode(index, idcode);
+               }
+           }));
+
+    // Every thread reads the IDCODEs of its own share of the JTAG interfaces
+    std::atomic<size_t> threadFailures { 0 };
+    std::atomic<size_t> threadWrongIdcodes { 0 };
+    const std::string threadedMeasurement = "PPI_Bundle_Execute, " + std::to_string(threadCount) + " threads";
+    Report(threadedMeasurement.c_str(), TimeNanosecondsPerCall(jtagInterfaces.size(), [&]
+           {
+               std::vector<std::thread> threads;
+               for (unsigned long thread = 0; thread < threadCount; thread++)
+               {
+                   threads.emplace_back([&, thread]
+                                        {
+                                            auto threadBundle = api.BundleAllocate();
+                                            uint8_t threadIdcode[4];
+                                            for (size_t index = thread; index < jtagInterfaces.size(); index += threadCount)
+                                            {
+                                                threadFailures += ReadIdcode(api, threadBundle, jtagInterfaces[index], threadIdcode) != OpenIPC_Error_No_Error;
+                                                threadWrongIdcodes += !checkIdcode(index, threadIdcode);
+                                            }
+                                            api.BundleFree(&threadBundle);
+                                        });
+               }
+               for (auto& thread : threads)
+               {
+                   thread.join();
+               }
+           }));
+
+    api.PluginDeinitialize();
+    failures += threadFailures;
+    wrongIdcodes += threadWrongIdcodes;
+    if (failures != 0 || wrongIdcodes != 0 || interfaces.empty())
+    {
+        std::cerr << failures << " calls failed, " << wrongIdcodes << " IDCODE reads returned another interface's IDCODE.\n";
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Probe Plugin Name must be passed as the first argument.\n";
+        return 1;
+    }
+    const unsigned long probeCount     = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 250;
+    const std::string   interfaceTypes = argc > 3 ? argv[3] : "Jtag,Jtag,StatePort,HTI";
+    const unsigned long threadCount    = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 4;
+
+    const auto dllHandle = LoadDll(argv[1]);
+    PluginApi api {};
+    if (!dllHandle || !LoadApi(dllHandle, api))
+    {
+        std::cerr << "Failed to load dll " << std::quoted(argv[1]) << ".\n";
+        return 1;
+    }
+    return RunBenchmark(api, probeCount, interfaceTypes, threadCount == 0 ? 1 : threadCount);
+}
@@ -233,11 +233,15 @@ int TestJtagBundleSupport(const std::string& pluginName)
         "PPI_InterfaceListLockInterfacePeers",
         // Required for jtag interfaces
         "PPI_InterfaceGetInfoJTAG",
+        // Required for an Interface whose operations can be canceled
+        "PPI_InterfaceOperationCancel",
         // Required for an Interface that uses Bundles
         "PPI_Bundle_Allocate",
         "PPI_Bundle_Clear",
         "PPI_Bundle_Execute",
         "PPI_Bundle_Free",
+        "PPI_Lock_Target_Interface",
+        "PPI_List_Locked_Interfaces",
         // Required for State based JTAG
         "PPI_JTAG_GoToState",
         "PPI_JTAG_StateIRShift",
@@ -245,6 +249,62 @@ int TestJtagBundleSupport(const std::string& pluginName)
     });
 }
 
+int TestRegisterJtagSupport(const std::string& pluginName)
+{
+    return _checkRequiredMethods(pluginName, {
+        // Required for Register based JTAG
+        "PPI_JTAG_RegisterShiftCapabilities",
+        "PPI_JTAG_IRRegisterShift",
+        "PPI_JTAG_DRRegisterShift",
+    });
+}
+
+int TestPinsJtagSupport(const std::string& pluginName)
+{
+    return _checkRequiredMethods(pluginName, {
+        // Required for Pins based JTAG
+        "PPI_JTAG_PinsShift",
+    });
+}
+
+int TestPaddingSupport(const std::string& pluginName)
+{
+    return _checkRequiredMethods(pluginName, {
+        // Required for JTAG padding
+        "PPI_JTAG_GetInterfacePadding",
+        "PPI_JTAG_SetInterfacePadding",
+        "PPI_JTAG_GetCurrentBundlePadding",
+        "PPI_JTAG_UpdateBundlePadding",
+    });
+}
+
+int TestInterfaceScanSupport(const std::string& pluginName)
+{
+    return _checkRequiredMethods(pluginName, {
+        // Required for bulk interface operations
+        "PPI_InterfaceScan",
+    });
+}
+
+int TestSlotSupport(const std::string& pluginName)
+{
+    return _checkRequiredMethods(pluginName, {
+        // Required if PPI_Slot_Allocate is implemented
+        "PPI_Slot_Allocate",
+        "PPI_Slot_Free",
+        "PPI_Slot_Size",
+        "PPI_Slot_Modification",
+        "PPI_Slot_ComparisonToConstant",
+    });
+}
+
+int TestLoopSupport(const std::string& pluginName)
+{
+    return _checkRequiredMethods(pluginName, {
+        "PPI_Loop_LoopBreakOnComparisonSuccess",
+        "PPI_Loop_CaptureAll",
+    });
+}
 
 int TestStatePortSupport(const std::string& pluginName)
 {
@@ -342,6 +402,36 @@ int main(int argc, char* argv[])
             std::cout << "TestJtagBundleSupport failed.\n";
             return result;
         }
+        if (auto result = TestRegisterJtagSupport(argv[1]))
+        {
+            std::cout << "TestRegisterJtagSupport failed.\n";
+            return result;
+        }
+        if (auto result = TestPinsJtagSupport(argv[1]))
+        {
+            std::cout << "TestPinsJtagSupport failed.\n";
+            return result;
+        }
+        if (auto result = TestPaddingSupport(argv[1]))
+        {
+            std::cout << "TestPaddingSupport failed.\n";
+            return result;
+        }
+        if (auto result = TestInterfaceScanSupport(argv[1]))
+        {
+            std::cout << "TestInterfaceScanSupport failed.\n";
+            return result;
+        }
+        if (auto result = TestSlotSupport(argv[1]))
+        {
+            std::cout << "TestSlotSupport failed.\n";
+            return result;
+        }
+        if (auto result = TestLoopSupport(argv[1]))
+        {
+            std::cout << "TestLoopSupport failed.\n";
+            return result;
+        }
         if (auto result = TestStatePortSupport(argv[1]))
         {
             std::cout << "TestStatePortSupport failed.\n";